@@ -8,6 +8,29 @@ constexpr inline bool is_big_endian() {
   return false;
 }
 
+// NOTE: The base RISC-V ISA doesn't have bit counting instructions, and the
+//       compiler builtins would call into libgcc, which the monitor doesn't
+//       link against. The implementations below are branch-free.
+
+inline size_t count_set_bits(size_t value) {
+  static_assert(sizeof(size_t) == 8 || sizeof(size_t) == 4,
+      "Unsupported word size");
+  constexpr size_t m1 = static_cast<size_t>(0x5555555555555555ULL);
+  constexpr size_t m2 = static_cast<size_t>(0x3333333333333333ULL);
+  constexpr size_t m4 = static_cast<size_t>(0x0F0F0F0F0F0F0F0FULL);
+  constexpr size_t h01 = static_cast<size_t>(0x0101010101010101ULL);
+
+  value -= (value >> 1) & m1;
+  value = (value & m2) + ((value >> 2) & m2);
+  value = (value + (value >> 4)) & m4;
+  return (value * h01) >> (sizeof(size_t) * 8 - 8);
+}
+
+inline size_t count_trailing_zeros(size_t value) {
+  // The bits below the least significant 1 bit.
+  return count_set_bits((value & (0 - value)) - 1);
+}
+
 };  // namespace sanctum::bare
 };  // namespace sanctum
 #endif  // !definded(BARE_ARCH_RISCV_BIT_MASKING_ARCH_H_INCLUDED)
@@ -15,6 +15,9 @@ inline size_t current_core() {
 inline void flush_tlbs() {
   // TODO: asm intrinsic
 }
+inline void send_monitor_ipi(size_t core_id) {
+  // TODO: asm intrinsic
+}
 inline void flush_private_caches() {
   // TODO: asm intrinsic
 }
@@ -39,12 +39,54 @@ inline size_t read_max_cache_index_shift() {
   return 0;
 }
 
-template<typename T> inline void bzero(phys_ptr<T> start, size_t bytes) {
-  // TODO: asm intrinsics
+// The size of the blocks operated on by the cache-block management
+// instructions in the Zicbom and Zicboz extensions.
+//
+// NOTE: The block size is a platform parameter. Cache-line-aligned buffers
+//       are aligned to it as long as it does not exceed the LLC line size.
+constexpr size_t cache_block_size = 64;
+
+// Zeroes a cache block without reading it from memory first.
+inline void cache_block_zero(uintptr_t addr) {
+  asm volatile ("cbo.zero (%0)" : : "r"(addr) : "memory");
+}
+
+// Writes back a cache block if it is dirty, and evicts it from all caches.
+inline void cache_block_flush(uintptr_t addr) {
+  asm volatile ("cbo.flush (%0)" : : "r"(addr) : "memory");
+}
+
+template<typename T> inline void bzero(phys_ptr<T> start, size_t bytes,
+    cache_policy_t policy) {
+  const uintptr_t end = uintptr_t(start) + bytes;
+  for (uintptr_t block = uintptr_t(start); block < end;
+       block += cache_block_size) {
+    cache_block_zero(block);
+    if (policy == cache_bypass)
+      cache_block_flush(block);
+  }
 }
 template<typename T> inline void bcopy(phys_ptr<T> dest, phys_ptr<T> source,
-    size_t bytes) {
-  // TODO: asm intrinsics
+    size_t bytes, cache_policy_t policy) {
+  constexpr size_t block_words = cache_block_size / sizeof(uint64_t);
+
+  uint64_t* dest_words = reinterpret_cast<uint64_t*>(uintptr_t(dest));
+  const uint64_t* source_words =
+      reinterpret_cast<const uint64_t*>(uintptr_t(source));
+  const uint64_t* source_end = reinterpret_cast<const uint64_t*>(
+      uintptr_t(source) + bytes);
+  for (; source_words < source_end;
+       source_words += block_words, dest_words += block_words) {
+    // NOTE: the loads are issued before the stores, so a block's loads can
+    //       all be in flight at the same time
+    uint64_t words[block_words];
+    for (size_t i = 0; i < block_words; ++i)
+      words[i] = source_words[i];
+    for (size_t i = 0; i < block_words; ++i)
+      dest_words[i] = words[i];
+    if (policy == cache_bypass)
+      cache_block_flush(uintptr_t(dest_words));
+  }
 }
 
 };  // namespace sanctum::bare
@@ -22,13 +22,26 @@ constexpr inline size_t page_table_entry_shift(size_t level) {
   return 3;  // 8 bytes per page table entry
 }
 
+constexpr uintptr_t page_table_leaf_acl_mask() {
+  // The R, W and X bits.
+  return 0xE;
+}
+
 inline bool is_valid_page_table_entry(uintptr_t entry_addr, size_t level) {
   return *(phys_ptr<uintptr_t>{entry_addr}) & 1;
 }
+inline bool is_leaf_page_table_entry(uintptr_t entry_addr, size_t level) {
+  return level == 0 ||
+      (*(phys_ptr<uintptr_t>{entry_addr}) & page_table_leaf_acl_mask()) != 0;
+}
 inline uintptr_t page_table_entry_target(uintptr_t entry_addr, size_t level) {
   uintptr_t target_mask = ~((1 << page_shift()) - 1);
   return *(phys_ptr<uintptr_t>{entry_addr}) & target_mask;
 }
+inline uintptr_t page_table_entry_acl(uintptr_t entry_addr, size_t) {
+  uintptr_t acl_mask = (1 << page_shift()) - 1;
+  return *(phys_ptr<uintptr_t>{entry_addr}) & acl_mask;
+}
 inline void write_page_table_entry(uintptr_t entry_addr, size_t level,
     uintptr_t target, uintptr_t acl) {
   uintptr_t acl_mask = (1 << page_shift()) - 1;
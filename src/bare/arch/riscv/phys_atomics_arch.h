@@ -61,6 +61,12 @@ inline template<> uintptr_t atomic_fetch_sub(
   // TODO: asm intrinsic
   return 0;
 }
+inline template<> bool atomic_compare_exchange_strong(
+    phys_ptr<atomic<uintptr_t>> object, uintptr_t* expected,
+    uintptr_t desired) noexcept {
+  // TODO: asm intrinsic
+  return false;
+}
 
 
 };  // namespace sanctum::bare
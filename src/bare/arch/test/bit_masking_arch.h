@@ -12,6 +12,14 @@ constexpr inline bool is_big_endian() {
   return false;
 }
 
+inline size_t count_trailing_zeros(size_t value) {
+  return __builtin_ctzll(value);
+}
+
+inline size_t count_set_bits(size_t value) {
+  return __builtin_popcountll(value);
+}
+
 };  // namespace sanctum::bare
 };  // namespace sanctum
 #endif  // !definded(BARE_ARCH_TEST_BIT_MASKING_ARCH_H_INCLUDED)
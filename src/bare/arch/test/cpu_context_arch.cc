@@ -15,6 +15,7 @@ size_t dram_region_bitmap_words = 0;
 
 size_t core_tlb_flush_count[max_cores];
 size_t core_cache_flush_count[max_cores];
+size_t core_ipi_count[max_cores];
 size_t core_cache_index_shift[max_cores];
 uintptr_t core_ptbr[max_cores];
 uintptr_t core_eptbr[max_cores];
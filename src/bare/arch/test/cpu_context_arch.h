@@ -1,6 +1,8 @@
 #if !defined(BARE_ARCH_TEST_CPU_CONTEXT_ARCH_H_INCLUDED)
 #define BARE_ARCH_TEST_CPU_CONTEXT_ARCH_H_INCLUDED
 
+#include <cassert>  // IPIs use assert for bound-checking.
+
 namespace sanctum {
 namespace testing {
 
@@ -16,6 +18,9 @@ constexpr size_t max_dram_region_bitmap_words = 8;
 // values.
 extern size_t core_tlb_flush_count[], core_cache_flush_count[];
 
+// For testing, we count the inter-processor interrupts sent to each core.
+extern size_t core_ipi_count[];
+
 // For testing, the cache index shift register is virtualized.
 extern size_t core_cache_index_shift[];
 
@@ -56,6 +61,10 @@ inline size_t current_core() { return testing::current_core; }
 inline void flush_tlbs() {
   testing::core_tlb_flush_count[current_core()] += 1;
 }
+inline void send_monitor_ipi(size_t core_id) {
+  assert(core_id < testing::core_count);
+  testing::core_ipi_count[core_id] += 1;
+}
 inline void flush_private_caches() {
   testing::core_cache_flush_count[current_core()] += 1;
 }
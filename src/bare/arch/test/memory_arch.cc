@@ -1,5 +1,11 @@
 #include "../../memory.h"
 
+#include <cstring>  // memcpy, memset
+
+#if defined(__SSE2__)
+#include <emmintrin.h>  // _mm_stream_si32, _mm_sfence
+#endif
+
 using namespace sanctum::bare;
 
 namespace sanctum {
@@ -15,6 +21,38 @@ bool is_shared_cache[max_cache_levels];
 size_t cache_line_size[max_cache_levels];
 size_t cache_set_count[max_cache_levels];
 
+size_t cache_bypass_bytes = 0;
+
+// NOTE: The streaming stores use 32-bit words, because bzero() and bcopy()
+//       may be called with uint32_t buffers. The fences order the
+//       non-temporal stores before any later regular stores, which is what
+//       assembly implementations would do as well.
+
+void stream_bzero(size_t start, size_t bytes) {
+  cache_bypass_bytes += bytes;
+#if defined(__SSE2__)
+  int* words = reinterpret_cast<int*>(phys_buffer + start);
+  for (size_t i = 0; i < bytes / sizeof(int); ++i)
+    _mm_stream_si32(words + i, 0);
+  _mm_sfence();
+#else  // defined(__SSE2__)
+  memset(phys_buffer + start, 0, bytes);
+#endif  // defined(__SSE2__)
+}
+
+void stream_bcopy(size_t dest, size_t source, size_t bytes) {
+  cache_bypass_bytes += bytes;
+#if defined(__SSE2__)
+  int* dest_words = reinterpret_cast<int*>(phys_buffer + dest);
+  const int* source_words = reinterpret_cast<const int*>(phys_buffer + source);
+  for (size_t i = 0; i < bytes / sizeof(int); ++i)
+    _mm_stream_si32(dest_words + i, source_words[i]);
+  _mm_sfence();
+#else  // defined(__SSE2__)
+  memcpy(phys_buffer + dest, phys_buffer + source, bytes);
+#endif  // defined(__SSE2__)
+}
+
 };  // namespace sanctum::testing
 };  // namespace sanctum
 
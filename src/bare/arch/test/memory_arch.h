@@ -14,6 +14,19 @@ constexpr size_t max_cache_levels = 4;
 extern bool is_shared_cache[];
 extern size_t cache_line_size[], cache_set_count[];
 
+// The number of bytes written by bzero() and bcopy() with cache_bypass.
+//
+// Tests use this to check that callers pick the intended cache policy.
+extern size_t cache_bypass_bytes;
+
+// Fills a range of phys_buffer with zeros, using the host's non-temporal
+// stores when they are available.
+void stream_bzero(size_t start, size_t bytes);
+
+// Copies a range of phys_buffer, using the host's non-temporal stores for the
+// destination when they are available.
+void stream_bcopy(size_t dest, size_t source, size_t bytes);
+
 };  // namespace sanctum::testing
 };  // namespace sanctum
 
@@ -46,17 +59,23 @@ inline size_t read_min_cache_index_shift() {
 inline size_t read_max_cache_index_shift() {
   return testing::max_cache_index_shift;
 }
-template<typename T> inline void bzero(phys_ptr<T> start, size_t bytes) {
+template<typename T> inline void bzero(phys_ptr<T> start, size_t bytes,
+    cache_policy_t policy) {
   // NOTE: relying on compiler to optimize division to bitwise shift
   size_t words = bytes / sizeof(T);
   assert(uintptr_t(start + words) <= testing::phys_buffer_size);
 
+  if (policy == cache_bypass) {
+    testing::stream_bzero(uintptr_t(start), words * sizeof(T));
+    return;
+  }
+
   phys_ptr<T> end = start + words;
   for (; start != end; start += 1)
     *start = static_cast<T>(0);
 }
 template<typename T> inline void bcopy(phys_ptr<T> dest, phys_ptr<T> source,
-    size_t bytes) {
+    size_t bytes, cache_policy_t policy) {
   // NOTE: relying on compiler to optimize division to bitwise shift
   size_t words = bytes / sizeof(T);
   assert(uintptr_t(source + words) <= testing::phys_buffer_size);
@@ -65,6 +84,12 @@ template<typename T> inline void bcopy(phys_ptr<T> dest, phys_ptr<T> source,
   assert(uintptr_t(source + words) <= uintptr_t(dest) ||
       uintptr_t(dest + words) <= uintptr_t(source));
 
+  if (policy == cache_bypass) {
+    testing::stream_bcopy(uintptr_t(dest), uintptr_t(source),
+        words * sizeof(T));
+    return;
+  }
+
   phys_ptr<T> end = source + words;
   for (; source != end; source += 1, dest += 1)
     *dest = *source;
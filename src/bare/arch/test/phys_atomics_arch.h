@@ -49,6 +49,17 @@ template<> inline uintptr_t atomic_fetch_sub(
   object->*(&atomic<uintptr_t>::__value) -= value;
   return old_value;
 }
+template<> inline bool atomic_compare_exchange_strong(
+    phys_ptr<atomic<uintptr_t>> object, uintptr_t* expected,
+    uintptr_t desired) noexcept {
+  uintptr_t old_value = object->*(&atomic<uintptr_t>::__value);
+  if (old_value != *expected) {
+    *expected = old_value;
+    return false;
+  }
+  object->*(&atomic<uintptr_t>::__value) = desired;
+  return true;
+}
 
 };  // namespace sanctum::bare
 };  // namespace sanctum
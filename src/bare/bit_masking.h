@@ -65,6 +65,15 @@ inline constexpr bool is_power_of_two(size_t memory_size) {
   return memory_size > 0 && is_valid_range_mask(memory_size - 1);
 }
 
+// The smallest multiple of a power of two that is greater or equal to a
+// quantity.
+//
+// `alignment` must be a power of two.
+inline constexpr size_t ceil_to_multiple(size_t memory_size,
+    size_t alignment) {
+  return (memory_size + alignment - 1) & ~(alignment - 1);
+}
+
 // Sets or clears a bit in a bitmap.
 //
 // `value` is true for setting the bit, or false for clearing the bit.
@@ -91,6 +100,73 @@ inline bool read_bitmap_bit(phys_ptr<size_t> bitmap, size_t bit) {
   return (*(bitmap + offset) & mask) != 0;
 }
 
+// The number of 0 bits below the least significant 1 bit in a word.
+//
+// The result is undefined if the argument is zero.
+inline size_t count_trailing_zeros(size_t value);
+
+// The number of 1 bits in a word.
+inline size_t count_set_bits(size_t value);
+
+// The position of the first 1 bit in a bitmap at or after a given position.
+//
+// `bit_count` is the number of bits in the bitmap. Returns `bit_count` if
+// there are no 1 bits at or after `bit`. The bitmap is scanned a word at a
+// time, so sparse bitmaps are cheap to walk.
+inline size_t find_next_set_bit(phys_ptr<size_t> bitmap, size_t bit_count,
+    size_t bit) {
+  constexpr size_t bits_in_size_t = sizeof(size_t) * 8;
+  if (bit >= bit_count)
+    return bit_count;
+
+  // NOTE: relying on the compiler to optimize division to bitwise shift
+  size_t offset = bit / bits_in_size_t;
+  size_t word = *(bitmap + offset) & (~size_t(0) << (bit % bits_in_size_t));
+  const size_t word_count = (bit_count + bits_in_size_t - 1) / bits_in_size_t;
+  while (word == 0) {
+    ++offset;
+    if (offset >= word_count)
+      return bit_count;
+    word = *(bitmap + offset);
+  }
+
+  const size_t set_bit = offset * bits_in_size_t + count_trailing_zeros(word);
+  return (set_bit < bit_count) ? set_bit : bit_count;
+}
+
+// The number of 1 bits among the first `bit_count` bits in a bitmap.
+inline size_t count_set_bitmap_bits(phys_ptr<size_t> bitmap,
+    size_t bit_count) {
+  constexpr size_t bits_in_size_t = sizeof(size_t) * 8;
+
+  // NOTE: relying on the compiler to optimize division to bitwise shift
+  const size_t full_words = bit_count / bits_in_size_t;
+  size_t count = 0;
+  for (size_t i = 0; i < full_words; ++i)
+    count += count_set_bits(*(bitmap + i));
+
+  const size_t tail_bits = bit_count % bits_in_size_t;
+  if (tail_bits != 0) {
+    const size_t mask = (size_t(1) << tail_bits) - 1;
+    count += count_set_bits(*(bitmap + full_words) & mask);
+  }
+  return count;
+}
+
+// Calls a function with the position of each 1 bit in a bitmap.
+//
+// `bit_count` is the number of bits in the bitmap. The positions are visited
+// in increasing order. The function may change bits that it was already
+// called for.
+template<typename Function>
+inline void for_each_set_bit(phys_ptr<size_t> bitmap, size_t bit_count,
+    Function function) {
+  for (size_t bit = find_next_set_bit(bitmap, bit_count, 0); bit < bit_count;
+       bit = find_next_set_bit(bitmap, bit_count, bit + 1)) {
+    function(bit);
+  }
+}
+
 // True if this is a big-endian architecture.
 constexpr bool is_big_endian();
 
@@ -98,12 +174,16 @@ constexpr bool is_big_endian();
 //
 // This is used to convert between big-endian and little-endian values.
 //
-// The template is guaranteed to be specialized for uint32_t.
+// The template is guaranteed to be specialized for uint32_t and uint64_t.
 template<typename T> constexpr T reverse_bytes(T value);
 template<> constexpr inline uint32_t reverse_bytes(uint32_t value) {
   return ((value & 0xff) << 24) | ((value & 0xff00) << 8) |
       ((value >> 24) & 0xff) | ((value >> 8) & 0xff00);
 }
+template<> constexpr inline uint64_t reverse_bytes(uint64_t value) {
+  return (static_cast<uint64_t>(reverse_bytes(static_cast<uint32_t>(value)))
+      << 32) | reverse_bytes(static_cast<uint32_t>(value >> 32));
+}
 
 };  // namespace sanctum::bare
 };  // namespace sanctum
@@ -4,6 +4,12 @@
 
 using sanctum::bare::address_bits_for;
 using sanctum::bare::ceil_power_of_two;
+using sanctum::bare::ceil_to_multiple;
+using sanctum::bare::count_set_bitmap_bits;
+using sanctum::bare::count_set_bits;
+using sanctum::bare::count_trailing_zeros;
+using sanctum::bare::find_next_set_bit;
+using sanctum::bare::for_each_set_bit;
 using sanctum::bare::is_aligned_to_mask;
 using sanctum::bare::is_page_aligned;
 using sanctum::bare::is_power_of_two;
@@ -112,6 +118,15 @@ TEST(BitMaskingTest, CeilPowerOfTwo) {
   ASSERT_EQ(65536, ceil_power_of_two(65536));
 }
 
+TEST(BitMaskingTest, CeilToMultiple) {
+  ASSERT_EQ(0, ceil_to_multiple(0, 64));
+  ASSERT_EQ(64, ceil_to_multiple(1, 64));
+  ASSERT_EQ(64, ceil_to_multiple(64, 64));
+  ASSERT_EQ(128, ceil_to_multiple(65, 64));
+  ASSERT_EQ(40, ceil_to_multiple(40, 8));
+  ASSERT_EQ(7, ceil_to_multiple(7, 1));
+}
+
 TEST(BitMaskingTest, IsPowerOfTwo) {
   static_assert(true == is_power_of_two(1), "is_power_of_two(1)");
   static_assert(true == is_power_of_two(2), "is_power_of_two(2)");
@@ -143,6 +158,18 @@ TEST(BitMaskingTest, ReverseBytes) {
   ASSERT_EQ(0x98badcfeu, reverse_bytes(0xfedcba98U));
 }
 
+TEST(BitMaskingTest, ReverseBytes64) {
+  ASSERT_EQ(0xff00000000000000ULL, reverse_bytes<uint64_t>(0xffULL));
+  ASSERT_EQ(0xffULL, reverse_bytes<uint64_t>(0xff00000000000000ULL));
+  ASSERT_EQ(0xff000000ULL, reverse_bytes<uint64_t>(0xff00000000ULL));
+  ASSERT_EQ(0ULL, reverse_bytes<uint64_t>(0ULL));
+
+  ASSERT_EQ(0x0123456789abcdefULL,
+      reverse_bytes<uint64_t>(0xefcdab8967452301ULL));
+  ASSERT_EQ(0xefcdab8967452301ULL,
+      reverse_bytes<uint64_t>(0x0123456789abcdefULL));
+}
+
 TEST(BitMaskingTest, ReadSetBitmapBit) {
   constexpr uintptr_t addr = 160, addr2 = 200;
   constexpr uintptr_t zero_addr = 0;
@@ -249,3 +276,96 @@ TEST(BitMaskingTest, ReadSetBitmapBit) {
   *ptr2 = 0;
   *(ptr2 - 1) = 0;
 }
+
+TEST(BitMaskingTest, CountTrailingZeros) {
+  ASSERT_EQ(0, count_trailing_zeros(1));
+  ASSERT_EQ(1, count_trailing_zeros(2));
+  ASSERT_EQ(0, count_trailing_zeros(3));
+  ASSERT_EQ(4, count_trailing_zeros(0x30));
+  ASSERT_EQ(12, count_trailing_zeros(0x1000));
+  ASSERT_EQ(sizeof(size_t) * 8 - 1,
+      count_trailing_zeros(size_t(1) << (sizeof(size_t) * 8 - 1)));
+}
+
+TEST(BitMaskingTest, CountSetBits) {
+  ASSERT_EQ(0, count_set_bits(0));
+  ASSERT_EQ(1, count_set_bits(1));
+  ASSERT_EQ(2, count_set_bits(0x81));
+  ASSERT_EQ(16, count_set_bits(0xFFFF));
+  ASSERT_EQ(sizeof(size_t) * 8, count_set_bits(~size_t(0)));
+}
+
+TEST(BitMaskingTest, FindNextSetBit) {
+  constexpr size_t bits_in_size_t = sizeof(size_t) * 8;
+  constexpr uintptr_t addr = 64;
+  ASSERT_LE(addr + 4 * sizeof(size_t), phys_buffer_size);
+  memset(phys_buffer + addr, 0, 4 * sizeof(size_t));
+
+  phys_ptr<size_t> ptr{addr};
+  const size_t bit_count = 3 * bits_in_size_t + 5;
+  ASSERT_EQ(bit_count, find_next_set_bit(ptr, bit_count, 0));
+
+  set_bitmap_bit(ptr, 3, true);
+  set_bitmap_bit(ptr, 2 * bits_in_size_t + 1, true);
+  set_bitmap_bit(ptr, 3 * bits_in_size_t + 4, true);
+  ASSERT_EQ(3, find_next_set_bit(ptr, bit_count, 0));
+  ASSERT_EQ(3, find_next_set_bit(ptr, bit_count, 3));
+  ASSERT_EQ(2 * bits_in_size_t + 1, find_next_set_bit(ptr, bit_count, 4));
+  ASSERT_EQ(3 * bits_in_size_t + 4,
+      find_next_set_bit(ptr, bit_count, 2 * bits_in_size_t + 2));
+  ASSERT_EQ(bit_count,
+      find_next_set_bit(ptr, bit_count, 3 * bits_in_size_t + 5));
+  ASSERT_EQ(bit_count, find_next_set_bit(ptr, bit_count, bit_count + 10));
+
+  // Bits past the end of the bitmap are ignored.
+  ASSERT_EQ(3 * bits_in_size_t,
+      find_next_set_bit(ptr, 3 * bits_in_size_t, 2 * bits_in_size_t + 2));
+  set_bitmap_bit(ptr, 3 * bits_in_size_t + 4, false);
+  set_bitmap_bit(ptr, 3 * bits_in_size_t + 6, true);
+  ASSERT_EQ(bit_count,
+      find_next_set_bit(ptr, bit_count, 2 * bits_in_size_t + 2));
+}
+
+TEST(BitMaskingTest, CountSetBitmapBits) {
+  constexpr size_t bits_in_size_t = sizeof(size_t) * 8;
+  constexpr uintptr_t addr = 64;
+  ASSERT_LE(addr + 4 * sizeof(size_t), phys_buffer_size);
+  memset(phys_buffer + addr, 0, 4 * sizeof(size_t));
+
+  phys_ptr<size_t> ptr{addr};
+  ASSERT_EQ(0, count_set_bitmap_bits(ptr, 2 * bits_in_size_t));
+
+  set_bitmap_bit(ptr, 0, true);
+  set_bitmap_bit(ptr, bits_in_size_t - 1, true);
+  set_bitmap_bit(ptr, bits_in_size_t + 2, true);
+  set_bitmap_bit(ptr, bits_in_size_t + 3, true);
+  ASSERT_EQ(0, count_set_bitmap_bits(ptr, 0));
+  ASSERT_EQ(1, count_set_bitmap_bits(ptr, 1));
+  ASSERT_EQ(2, count_set_bitmap_bits(ptr, bits_in_size_t));
+  ASSERT_EQ(2, count_set_bitmap_bits(ptr, bits_in_size_t + 2));
+  ASSERT_EQ(3, count_set_bitmap_bits(ptr, bits_in_size_t + 3));
+  ASSERT_EQ(4, count_set_bitmap_bits(ptr, 2 * bits_in_size_t));
+}
+
+TEST(BitMaskingTest, ForEachSetBit) {
+  constexpr size_t bits_in_size_t = sizeof(size_t) * 8;
+  constexpr uintptr_t addr = 64;
+  ASSERT_LE(addr + 4 * sizeof(size_t), phys_buffer_size);
+  memset(phys_buffer + addr, 0, 4 * sizeof(size_t));
+
+  phys_ptr<size_t> ptr{addr};
+  const size_t bits[] = { 1, 5, bits_in_size_t, 3 * bits_in_size_t - 1 };
+  for (size_t bit : bits)
+    set_bitmap_bit(ptr, bit, true);
+
+  size_t visited[8];
+  size_t visit_count = 0;
+  for_each_set_bit(ptr, 3 * bits_in_size_t, [&](size_t bit) {
+    ASSERT_LT(visit_count, 8);
+    visited[visit_count] = bit;
+    ++visit_count;
+  });
+  ASSERT_EQ(4, visit_count);
+  for (size_t i = 0; i < 4; ++i)
+    ASSERT_EQ(bits[i], visited[i]);
+}
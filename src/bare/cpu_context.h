@@ -21,6 +21,12 @@ size_t current_core();
 // This does not flush any cache.
 void flush_tlbs();
 
+// Interrupts another core, so it enters the security monitor.
+//
+// The interrupt is delivered asynchronously. This can only be issued by the
+// security monitor.
+void send_monitor_ipi(size_t core_id);
+
 // Flush all the caches belonging to the current core.
 //
 // This does not flush TLBs, and does not flush the shared last-level cache.
@@ -9,6 +9,7 @@ using sanctum::bare::flush_tlbs;
 using sanctum::bare::flush_private_caches;
 using sanctum::bare::read_core_count;
 using sanctum::bare::phys_ptr;
+using sanctum::bare::send_monitor_ipi;
 using sanctum::bare::set_cache_index_shift;
 using sanctum::bare::set_drb_map;
 using sanctum::bare::set_edrb_map;
@@ -73,6 +74,22 @@ TEST(CpuContextTest, FlushTlbs) {
   sanctum::testing::core_tlb_flush_count[3] = 0;
 }
 
+TEST(CpuContextTest, SendMonitorIpi) {
+  set_core_count(8);
+  sanctum::testing::core_ipi_count[0] = 0;
+  sanctum::testing::core_ipi_count[3] = 0;
+
+  send_monitor_ipi(3);
+  ASSERT_EQ(0, sanctum::testing::core_ipi_count[0]);
+  ASSERT_EQ(1, sanctum::testing::core_ipi_count[3]);
+
+  set_current_core(3);
+  send_monitor_ipi(0);
+  send_monitor_ipi(3);
+  ASSERT_EQ(1, sanctum::testing::core_ipi_count[0]);
+  ASSERT_EQ(2, sanctum::testing::core_ipi_count[3]);
+}
+
 TEST(CpuContextTest, FlushPrivateCaches) {
   set_core_count(8);
   sanctum::testing::core_cache_flush_count[0] = 0;
@@ -58,18 +58,37 @@ size_t read_min_cache_index_shift();
 // The minimum value of the cache index shift for the platform.
 size_t read_max_cache_index_shift();
 
+// How bzero() and bcopy() use the cache hierarchy for the data they write.
+typedef enum {
+  // The written lines are allocated in the caches, like regular stores do.
+  //
+  // This is best when the data will be read soon, e.g. by a hash.
+  cache_allocate = 0,
+
+  // The written lines are not kept in the caches, when the platform supports
+  // it.
+  //
+  // This is best for large buffers that won't be read soon, such as wiped
+  // DRAM regions. Writing those through the caches would evict the LLC lines
+  // of other data, and would read every line from DRAM before overwriting it.
+  cache_bypass = 1,
+} cache_policy_t;
+
 // Fills a buffer in physical memory with zeros.
 //
 // In order to allow for optimized assembly implementations, both the starting
 // address and buffer size must be a multiple of the cache line size.
-template<typename T> void bzero(phys_ptr<T> start, size_t bytes);
+template<typename T> void bzero(phys_ptr<T> start, size_t bytes,
+    cache_policy_t policy = cache_allocate);
 
 // Copies data between two non-overlaping buffers in physical memory.
 //
 // In order to allow for optimized assembly implementations, both addresses, as
 // well as the buffer size must be a multiple of the cache line size.
+//
+// The policy only applies to the destination buffer.
 template<typename T> void bcopy(phys_ptr<T> dest, phys_ptr<T> source,
-    size_t bytes);
+    size_t bytes, cache_policy_t policy = cache_allocate);
 
 };  // namespace sanctum::bare
 };  // namespace sanctum
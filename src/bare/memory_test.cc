@@ -2,6 +2,8 @@
 
 #include "gtest/gtest.h"
 
+using sanctum::bare::cache_allocate;
+using sanctum::bare::cache_bypass;
 using sanctum::bare::is_shared_cache;
 using sanctum::bare::phys_ptr;
 using sanctum::bare::read_cache_levels;
@@ -128,6 +130,26 @@ TEST(MemoryTest, Bzero) {
   memset(phys_buffer, 0, 256);
 }
 
+TEST(MemoryTest, BzeroCacheBypass) {
+  ASSERT_LE(256, phys_buffer_size);
+  memset(phys_buffer, 0xcc, 256);
+  sanctum::testing::cache_bypass_bytes = 0;
+
+  phys_ptr<size_t> ptr{64};
+  bzero(ptr, 64, cache_allocate);
+  ASSERT_EQ(0, sanctum::testing::cache_bypass_bytes);
+
+  memset(phys_buffer, 0xcc, 256);
+  bzero(ptr, 96, cache_bypass);
+  ASSERT_EQ(96, sanctum::testing::cache_bypass_bytes);
+  ASSERT_NE(0, *(ptr - 1));
+  for (size_t i = 0; i < 96 / sizeof(size_t); ++i)
+    ASSERT_EQ(0, *(ptr + i)) << i;
+  ASSERT_NE(0, *(ptr + 96 / sizeof(size_t)));
+
+  memset(phys_buffer, 0, 256);
+}
+
 TEST(MemoryTest, Bcopy) {
   ASSERT_LE(256, phys_buffer_size);
   memset(phys_buffer, 0xcc, 128);
@@ -167,3 +189,24 @@ TEST(MemoryTest, Bcopy) {
 
   memset(phys_buffer, 0, 256);
 }
+
+TEST(MemoryTest, BcopyCacheBypass) {
+  ASSERT_LE(256, phys_buffer_size);
+  memset(phys_buffer, 0xcc, 128);
+  for (size_t i = 128; i < 256; ++i)
+    phys_buffer[i] = static_cast<char>(i);
+  sanctum::testing::cache_bypass_bytes = 0;
+
+  phys_ptr<size_t> ptr1{32};
+  phys_ptr<size_t> ptr2{160};
+  size_t value1 = *ptr1;
+
+  bcopy(ptr1, ptr2, 48, cache_bypass);
+  ASSERT_EQ(48, sanctum::testing::cache_bypass_bytes);
+  ASSERT_EQ(value1, *(ptr1 - 1));
+  for (size_t i = 0; i < 48 / sizeof(size_t); ++i)
+    ASSERT_EQ(size_t(*(ptr2 + i)), size_t(*(ptr1 + i))) << i;
+  ASSERT_EQ(value1, *(ptr1 + 48 / sizeof(size_t)));
+
+  memset(phys_buffer, 0, 256);
+}
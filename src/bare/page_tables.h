@@ -34,12 +34,31 @@ constexpr inline size_t page_table_entry_shift(size_t level);
 // Page entries with the valid bit unset have no other valid fields.
 bool is_valid_page_table_entry(uintptr_t entry_addr, size_t level);
 
+// The ACL bits that turn a page table entry into a leaf.
+//
+// A valid entry at level 0 is always a leaf. A valid entry at a higher level
+// is a leaf if it has any of these bits set, and then it maps a superpage
+// instead of pointing to a page table at the next level.
+constexpr uintptr_t page_table_leaf_acl_mask();
+
+// Checks if a valid page table entry is a leaf.
+//
+// Leaf entries hold the physical address for a virtual address, instead of
+// pointing to a next level page table. Entries at level 0 are always leaves.
+bool is_leaf_page_table_entry(uintptr_t entry_addr, size_t level);
+
 // Reads the destination pointer in a page table entry.
 //
 // The pointer can be the physical address of the next level page table, or the
 // physical address for a virtual address.
 uintptr_t page_table_entry_target(uintptr_t entry_addr, size_t level);
 
+// Reads the access control flags in a page table entry.
+//
+// The result can be passed to write_page_table_entry() to re-create the entry
+// with a different target.
+uintptr_t page_table_entry_acl(uintptr_t entry_addr, size_t level);
+
 // Writes a page table entry.
 //
 // `target` points to the next level page table, or has the physical address
@@ -86,6 +105,14 @@ constexpr inline size_t page_table_pages(size_t level) {
   return page_table_size(level) >> page_shift();
 }
 
+// The size of the memory mapped by a page table entry at a given level.
+//
+// This is the size of a superpage mapped by a leaf entry at the given level.
+constexpr inline size_t page_table_entry_span(size_t level) {
+  return (level == 0) ? page_size() :
+      page_table_entry_span(level - 1) << page_table_shift(level - 1);
+}
+
 // Used to implement page_table_translated_bits.
 constexpr inline size_t __page_table_translated_bits(size_t level, size_t sum) {
   return (level == page_table_levels()) ? sum :
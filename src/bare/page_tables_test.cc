@@ -2,12 +2,15 @@
 
 #include "gtest/gtest.h"
 
+using sanctum::bare::is_leaf_page_table_entry;
 using sanctum::bare::is_valid_page_table_entry;
 using sanctum::bare::page_size;
 using sanctum::bare::page_shift;
 using sanctum::bare::page_table_entries;
+using sanctum::bare::page_table_entry_acl;
 using sanctum::bare::page_table_entry_shift;
 using sanctum::bare::page_table_entry_size;
+using sanctum::bare::page_table_entry_span;
 using sanctum::bare::page_table_entry_target;
 using sanctum::bare::page_table_levels;
 using sanctum::bare::page_table_pages;
@@ -54,6 +57,14 @@ TEST(PageTablesTest, Geometry) {
       "page_table_translated_bits");
 }
 
+TEST(PageTablesTest, PageTableEntrySpan) {
+  static_assert(page_table_entry_span(0) == 4096, "L0 page_table_entry_span");
+  static_assert(page_table_entry_span(1) == 0x200000,
+      "L1 page_table_entry_span");
+  static_assert(page_table_entry_span(2) == 0x80000000,
+      "L2 page_table_entry_span");
+}
+
 TEST(PageTablesTest, IsValidPageTableEntry) {
   uintptr_t addr = 160;
   ASSERT_LE(256, phys_buffer_size);
@@ -78,6 +89,27 @@ TEST(PageTablesTest, IsValidPageTableEntry) {
   ASSERT_EQ(true, is_valid_page_table_entry(addr, 2));
 }
 
+TEST(PageTablesTest, IsLeafPageTableEntry) {
+  uintptr_t addr = 160;
+  ASSERT_LE(256, phys_buffer_size);
+  memset(phys_buffer, 0, 256);
+
+  *(reinterpret_cast<uintptr_t*>(phys_buffer + addr)) = 0xcafebabe001;
+  ASSERT_EQ(true, is_leaf_page_table_entry(addr, 0));
+  ASSERT_EQ(false, is_leaf_page_table_entry(addr, 1));
+  ASSERT_EQ(false, is_leaf_page_table_entry(addr, 2));
+  *(reinterpret_cast<uintptr_t*>(phys_buffer + addr)) = 0xcafebabe003;
+  ASSERT_EQ(true, is_leaf_page_table_entry(addr, 0));
+  ASSERT_EQ(true, is_leaf_page_table_entry(addr, 1));
+  ASSERT_EQ(true, is_leaf_page_table_entry(addr, 2));
+  *(reinterpret_cast<uintptr_t*>(phys_buffer + addr)) = 0xcafebabe009;
+  ASSERT_EQ(true, is_leaf_page_table_entry(addr, 1));
+  ASSERT_EQ(true, is_leaf_page_table_entry(addr, 2));
+  *(reinterpret_cast<uintptr_t*>(phys_buffer + addr)) = 0xcafebabeff1;
+  ASSERT_EQ(false, is_leaf_page_table_entry(addr, 1));
+  ASSERT_EQ(false, is_leaf_page_table_entry(addr, 2));
+}
+
 TEST(PageTablesTest, PageTableEntryTarget) {
   uintptr_t addr = 160;
   ASSERT_LE(256, phys_buffer_size);
@@ -106,6 +138,22 @@ TEST(PageTablesTest, PageTableEntryTarget) {
   ASSERT_EQ(0xcafebabf000, page_table_entry_target(addr, 2));
 }
 
+TEST(PageTablesTest, PageTableEntryAcl) {
+  uintptr_t addr = 160;
+  ASSERT_LE(256, phys_buffer_size);
+  memset(phys_buffer, 0, 256);
+
+  *(reinterpret_cast<uintptr_t*>(phys_buffer + addr)) = 0xcafebabe001;
+  ASSERT_EQ(1, page_table_entry_acl(addr, 0));
+  ASSERT_EQ(1, page_table_entry_acl(addr, 1));
+  *(reinterpret_cast<uintptr_t*>(phys_buffer + addr)) = 0xcafebabffff;
+  ASSERT_EQ(0xfff, page_table_entry_acl(addr, 0));
+  ASSERT_EQ(0xfff, page_table_entry_acl(addr, 2));
+
+  write_page_table_entry(addr, 1, 0x12345000, page_table_entry_acl(addr, 1));
+  ASSERT_EQ(0x12345fff, *(reinterpret_cast<uintptr_t*>(phys_buffer + addr)));
+}
+
 TEST(PageTablesTest, WritePageTableEntry) {
   uintptr_t addr = 160;
   ASSERT_LE(256, phys_buffer_size);
@@ -28,6 +28,8 @@ template<typename T>
     T atomic_fetch_add(phys_ptr<atomic<T>> object, T value) noexcept;
 template<typename T>
     T atomic_fetch_sub(phys_ptr<atomic<T>> object, T value) noexcept;
+template<typename T> bool atomic_compare_exchange_strong(
+    phys_ptr<atomic<T>> object, T* expected, T desired) noexcept;
 
 
 };  // namespace sanctum::bare
@@ -112,6 +112,17 @@ TEST(AtomicTest, HandlesUintptr) {
       (reinterpret_cast<atomic<uintptr_t>*>(phys_buffer + addr))->__value);
   ASSERT_EQ(write_value - 2 * value, atomic_load(ptr));
 
+  uintptr_t expected = value;
+  ASSERT_FALSE(atomic_compare_exchange_strong(ptr, &expected, write_value));
+  ASSERT_EQ(write_value - 2 * value, expected);
+  ASSERT_EQ(write_value - 2 * value, atomic_load(ptr));
+
+  ASSERT_TRUE(atomic_compare_exchange_strong(ptr, &expected, write_value));
+  ASSERT_EQ(write_value - 2 * value, expected);
+  ASSERT_EQ(write_value,
+      (reinterpret_cast<atomic<uintptr_t>*>(phys_buffer + addr))->__value);
+  ASSERT_EQ(write_value, atomic_load(ptr));
+
   (reinterpret_cast<atomic<uintptr_t>*>(phys_buffer + addr))->__value = 0;
 }
 
@@ -157,6 +168,17 @@ TEST(AtomicTest, HandlesSize) {
       (reinterpret_cast<atomic<size_t>*>(phys_buffer + addr))->__value);
   ASSERT_EQ(write_value - 2 * value, atomic_load(ptr));
 
+  size_t expected = value;
+  ASSERT_FALSE(atomic_compare_exchange_strong(ptr, &expected, write_value));
+  ASSERT_EQ(write_value - 2 * value, expected);
+  ASSERT_EQ(write_value - 2 * value, atomic_load(ptr));
+
+  ASSERT_TRUE(atomic_compare_exchange_strong(ptr, &expected, write_value));
+  ASSERT_EQ(write_value - 2 * value, expected);
+  ASSERT_EQ(write_value,
+      (reinterpret_cast<atomic<size_t>*>(phys_buffer + addr))->__value);
+  ASSERT_EQ(write_value, atomic_load(ptr));
+
   (reinterpret_cast<atomic<size_t>*>(phys_buffer + addr))->__value = 0;
 }
 
@@ -0,0 +1,142 @@
+#if !defined(CRYPTO_ARCH_RISCV_HASH_ARCH_H_INCLUDED)
+#define CRYPTO_ARCH_RISCV_HASH_ARCH_H_INCLUDED
+
+namespace sanctum {
+namespace crypto {
+
+#if defined(__riscv_zknh)
+
+// The SHA-256 logical functions, computed by the scalar crypto extension.
+//
+// Each function is a single instruction, whereas the portable code needs
+// several shifts and ORs per rotation on cores without the Zbb extension.
+struct sha256_zknh_ops {
+  typedef uint32_t word_t;
+  static constexpr size_t rounds = 64;
+
+  static constexpr inline uint32_t k(size_t round) {
+    return sha256_k[round];
+  }
+  static inline uint32_t sum0(uint32_t a) {
+    uint32_t result;
+    asm ("sha256sum0 %0, %1" : "=r" (result) : "r" (a));
+    return result;
+  }
+  static inline uint32_t sum1(uint32_t e) {
+    uint32_t result;
+    asm ("sha256sum1 %0, %1" : "=r" (result) : "r" (e));
+    return result;
+  }
+  static inline uint32_t sig0(uint32_t w) {
+    uint32_t result;
+    asm ("sha256sig0 %0, %1" : "=r" (result) : "r" (w));
+    return result;
+  }
+  static inline uint32_t sig1(uint32_t w) {
+    uint32_t result;
+    asm ("sha256sig1 %0, %1" : "=r" (result) : "r" (w));
+    return result;
+  }
+};
+typedef sha256_zknh_ops sha256_arch_ops;
+
+#else  // defined(__riscv_zknh)
+
+typedef sha256_portable_ops sha256_arch_ops;
+
+#endif  // defined(__riscv_zknh)
+
+#if defined(__riscv_zknh) && __riscv_xlen == 64
+
+// The SHA-512 logical functions, computed by the scalar crypto extension.
+//
+// RV64 cores have single-instruction versions of these functions. RV32 cores
+// need instruction pairs, which the portable code doesn't beat by much.
+struct sha512_zknh_ops {
+  typedef uint64_t word_t;
+  static constexpr size_t rounds = 80;
+
+  static constexpr inline uint64_t k(size_t round) {
+    return sha512_k[round];
+  }
+  static inline uint64_t sum0(uint64_t a) {
+    uint64_t result;
+    asm ("sha512sum0 %0, %1" : "=r" (result) : "r" (a));
+    return result;
+  }
+  static inline uint64_t sum1(uint64_t e) {
+    uint64_t result;
+    asm ("sha512sum1 %0, %1" : "=r" (result) : "r" (e));
+    return result;
+  }
+  static inline uint64_t sig0(uint64_t w) {
+    uint64_t result;
+    asm ("sha512sig0 %0, %1" : "=r" (result) : "r" (w));
+    return result;
+  }
+  static inline uint64_t sig1(uint64_t w) {
+    uint64_t result;
+    asm ("sha512sig1 %0, %1" : "=r" (result) : "r" (w));
+    return result;
+  }
+};
+typedef sha512_zknh_ops sha512_arch_ops;
+
+#else  // defined(__riscv_zknh) && __riscv_xlen == 64
+
+typedef sha512_portable_ops sha512_arch_ops;
+
+#endif  // defined(__riscv_zknh) && __riscv_xlen == 64
+
+inline void sha256_compress_blocks(uint32_t (&hash)[8],
+    phys_ptr<uint32_t> blocks, size_t block_count) {
+  for (size_t i = 0; i < block_count; ++i) {
+    sha2_compress<sha256_arch_ops>(hash, blocks);
+    blocks += 16;
+  }
+}
+
+inline void sha512_compress_blocks(uint64_t (&hash)[8],
+    phys_ptr<uint64_t> blocks, size_t block_count) {
+  for (size_t i = 0; i < block_count; ++i) {
+    sha2_compress<sha512_arch_ops>(hash, blocks);
+    blocks += 16;
+  }
+}
+
+inline void sha256_copy_compress_blocks(uint32_t (&hash)[8],
+    phys_ptr<uint32_t> dest, phys_ptr<uint32_t> source, size_t block_count) {
+  for (size_t i = 0; i < block_count; ++i) {
+    sha2_copy_compress<sha256_arch_ops>(hash, dest, source);
+    dest += 16;
+    source += 16;
+  }
+}
+
+inline void sha512_copy_compress_blocks(uint64_t (&hash)[8],
+    phys_ptr<uint64_t> dest, phys_ptr<uint64_t> source, size_t block_count) {
+  for (size_t i = 0; i < block_count; ++i) {
+    sha2_copy_compress<sha512_arch_ops>(hash, dest, source);
+    dest += 16;
+    source += 16;
+  }
+}
+
+// Two interleaved lanes let the core overlap the dependency chains of their
+// rounds.
+//
+// NOTE: Each lane needs 24 live words (8 working variables and 16 message
+//       schedule words), so two lanes don't fit in the 31 general-purpose
+//       registers, and the compiler spills some schedule words to the stack.
+//       The spills are off the rounds' critical path, but the lane count has
+//       not been measured against the single-lane kernel.
+constexpr size_t sha256_lanes = 2;
+
+inline void sha256_compress_multi(uint32_t (&hash)[sha256_lanes][8],
+    const uintptr_t (&blocks)[sha256_lanes]) {
+  sha2_compress_interleaved<sha256_arch_ops, sha256_lanes>(hash, blocks);
+}
+
+};  // namespace sanctum::crypto
+};  // namespace sanctum
+#endif  // !defined(CRYPTO_ARCH_RISCV_HASH_ARCH_H_INCLUDED)
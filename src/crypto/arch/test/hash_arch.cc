@@ -0,0 +1,30 @@
+#include "../../hash_inl.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+namespace sanctum {
+namespace testing {
+
+bool cpu_has_sha_extensions() {
+#if defined(__x86_64__) || defined(__i386__)
+  unsigned int eax, ebx, ecx, edx;
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+    return false;
+  // SSSE3 is ECX bit 9, SSE4.1 is ECX bit 19.
+  if ((ecx & (1 << 9)) == 0 || (ecx & (1 << 19)) == 0)
+    return false;
+  if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+    return false;
+  // SHA is EBX bit 29.
+  return (ebx & (1 << 29)) != 0;
+#else  // defined(__x86_64__) || defined(__i386__)
+  return false;
+#endif  // defined(__x86_64__) || defined(__i386__)
+}
+
+bool use_sha_extensions = cpu_has_sha_extensions();
+
+};  // namespace sanctum::testing
+};  // namespace sanctum
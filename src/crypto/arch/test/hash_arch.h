@@ -0,0 +1,227 @@
+#if !defined(CRYPTO_ARCH_TEST_HASH_ARCH_H_INCLUDED)
+#define CRYPTO_ARCH_TEST_HASH_ARCH_H_INCLUDED
+
+#include <cassert>  // Block loads use assert for bound-checking.
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace sanctum {
+namespace testing {
+
+// For testing, SHA-256 uses the x86 SHA extensions when this is true.
+//
+// This is initialized to true if the host CPU supports the extensions. Tests
+// clear it to exercise the portable code.
+extern bool use_sha_extensions;
+
+// True if the host CPU supports the x86 SHA extensions.
+bool cpu_has_sha_extensions();
+
+};  // namespace sanctum::testing
+};  // namespace sanctum
+
+namespace sanctum {
+namespace crypto {
+
+#if defined(__x86_64__) || defined(__i386__)
+
+// Runs the SHA-256 compression function using the x86 SHA extensions.
+//
+// `data` points to block_count * 64 bytes in host memory. If `copy` is not
+// null, the blocks are also stored there, as they are loaded.
+__attribute__((target("sha,sse4.1"))) inline void sha256_compress_blocks_x86(
+    uint32_t (&hash)[8], const char* data, size_t block_count,
+    char* copy = nullptr) {
+  const __m128i byte_swap_mask =
+      _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+  // The SHA instructions want the state as ABEF and CDGH.
+  __m128i cdab = _mm_shuffle_epi32(
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(&hash[0])), 0xB1);
+  __m128i hgfe = _mm_shuffle_epi32(
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(&hash[4])), 0x1B);
+  __m128i abef = _mm_alignr_epi8(cdab, hgfe, 8);
+  __m128i cdgh = _mm_blend_epi16(hgfe, cdab, 0xF0);
+
+  for (size_t block = 0; block < block_count; ++block) {
+    const __m128i saved_abef = abef, saved_cdgh = cdgh;
+
+    // msg[i & 3] holds the message schedule words 4i through 4i + 3.
+    __m128i msg[4];
+    for (size_t i = 0; i < 4; ++i) {
+      const __m128i raw =
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16 * i));
+      if (copy != nullptr)
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(copy + 16 * i), raw);
+      msg[i] = _mm_shuffle_epi8(raw, byte_swap_mask);
+    }
+    for (size_t i = 0; i < 16; ++i) {
+      const __m128i wk = _mm_add_epi32(msg[i & 3],
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(&sha256_k[4 * i])));
+      cdgh = _mm_sha256rnds2_epu32(cdgh, abef, wk);
+      abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(wk, 0x0E));
+
+      if (i < 12) {
+        __m128i next = _mm_sha256msg1_epu32(msg[i & 3], msg[(i + 1) & 3]);
+        next = _mm_add_epi32(next,
+            _mm_alignr_epi8(msg[(i + 3) & 3], msg[(i + 2) & 3], 4));
+        msg[i & 3] = _mm_sha256msg2_epu32(next, msg[(i + 3) & 3]);
+      }
+    }
+
+    abef = _mm_add_epi32(abef, saved_abef);
+    cdgh = _mm_add_epi32(cdgh, saved_cdgh);
+    data += 64;
+    if (copy != nullptr)
+      copy += 64;
+  }
+
+  const __m128i feba = _mm_shuffle_epi32(abef, 0x1B);
+  const __m128i dchg = _mm_shuffle_epi32(cdgh, 0xB1);
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(&hash[0]),
+      _mm_blend_epi16(feba, dchg, 0xF0));
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(&hash[4]),
+      _mm_alignr_epi8(dchg, feba, 8));
+}
+
+#endif  // defined(__x86_64__) || defined(__i386__)
+
+inline void sha256_compress_blocks(uint32_t (&hash)[8],
+    phys_ptr<uint32_t> blocks, size_t block_count) {
+#if defined(__x86_64__) || defined(__i386__)
+  if (testing::use_sha_extensions) {
+    const uintptr_t addr = blocks.operator uintptr_t();
+    // NOTE: the assert would be prohibitively expensive in real code, but this
+    //       implementation is only used by unit tests
+    assert(addr + block_count * 64 <= testing::phys_buffer_size);
+    sha256_compress_blocks_x86(hash, &testing::phys_buffer[addr], block_count);
+    return;
+  }
+#endif  // defined(__x86_64__) || defined(__i386__)
+
+  for (size_t i = 0; i < block_count; ++i) {
+    sha2_compress<sha256_portable_ops>(hash, blocks);
+    blocks += 16;
+  }
+}
+
+inline void sha512_compress_blocks(uint64_t (&hash)[8],
+    phys_ptr<uint64_t> blocks, size_t block_count) {
+  for (size_t i = 0; i < block_count; ++i) {
+    sha2_compress<sha512_portable_ops>(hash, blocks);
+    blocks += 16;
+  }
+}
+
+inline void sha256_copy_compress_blocks(uint32_t (&hash)[8],
+    phys_ptr<uint32_t> dest, phys_ptr<uint32_t> source, size_t block_count) {
+#if defined(__x86_64__) || defined(__i386__)
+  if (testing::use_sha_extensions) {
+    const uintptr_t dest_addr = dest.operator uintptr_t();
+    const uintptr_t source_addr = source.operator uintptr_t();
+    assert(dest_addr + block_count * 64 <= testing::phys_buffer_size);
+    assert(source_addr + block_count * 64 <= testing::phys_buffer_size);
+    sha256_compress_blocks_x86(hash, &testing::phys_buffer[source_addr],
+        block_count, &testing::phys_buffer[dest_addr]);
+    return;
+  }
+#endif  // defined(__x86_64__) || defined(__i386__)
+
+  for (size_t i = 0; i < block_count; ++i) {
+    sha2_copy_compress<sha256_portable_ops>(hash, dest, source);
+    dest += 16;
+    source += 16;
+  }
+}
+
+inline void sha512_copy_compress_blocks(uint64_t (&hash)[8],
+    phys_ptr<uint64_t> dest, phys_ptr<uint64_t> source, size_t block_count) {
+  for (size_t i = 0; i < block_count; ++i) {
+    sha2_copy_compress<sha512_portable_ops>(hash, dest, source);
+    dest += 16;
+    source += 16;
+  }
+}
+
+// Each lane is a 32-bit element in a 128-bit vector.
+//
+// This uses the compiler's generic vector extensions, which map onto SSE2 on
+// x86 and onto NEON on ARM hosts.
+constexpr size_t sha256_lanes = 4;
+typedef uint32_t sha256_lane_word_t
+    __attribute__((vector_size(sha256_lanes * sizeof(uint32_t))));
+
+inline sha256_lane_word_t sha256_lane_rotate_right(sha256_lane_word_t value,
+    int size) {
+  return (value >> size) | (value << (32 - size));
+}
+
+// Runs the SHA-256 compression function on one block per vector lane.
+inline void sha256_compress_vector(uint32_t (&hash)[sha256_lanes][8],
+    const uintptr_t (&blocks)[sha256_lanes]) {
+  sha256_lane_word_t s[8], w[16];
+  for (size_t i = 0; i < 8; ++i) {
+    for (size_t lane = 0; lane < sha256_lanes; ++lane)
+      s[i][lane] = hash[lane][i];
+  }
+
+  sha256_lane_word_t a = s[0], b = s[1], c = s[2], d = s[3];
+  sha256_lane_word_t e = s[4], f = s[5], g = s[6], h = s[7];
+  for (size_t i = 0; i < 64; ++i) {
+    if (i < 16) {
+      for (size_t lane = 0; lane < sha256_lanes; ++lane) {
+        phys_ptr<uint32_t> block{blocks[lane]};
+        w[i][lane] = to_big_endian(block[i]);
+      }
+    } else {
+      const sha256_lane_word_t w15 = w[(i - 15) & 0xf], w2 = w[(i - 2) & 0xf];
+      w[i & 0xf] += (sha256_lane_rotate_right(w15, 7) ^
+          sha256_lane_rotate_right(w15, 18) ^ (w15 >> 3)) +
+          w[(i - 7) & 0xf] + (sha256_lane_rotate_right(w2, 17) ^
+          sha256_lane_rotate_right(w2, 19) ^ (w2 >> 10));
+    }
+
+    const sha256_lane_word_t ch = (e & f) ^ ((~e) & g);
+    const sha256_lane_word_t maj = (a & b) ^ (a & c) ^ (b & c);
+    const sha256_lane_word_t sum0 = sha256_lane_rotate_right(a, 2) ^
+        sha256_lane_rotate_right(a, 13) ^ sha256_lane_rotate_right(a, 22);
+    const sha256_lane_word_t sum1 = sha256_lane_rotate_right(e, 6) ^
+        sha256_lane_rotate_right(e, 11) ^ sha256_lane_rotate_right(e, 25);
+    const sha256_lane_word_t temp1 = h + sum1 + ch + sha256_k[i] + w[i & 0xf];
+    const sha256_lane_word_t temp2 = sum0 + maj;
+
+    h = g; g = f; f = e;
+    e = d + temp1;
+    d = c; c = b; b = a;
+    a = temp1 + temp2;
+  }
+  s[0] += a; s[1] += b; s[2] += c; s[3] += d;
+  s[4] += e; s[5] += f; s[6] += g; s[7] += h;
+
+  for (size_t i = 0; i < 8; ++i) {
+    for (size_t lane = 0; lane < sha256_lanes; ++lane)
+      hash[lane][i] = s[i][lane];
+  }
+}
+
+inline void sha256_compress_multi(uint32_t (&hash)[sha256_lanes][8],
+    const uintptr_t (&blocks)[sha256_lanes]) {
+#if defined(__x86_64__) || defined(__i386__)
+  // NOTE: a single SHA extensions stream is faster than four vector lanes
+  if (testing::use_sha_extensions) {
+    for (size_t lane = 0; lane < sha256_lanes; ++lane) {
+      phys_ptr<uint32_t> block{blocks[lane]};
+      sha256_compress_blocks(hash[lane], block, 1);
+    }
+    return;
+  }
+#endif  // defined(__x86_64__) || defined(__i386__)
+
+  sha256_compress_vector(hash, blocks);
+}
+
+};  // namespace sanctum::crypto
+};  // namespace sanctum
+#endif  // !defined(CRYPTO_ARCH_TEST_HASH_ARCH_H_INCLUDED)
@@ -6,6 +6,7 @@
     'crypto_sources': [
       'hash.cc',
       'hash.h',
+      'hash_inl.h',
     ],
   },
   'targets': [
@@ -15,6 +16,11 @@
       'type': '<(library)',
       'sources': [
         '<@(crypto_sources)',
+        'arch/riscv/hash_arch.h',
+      ],
+      'include_dirs': [
+        '..',
+        'arch/riscv',
       ],
       'target_defaults': {
         'cflags_cc+': [
@@ -25,6 +31,7 @@
       'direct_dependent_settings': {
         'include_dirs': [
           '..',
+          'arch/riscv',
         ],
       },
       'dependencies': [
@@ -37,6 +44,12 @@
       'type': '<(library)',
       'sources': [
         '<@(crypto_sources)',
+        'arch/test/hash_arch.cc',
+        'arch/test/hash_arch.h',
+      ],
+      'include_dirs': [
+        '..',
+        'arch/test',
       ],
       'dependencies': [
         '../bare/bare.gyp:bare_testing',
@@ -46,6 +59,7 @@
       'direct_dependent_settings': {
         'include_dirs': [
           '..',
+          'arch/test',
         ],
       },
     },
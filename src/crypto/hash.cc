@@ -3,6 +3,7 @@
 #include "bare/base_types.h"
 #include "bare/bit_masking.h"
 #include "bare/memory.h"
+#include "hash_inl.h"
 
 using sanctum::bare::bcopy;
 using sanctum::bare::bzero;
@@ -11,79 +12,37 @@ using sanctum::bare::phys_ptr;
 using sanctum::bare::reverse_bytes;
 using sanctum::bare::size_t;
 using sanctum::bare::uint32_t;
+using sanctum::bare::uint64_t;
 using sanctum::bare::uintptr_t;
+using sanctum::crypto::basic_hash_state_t;
+using sanctum::crypto::clamp_to_32;
+using sanctum::crypto::hash_traits;
+using sanctum::crypto::rotate_right;
+using sanctum::crypto::sha256_k;
+using sanctum::crypto::sha256_policy;
+using sanctum::crypto::sha512_256_policy;
+using sanctum::crypto::to_big_endian;
 
 namespace {
 
-// SHA-256 constants table.
-static uint32_t hash_k[] = {
-	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
-	0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
-	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
-	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
-	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
-	0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
-	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
-	0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
-	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
-	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
-	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
-	0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
-	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
-	0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
-	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
-	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
-};
-
-static_assert(sizeof(hash_k) == 64 * sizeof(uint32_t),
-    "Incorrectly sized constant table");
-
-constexpr inline uint32_t rotate_right(uint32_t value, size_t size) {
-  return (value >> size) | (value << (32 - size));
-}
-constexpr inline uint32_t clamp_to_32(uint32_t value) {
-  return (sizeof(uint32_t) == 4) ? value :
-      (value & ((1 << 31) | ((1 << 31) - 1)));
-}
-constexpr inline uint32_t to_big_endian(uint32_t value) {
-  return is_big_endian() ? value : reverse_bytes(value);
-}
-
-};  // anonymous namespace
-
-namespace sanctum {
-namespace crypto {  // sanctum::crypto
+// Reference implementation of the SHA-256 compression function.
+//
+// `hash` holds the intermediate hash value, and is updated in place. `w` points
+// to the 16-word area that holds the message schedule.
+//
+// This is a straightforward transcription of the SHA-256 specification. It is
+// kept around to cross-check the SHA-256 kernels.
+inline void compress_block_reference(uint32_t (&hash)[8], phys_ptr<uint32_t> w,
+    phys_ptr<uint32_t> block) {
+  uint32_t a = hash[0];
+  uint32_t b = hash[1];
+  uint32_t c = hash[2];
+  uint32_t d = hash[3];
+  uint32_t e = hash[4];
+  uint32_t f = hash[5];
+  uint32_t g = hash[6];
+  uint32_t h = hash[7];
 
-void init_hash(phys_ptr<hash_state_t> state) {
-  (state->*(&hash_state_t::h))[0] = 0x6a09e667;
-  (state->*(&hash_state_t::h))[1] = 0xbb67ae85;
-  (state->*(&hash_state_t::h))[2] = 0x3c6ef372;
-  (state->*(&hash_state_t::h))[3] = 0xa54ff53a;
-  (state->*(&hash_state_t::h))[4] = 0x510e527f;
-  (state->*(&hash_state_t::h))[5] = 0x9b05688c;
-  (state->*(&hash_state_t::h))[6] = 0x1f83d9ab;
-  (state->*(&hash_state_t::h))[7] = 0x5be0cd19;
-
-  bzero(state->*(&hash_state_t::padding), hash_block_size);
-
-  uintptr_t padding_addr = uintptr_t(state->*(&hash_state_t::padding));
-  phys_ptr<uint32_t> padding_start{padding_addr};
-  *padding_start =
-      to_big_endian((static_cast<uint32_t>(1) << (sizeof(uint32_t) * 8 - 1)));
-}
-
-void extend_hash(phys_ptr<hash_state_t> state, phys_ptr<uint32_t> block) {
-  phys_ptr<uint32_t> hptr = state->*(&hash_state_t::h);
-  uint32_t a = hptr[0];
-  uint32_t b = hptr[1];
-  uint32_t c = hptr[2];
-  uint32_t d = hptr[3];
-  uint32_t e = hptr[4];
-  uint32_t f = hptr[5];
-  uint32_t g = hptr[6];
-  uint32_t h = hptr[7];
-
-  phys_ptr<uint32_t> w = state->*(&hash_state_t::work_area);
   for (size_t i = 0; i < 64; ++i) {
     uint32_t wi;
     if (i < 16) {
@@ -105,7 +64,7 @@ void extend_hash(phys_ptr<hash_state_t> state, phys_ptr<uint32_t> block) {
         rotate_right(a, 22);
     uint32_t sigma1 = rotate_right(e, 6) ^ rotate_right(e, 11) ^
         rotate_right(e, 25);
-    uint32_t temp1 = h + sigma1 + ch + hash_k[i] + wi;
+    uint32_t temp1 = h + sigma1 + ch + sha256_k[i] + wi;
     uint32_t temp2 = sigma0 + maj;
 
     h = g; g = f; f = e;
@@ -114,29 +73,194 @@ void extend_hash(phys_ptr<hash_state_t> state, phys_ptr<uint32_t> block) {
     a = temp1 + temp2;
   }
 
-  hptr[0] = clamp_to_32(hptr[0] + a);
-  hptr[1] = clamp_to_32(hptr[1] + b);
-  hptr[2] = clamp_to_32(hptr[2] + c);
-  hptr[3] = clamp_to_32(hptr[3] + d);
-  hptr[4] = clamp_to_32(hptr[4] + e);
-  hptr[5] = clamp_to_32(hptr[5] + f);
-  hptr[6] = clamp_to_32(hptr[6] + g);
-  hptr[7] = clamp_to_32(hptr[7] + h);
-
-  // The bit counter is the last 64 bits of the hash.
-  uintptr_t counter_addr = uintptr_t(state->*(&hash_state_t::padding)) +
-      hash_block_size - 4;
+  hash[0] = clamp_to_32(hash[0] + a);
+  hash[1] = clamp_to_32(hash[1] + b);
+  hash[2] = clamp_to_32(hash[2] + c);
+  hash[3] = clamp_to_32(hash[3] + d);
+  hash[4] = clamp_to_32(hash[4] + e);
+  hash[5] = clamp_to_32(hash[5] + f);
+  hash[6] = clamp_to_32(hash[6] + g);
+  hash[7] = clamp_to_32(hash[7] + h);
+}
+
+// Adds a number of hashed blocks to the message length in the padding block.
+template<typename Policy>
+inline void add_to_bit_counter(phys_ptr<basic_hash_state_t<Policy>> state,
+    size_t block_count) {
+  // The message length is a big-endian number in the last length_size bytes
+  // of the padding block. It is updated 32 bits at a time, so the same code
+  // works for all the policies and for all native word sizes.
+  constexpr size_t counter_words = Policy::length_size / sizeof(uint32_t);
+  uintptr_t counter_addr = uintptr_t(
+      state->*(&basic_hash_state_t<Policy>::padding)) + Policy::block_size -
+      Policy::length_size;
   phys_ptr<uint32_t> counter_ptr{counter_addr};
 
-  // TODO: handle overflow
-  uint32_t hashed_bits = to_big_endian(*counter_ptr);
-  *counter_ptr = to_big_endian(hashed_bits + hash_block_size * 8);
+  // NOTE: block_count * block_size * 8 can exceed 32 bits when hashing large
+  //       buffers, so the carry is computed using native-width math
+  size_t added_bits = block_count * Policy::block_size * 8;
+  uint32_t carry = 0;
+  for (size_t i = counter_words; i > 0; --i) {
+    if (added_bits == 0 && carry == 0)
+      break;
+
+    const uint32_t old_word = to_big_endian(counter_ptr[i - 1]);
+    const uint32_t partial_word = clamp_to_32(old_word +
+        static_cast<uint32_t>(added_bits));
+    const uint32_t new_word = clamp_to_32(partial_word + carry);
+    carry = (partial_word < old_word || new_word < partial_word) ? 1 : 0;
+    counter_ptr[i - 1] = to_big_endian(new_word);
+
+    added_bits = (added_bits >> 16) >> 16;
+  }
 }
 
-void finalize_hash(phys_ptr<hash_state_t> state) {
-  uintptr_t padding_addr = uintptr_t(state->*(&hash_state_t::padding));
-  extend_hash(state, phys_ptr<uint32_t>{padding_addr});
+};  // anonymous namespace
+
+namespace sanctum {
+namespace crypto {  // sanctum::crypto
+
+template<typename Policy>
+void init_hash(phys_ptr<basic_hash_state_t<Policy>> state) {
+  typedef typename Policy::word_t word_t;
+
+  phys_ptr<word_t> hptr = state->*(&basic_hash_state_t<Policy>::h);
+  for (size_t i = 0; i < 8; ++i)
+    hptr[i] = hash_traits<Policy>::initial_hash(i);
+
+  bzero(state->*(&basic_hash_state_t<Policy>::padding), Policy::block_size);
+
+  uintptr_t padding_addr = uintptr_t(
+      state->*(&basic_hash_state_t<Policy>::padding));
+  phys_ptr<uint32_t> padding_start{padding_addr};
+  *padding_start =
+      to_big_endian((static_cast<uint32_t>(1) << (sizeof(uint32_t) * 8 - 1)));
 }
 
+template<typename Policy>
+void extend_hash(phys_ptr<basic_hash_state_t<Policy>> state,
+    phys_ptr<typename Policy::word_t> block) {
+  extend_hash_blocks(state, block, 1);
+}
+
+template<typename Policy>
+void extend_hash_blocks(phys_ptr<basic_hash_state_t<Policy>> state,
+    phys_ptr<typename Policy::word_t> blocks, size_t block_count) {
+  typedef typename Policy::word_t word_t;
+
+  phys_ptr<word_t> hptr = state->*(&basic_hash_state_t<Policy>::h);
+  word_t hash[8];
+  for (size_t i = 0; i < 8; ++i)
+    hash[i] = hptr[i];
+
+  hash_traits<Policy>::compress_blocks(hash, blocks, block_count);
+
+  for (size_t i = 0; i < 8; ++i)
+    hptr[i] = hash[i];
+
+  add_to_bit_counter(state, block_count);
+}
+
+template<typename Policy>
+void copy_and_extend_hash_blocks(phys_ptr<basic_hash_state_t<Policy>> state,
+    phys_ptr<typename Policy::word_t> dest,
+    phys_ptr<typename Policy::word_t> source, size_t block_count) {
+  typedef typename Policy::word_t word_t;
+
+  phys_ptr<word_t> hptr = state->*(&basic_hash_state_t<Policy>::h);
+  word_t hash[8];
+  for (size_t i = 0; i < 8; ++i)
+    hash[i] = hptr[i];
+
+  hash_traits<Policy>::copy_compress_blocks(hash, dest, source, block_count);
+
+  for (size_t i = 0; i < 8; ++i)
+    hptr[i] = hash[i];
+
+  add_to_bit_counter(state, block_count);
+}
+
+template<typename Policy>
+void extend_hash_multi(phys_ptr<basic_hash_state_t<Policy>> states[],
+    phys_ptr<typename Policy::word_t> blocks[], size_t count) {
+  typedef typename Policy::word_t word_t;
+  constexpr size_t lanes = hash_traits<Policy>::lanes;
+
+  for (size_t first = 0; first < count; first += lanes) {
+    word_t hash[lanes][8];
+    uintptr_t lane_blocks[lanes];
+    for (size_t lane = 0; lane < lanes; ++lane) {
+      // The lanes past the end of the arrays repeat the last state. Their
+      // results are discarded.
+      const size_t i = (first + lane < count) ? first + lane : count - 1;
+      phys_ptr<word_t> hptr = states[i]->*(&basic_hash_state_t<Policy>::h);
+      for (size_t j = 0; j < 8; ++j)
+        hash[lane][j] = hptr[j];
+      lane_blocks[lane] = uintptr_t(blocks[i]);
+    }
+
+    hash_traits<Policy>::compress_multi(hash, lane_blocks);
+
+    for (size_t lane = 0; lane < lanes && first + lane < count; ++lane) {
+      phys_ptr<word_t> hptr =
+          states[first + lane]->*(&basic_hash_state_t<Policy>::h);
+      for (size_t j = 0; j < 8; ++j)
+        hptr[j] = hash[lane][j];
+      add_to_bit_counter(states[first + lane], 1);
+    }
+  }
+}
+
+void extend_hash_reference(
+    phys_ptr<basic_hash_state_t<sha256_policy>> state,
+    phys_ptr<uint32_t> block) {
+  phys_ptr<uint32_t> hptr =
+      state->*(&basic_hash_state_t<sha256_policy>::h);
+  uint32_t hash[8];
+  for (size_t i = 0; i < 8; ++i)
+    hash[i] = hptr[i];
+
+  compress_block_reference(hash,
+      state->*(&basic_hash_state_t<sha256_policy>::work_area), block);
+
+  for (size_t i = 0; i < 8; ++i)
+    hptr[i] = hash[i];
+  add_to_bit_counter(state, 1);
+}
+
+template<typename Policy>
+void finalize_hash(phys_ptr<basic_hash_state_t<Policy>> state) {
+  uintptr_t padding_addr = uintptr_t(
+      state->*(&basic_hash_state_t<Policy>::padding));
+  extend_hash(state, phys_ptr<typename Policy::word_t>{padding_addr});
+}
+
+// The hashing functions are only instantiated for the policies in hash.h.
+template void init_hash(phys_ptr<basic_hash_state_t<sha256_policy>>);
+template void extend_hash(phys_ptr<basic_hash_state_t<sha256_policy>>,
+    phys_ptr<uint32_t>);
+template void extend_hash_blocks(
+    phys_ptr<basic_hash_state_t<sha256_policy>>, phys_ptr<uint32_t>, size_t);
+template void copy_and_extend_hash_blocks(
+    phys_ptr<basic_hash_state_t<sha256_policy>>, phys_ptr<uint32_t>,
+    phys_ptr<uint32_t>, size_t);
+template void extend_hash_multi(phys_ptr<basic_hash_state_t<sha256_policy>>[],
+    phys_ptr<uint32_t>[], size_t);
+template void finalize_hash(phys_ptr<basic_hash_state_t<sha256_policy>>);
+
+template void init_hash(phys_ptr<basic_hash_state_t<sha512_256_policy>>);
+template void extend_hash(phys_ptr<basic_hash_state_t<sha512_256_policy>>,
+    phys_ptr<uint64_t>);
+template void extend_hash_blocks(
+    phys_ptr<basic_hash_state_t<sha512_256_policy>>, phys_ptr<uint64_t>,
+    size_t);
+template void copy_and_extend_hash_blocks(
+    phys_ptr<basic_hash_state_t<sha512_256_policy>>, phys_ptr<uint64_t>,
+    phys_ptr<uint64_t>, size_t);
+template void extend_hash_multi(
+    phys_ptr<basic_hash_state_t<sha512_256_policy>>[], phys_ptr<uint64_t>[],
+    size_t);
+template void finalize_hash(phys_ptr<basic_hash_state_t<sha512_256_policy>>);
+
 };  // namespace sanctum::crypto
 };  // namespace sanctum
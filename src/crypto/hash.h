@@ -10,47 +10,137 @@ namespace crypto {
 using sanctum::bare::phys_ptr;
 using sanctum::bare::size_t;
 using sanctum::bare::uint32_t;
+using sanctum::bare::uint64_t;
 using sanctum::bare::uintptr_t;
 
+// Hashing algorithm policies.
+//
+// The hashing functions below are templates that take one of these policies.
+// The monitor uses the policy selected by hash_policy_t.
+
+// SHA-256, which operates on 32-bit words.
+struct sha256_policy {
+  // The type of the words in the hash state and in the message blocks.
+  typedef uint32_t word_t;
+  // The size of a message block, in bytes.
+  static constexpr size_t block_size = 64;  // 512 bits
+  // The size of the result of a hashing operation.
+  static constexpr size_t result_size = 32;  // 256 bits
+  // The size of the message length at the end of the padding block.
+  static constexpr size_t length_size = 8;  // 64 bits
+};
+
+// SHA-512/256, which operates on 64-bit words.
+//
+// On 64-bit cores, this hashes more bytes per cycle than SHA-256.
+struct sha512_256_policy {
+  typedef uint64_t word_t;
+  static constexpr size_t block_size = 128;  // 1024 bits
+  static constexpr size_t result_size = 32;  // 256 bits
+  static constexpr size_t length_size = 16;  // 128 bits
+};
+
+// The hashing algorithm used by the monitor.
+//
+// Building with SANCTUM_HASH_SHA512_256 defined selects SHA-512/256. This is
+// controlled by the hash_algorithm gyp variable.
+#if defined(SANCTUM_HASH_SHA512_256)
+typedef sha512_256_policy hash_policy_t;
+#else  // defined(SANCTUM_HASH_SHA512_256)
+typedef sha256_policy hash_policy_t;
+#endif  // defined(SANCTUM_HASH_SHA512_256)
+
 // The block size for the hashing algorithm, in bytes.
 //
 // The hashing algorithm implemented here processes data in blocks.
 //
 // The block size is guaranteed to be a multiple of the sizes of size_t and
 // uintptr_t.
-constexpr size_t hash_block_size = 64;  // 512 bits
+constexpr size_t hash_block_size = hash_policy_t::block_size;
 static_assert(hash_block_size % sizeof(size_t) == 0,
     "hash_block_size not a multiple of size_t");
 static_assert(hash_block_size % sizeof(uintptr_t) == 0,
     "hash_block_size not a multiple of uintptr_t");
 
 // The size of the result of a hashing operation.
-constexpr size_t hash_result_size = 32;  // 256 bits
+constexpr size_t hash_result_size = hash_policy_t::result_size;
+
+// The type of the words that make up hash blocks.
+typedef hash_policy_t::word_t hash_word_t;
 
-// The data structure used by the SHA-256 funtions.
-struct hash_state_t {
-  uint32_t h[8];  // Stores the final hash.
-  uint32_t work_area[16];  // Stores the message schedule.
-  size_t padding[hash_block_size / sizeof(size_t)];  // The padding block.
+// The data structure used by the hashing functions.
+template<typename Policy> struct basic_hash_state_t {
+  typedef typename Policy::word_t word_t;
+
+  word_t h[8];  // Stores the final hash.
+  word_t work_area[16];  // Message schedule for extend_hash_reference().
+  size_t padding[Policy::block_size / sizeof(size_t)];  // The padding block.
 };
 
+// The data structure used by the monitor's hashing algorithm.
+typedef basic_hash_state_t<hash_policy_t> hash_state_t;
+
 // Initializes a hashing data structure.
 //
 // This must be called before extend_hash() is used.
-void init_hash(phys_ptr<hash_state_t> state);
+template<typename Policy>
+void init_hash(phys_ptr<basic_hash_state_t<Policy>> state);
 
 // Extends a crypto hash by a block.
 //
-// The block is exactly hash_block_size bytes. init_hash() must be called to
+// The block is exactly Policy::block_size bytes. init_hash() must be called to
 // set up the hashing data structure before this function is used.
-void extend_hash(phys_ptr<hash_state_t> state, phys_ptr<uint32_t> block);
+template<typename Policy>
+void extend_hash(phys_ptr<basic_hash_state_t<Policy>> state,
+    phys_ptr<typename Policy::word_t> block);
+
+// Extends a crypto hash by a sequence of consecutive blocks.
+//
+// This is equivalent to calling extend_hash() once for each block, but it
+// keeps the intermediate hash value in registers between blocks, and only
+// updates the bit counter in the padding block once. `blocks` points to
+// block_count * Policy::block_size bytes.
+template<typename Policy>
+void extend_hash_blocks(phys_ptr<basic_hash_state_t<Policy>> state,
+    phys_ptr<typename Policy::word_t> blocks, size_t block_count);
+
+// Copies a sequence of consecutive blocks, and extends a crypto hash by them.
+//
+// This is equivalent to copying block_count * Policy::block_size bytes from
+// `source` to `dest` and then calling extend_hash_blocks() on `dest`, but each
+// word is loaded from `source` once and hashed while it is in a register, so
+// the copy is never read back. The buffers must not overlap.
+template<typename Policy>
+void copy_and_extend_hash_blocks(phys_ptr<basic_hash_state_t<Policy>> state,
+    phys_ptr<typename Policy::word_t> dest,
+    phys_ptr<typename Policy::word_t> source, size_t block_count);
+
+// Extends several independent crypto hashes by a block each.
+//
+// states[i] is extended by blocks[i], for i between 0 and count - 1. This is
+// equivalent to calling extend_hash() on each pair, but the blocks are hashed
+// in lockstep, which uses the core more efficiently than a single hash can.
+// The states must not overlap.
+template<typename Policy>
+void extend_hash_multi(phys_ptr<basic_hash_state_t<Policy>> states[],
+    phys_ptr<typename Policy::word_t> blocks[], size_t count);
+
+// Extends a crypto hash by a block, using the reference implementation.
+//
+// This produces the same result as extend_hash(), but it is slower, because
+// it follows the SHA-256 specification step by step. It is only intended to be
+// used to cross-check the optimized implementations.
+void extend_hash_reference(
+    phys_ptr<basic_hash_state_t<sha256_policy>> state,
+    phys_ptr<uint32_t> block);
 
 // Finalizes the value in a hashing data structure.
 //
 // After this is called, extend_hash() must not be called again. The final hash
-// value is stored in the first hash_result_size bytes of the hash_state
+// value is stored in the first Policy::result_size bytes of the hash_state
 // structure.
-void finalize_hash(phys_ptr<hash_state_t> state);
+template<typename Policy>
+void finalize_hash(phys_ptr<basic_hash_state_t<Policy>> state);
 
 };  // namespace sanctum::crypto
 };  // namespace sanctum
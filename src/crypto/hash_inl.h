@@ -0,0 +1,481 @@
+#if !defined(CRYPTO_HASH_INL_H_INCLUDED)
+#define CRYPTO_HASH_INL_H_INCLUDED
+
+#include "bare/base_types.h"
+#include "bare/bit_masking.h"
+#include "bare/phys_ptr.h"
+#include "hash.h"
+
+namespace sanctum {
+namespace crypto {  // sanctum::crypto
+
+using sanctum::bare::is_big_endian;
+using sanctum::bare::phys_ptr;
+using sanctum::bare::reverse_bytes;
+using sanctum::bare::size_t;
+using sanctum::bare::uint32_t;
+using sanctum::bare::uint64_t;
+using sanctum::bare::uintptr_t;
+
+// SHA-256 constants table.
+constexpr uint32_t sha256_k[64] = {
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+  0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+  0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+  0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+  0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+  0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+  0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+  0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+  0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+  0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+  0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+  0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+  0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+  0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+  0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+  0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+// The initial hash value for SHA-256.
+constexpr uint32_t sha256_initial_hash[8] = {
+  0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+  0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+// SHA-512 constants table.
+constexpr uint64_t sha512_k[80] = {
+  0x428a2f98d728ae22, 0x7137449123ef65cd,
+  0xb5c0fbcfec4d3b2f, 0xe9b5dba58189dbbc,
+  0x3956c25bf348b538, 0x59f111f1b605d019,
+  0x923f82a4af194f9b, 0xab1c5ed5da6d8118,
+  0xd807aa98a3030242, 0x12835b0145706fbe,
+  0x243185be4ee4b28c, 0x550c7dc3d5ffb4e2,
+  0x72be5d74f27b896f, 0x80deb1fe3b1696b1,
+  0x9bdc06a725c71235, 0xc19bf174cf692694,
+  0xe49b69c19ef14ad2, 0xefbe4786384f25e3,
+  0x0fc19dc68b8cd5b5, 0x240ca1cc77ac9c65,
+  0x2de92c6f592b0275, 0x4a7484aa6ea6e483,
+  0x5cb0a9dcbd41fbd4, 0x76f988da831153b5,
+  0x983e5152ee66dfab, 0xa831c66d2db43210,
+  0xb00327c898fb213f, 0xbf597fc7beef0ee4,
+  0xc6e00bf33da88fc2, 0xd5a79147930aa725,
+  0x06ca6351e003826f, 0x142929670a0e6e70,
+  0x27b70a8546d22ffc, 0x2e1b21385c26c926,
+  0x4d2c6dfc5ac42aed, 0x53380d139d95b3df,
+  0x650a73548baf63de, 0x766a0abb3c77b2a8,
+  0x81c2c92e47edaee6, 0x92722c851482353b,
+  0xa2bfe8a14cf10364, 0xa81a664bbc423001,
+  0xc24b8b70d0f89791, 0xc76c51a30654be30,
+  0xd192e819d6ef5218, 0xd69906245565a910,
+  0xf40e35855771202a, 0x106aa07032bbd1b8,
+  0x19a4c116b8d2d0c8, 0x1e376c085141ab53,
+  0x2748774cdf8eeb99, 0x34b0bcb5e19b48a8,
+  0x391c0cb3c5c95a63, 0x4ed8aa4ae3418acb,
+  0x5b9cca4f7763e373, 0x682e6ff3d6b2b8a3,
+  0x748f82ee5defb2fc, 0x78a5636f43172f60,
+  0x84c87814a1f0ab72, 0x8cc702081a6439ec,
+  0x90befffa23631e28, 0xa4506cebde82bde9,
+  0xbef9a3f7b2c67915, 0xc67178f2e372532b,
+  0xca273eceea26619c, 0xd186b8c721c0c207,
+  0xeada7dd6cde0eb1e, 0xf57d4f7fee6ed178,
+  0x06f067aa72176fba, 0x0a637dc5a2c898a6,
+  0x113f9804bef90dae, 0x1b710b35131c471b,
+  0x28db77f523047d84, 0x32caab7b40c72493,
+  0x3c9ebe0a15c9bebc, 0x431d67c49c100d4c,
+  0x4cc5d4becb3e42b6, 0x597f299cfc657e2a,
+  0x5fcb6fab3ad6faec, 0x6c44198c4a475817
+};
+
+// The initial hash value for SHA-512/256.
+constexpr uint64_t sha512_256_initial_hash[8] = {
+  0x22312194fc2bf72c, 0x9f555fa3c84c64c2,
+  0x2393b86b6f53b151, 0x963877195940eabd,
+  0x96283ee2a88effe3, 0xbe5e1e2553863992,
+  0x2b0199fc2c85b8aa, 0x0eb72ddc81c52ca2
+};
+
+constexpr inline uint32_t rotate_right(uint32_t value, size_t size) {
+  return (value >> size) | (value << (32 - size));
+}
+constexpr inline uint64_t rotate_right(uint64_t value, size_t size) {
+  return (value >> size) | (value << (64 - size));
+}
+constexpr inline uint32_t clamp_to_32(uint32_t value) {
+  return (sizeof(uint32_t) == 4) ? value :
+      (value & ((1 << 31) | ((1 << 31) - 1)));
+}
+constexpr inline uint32_t to_big_endian(uint32_t value) {
+  return is_big_endian() ? value : reverse_bytes(value);
+}
+constexpr inline uint64_t to_big_endian(uint64_t value) {
+  return is_big_endian() ? value : reverse_bytes(value);
+}
+
+// The SHA-256 logical functions.
+//
+// The kernel templates below take a policy type that supplies these functions,
+// the word type, and the round constants, so they can implement both SHA-256
+// and SHA-512. Architectures with dedicated instructions swap in their own
+// logical functions.
+struct sha256_portable_ops {
+  typedef uint32_t word_t;
+  static constexpr size_t rounds = 64;
+
+  static constexpr inline uint32_t k(size_t round) {
+    return sha256_k[round];
+  }
+  static constexpr inline uint32_t sum0(uint32_t a) {
+    return rotate_right(a, 2) ^ rotate_right(a, 13) ^ rotate_right(a, 22);
+  }
+  static constexpr inline uint32_t sum1(uint32_t e) {
+    return rotate_right(e, 6) ^ rotate_right(e, 11) ^ rotate_right(e, 25);
+  }
+  static constexpr inline uint32_t sig0(uint32_t w) {
+    return rotate_right(w, 7) ^ rotate_right(w, 18) ^ clamp_to_32(w >> 3);
+  }
+  static constexpr inline uint32_t sig1(uint32_t w) {
+    return rotate_right(w, 17) ^ rotate_right(w, 19) ^ clamp_to_32(w >> 10);
+  }
+};
+
+// The SHA-512 logical functions.
+struct sha512_portable_ops {
+  typedef uint64_t word_t;
+  static constexpr size_t rounds = 80;
+
+  static constexpr inline uint64_t k(size_t round) {
+    return sha512_k[round];
+  }
+  static constexpr inline uint64_t sum0(uint64_t a) {
+    return rotate_right(a, 28) ^ rotate_right(a, 34) ^ rotate_right(a, 39);
+  }
+  static constexpr inline uint64_t sum1(uint64_t e) {
+    return rotate_right(e, 14) ^ rotate_right(e, 18) ^ rotate_right(e, 41);
+  }
+  static constexpr inline uint64_t sig0(uint64_t w) {
+    return rotate_right(w, 1) ^ rotate_right(w, 8) ^ (w >> 7);
+  }
+  static constexpr inline uint64_t sig1(uint64_t w) {
+    return rotate_right(w, 19) ^ rotate_right(w, 61) ^ (w >> 6);
+  }
+};
+
+// NOTE: The round templates below must be inlined into each other for the
+//       state and message schedule to stay in registers. Compilers give up on
+//       inlining long chains of calls, so we force their hand.
+#define SANCTUM_HASH_ALWAYS_INLINE inline __attribute__((always_inline))
+
+// NOTE: bare/base_types.h guarantees that uint32_t and uint64_t have exactly
+//       32 and 64 bits, so the kernels below rely on unsigned overflow instead
+//       of using clamp_to_32() like the reference implementation
+
+// Reads the message words in a block.
+template<typename Word> struct sha2_block_reader {
+  phys_ptr<Word> block;
+
+  SANCTUM_HASH_ALWAYS_INLINE Word load(size_t i) const {
+    return block[i];
+  }
+};
+
+// Reads the message words in a block, and copies them to another block.
+//
+// This lets the kernels copy a buffer while hashing it, so each word is read
+// from memory once.
+template<typename Word> struct sha2_copying_reader {
+  phys_ptr<Word> source;
+  phys_ptr<Word> dest;
+
+  SANCTUM_HASH_ALWAYS_INLINE Word load(size_t i) const {
+    const Word word = source[i];
+    dest[i] = word;
+    return word;
+  }
+};
+
+// Computes the message schedule word used by a SHA-2 round.
+//
+// The first 16 rounds load their words from the block, using a reader defined
+// above. Later rounds expand the schedule in the 16-word circular buffer `w`.
+template<typename Ops, size_t I, bool from_block = (I < 16)>
+    struct sha2_schedule;
+template<typename Ops, size_t I> struct sha2_schedule<Ops, I, true> {
+  typedef typename Ops::word_t word_t;
+
+  template<typename Reader>
+  static SANCTUM_HASH_ALWAYS_INLINE word_t word(word_t (&w)[16],
+      const Reader& reader) {
+    return w[I] = to_big_endian(reader.load(I));
+  }
+};
+template<typename Ops, size_t I> struct sha2_schedule<Ops, I, false> {
+  typedef typename Ops::word_t word_t;
+
+  template<typename Reader>
+  static SANCTUM_HASH_ALWAYS_INLINE word_t word(word_t (&w)[16],
+      const Reader&) {
+    return w[I & 0xf] = w[I & 0xf] + Ops::sig0(w[(I - 15) & 0xf]) +
+        w[(I - 7) & 0xf] + Ops::sig1(w[(I - 2) & 0xf]);
+  }
+};
+
+// Performs SHA-2 round I.
+//
+// Instead of shifting the working variables a-h after every round, round I
+// uses s[(0 - I) & 7] as a, s[(1 - I) & 7] as b, and so on. The indices are
+// compile-time constants, so the variables are assigned to registers.
+template<typename Ops, size_t I> struct sha2_round {
+  typedef typename Ops::word_t word_t;
+
+  template<typename Reader>
+  static SANCTUM_HASH_ALWAYS_INLINE void run(word_t (&s)[8],
+      word_t (&w)[16], const Reader& reader) {
+    const word_t a = s[(0 - I) & 7];
+    const word_t b = s[(1 - I) & 7];
+    const word_t c = s[(2 - I) & 7];
+    const word_t e = s[(4 - I) & 7];
+    const word_t f = s[(5 - I) & 7];
+    const word_t g = s[(6 - I) & 7];
+
+    const word_t wi = sha2_schedule<Ops, I>::word(w, reader);
+    const word_t ch = (e & f) ^ ((~e) & g);
+    const word_t maj = (a & b) ^ (a & c) ^ (b & c);
+    const word_t temp1 = s[(7 - I) & 7] + Ops::sum1(e) + ch + Ops::k(I) + wi;
+    const word_t temp2 = Ops::sum0(a) + maj;
+
+    // The old d becomes the new e, and the old h becomes the new a.
+    s[(3 - I) & 7] += temp1;
+    s[(7 - I) & 7] = temp1 + temp2;
+  }
+};
+
+// Performs SHA-2 rounds I through Ops::rounds - 1.
+template<typename Ops, size_t I, bool done = (I == Ops::rounds)>
+    struct sha2_rounds {
+  typedef typename Ops::word_t word_t;
+
+  template<typename Reader>
+  static SANCTUM_HASH_ALWAYS_INLINE void run(word_t (&s)[8],
+      word_t (&w)[16], const Reader& reader) {
+    sha2_round<Ops, I>::run(s, w, reader);
+    sha2_rounds<Ops, I + 1>::run(s, w, reader);
+  }
+};
+template<typename Ops, size_t I> struct sha2_rounds<Ops, I, true> {
+  typedef typename Ops::word_t word_t;
+
+  template<typename Reader>
+  static SANCTUM_HASH_ALWAYS_INLINE void run(word_t (&)[8], word_t (&)[16],
+      const Reader&) {
+  }
+};
+
+// Runs the SHA-2 compression function on a block supplied by a reader.
+//
+// `hash` holds the intermediate hash value, and is updated in place. The
+// message schedule lives in locals, so the only memory accesses are the ones
+// done by the reader.
+template<typename Ops, typename Reader>
+SANCTUM_HASH_ALWAYS_INLINE void sha2_compress_from(
+    typename Ops::word_t (&hash)[8], const Reader& reader) {
+  typedef typename Ops::word_t word_t;
+
+  word_t s[8] = {
+    hash[0], hash[1], hash[2], hash[3], hash[4], hash[5], hash[6], hash[7]
+  };
+  word_t w[16];
+  sha2_rounds<Ops, 0>::run(s, w, reader);
+
+  for (size_t i = 0; i < 8; ++i)
+    hash[i] += s[i];
+}
+
+// Runs the SHA-2 compression function on a block.
+template<typename Ops> SANCTUM_HASH_ALWAYS_INLINE void sha2_compress(
+    typename Ops::word_t (&hash)[8], phys_ptr<typename Ops::word_t> block) {
+  const sha2_block_reader<typename Ops::word_t> reader{block};
+  sha2_compress_from<Ops>(hash, reader);
+}
+
+// Copies a block and runs the SHA-2 compression function on it.
+template<typename Ops> SANCTUM_HASH_ALWAYS_INLINE void sha2_copy_compress(
+    typename Ops::word_t (&hash)[8], phys_ptr<typename Ops::word_t> dest,
+    phys_ptr<typename Ops::word_t> source) {
+  const sha2_copying_reader<typename Ops::word_t> reader{source, dest};
+  sha2_compress_from<Ops>(hash, reader);
+}
+
+// Performs SHA-2 round I in lanes Lane through Lanes - 1.
+//
+// Each lane has its own state and message schedule arrays, which are only
+// indexed by compile-time constants, so every lane gets its own set of
+// registers, just like in sha2_rounds.
+template<typename Ops, size_t Lanes, size_t I, size_t Lane = 0,
+    bool done = (Lane == Lanes)> struct sha2_lane_round {
+  typedef typename Ops::word_t word_t;
+
+  static SANCTUM_HASH_ALWAYS_INLINE void run(word_t (&s)[Lanes][8],
+      word_t (&w)[Lanes][16], const uintptr_t (&blocks)[Lanes]) {
+    const sha2_block_reader<word_t> reader{phys_ptr<word_t>{blocks[Lane]}};
+    sha2_round<Ops, I>::run(s[Lane], w[Lane], reader);
+    sha2_lane_round<Ops, Lanes, I, Lane + 1>::run(s, w, blocks);
+  }
+};
+template<typename Ops, size_t Lanes, size_t I, size_t Lane>
+    struct sha2_lane_round<Ops, Lanes, I, Lane, true> {
+  typedef typename Ops::word_t word_t;
+
+  static SANCTUM_HASH_ALWAYS_INLINE void run(word_t (&)[Lanes][8],
+      word_t (&)[Lanes][16], const uintptr_t (&)[Lanes]) {
+  }
+};
+
+// Performs SHA-2 rounds I through Ops::rounds - 1 in every lane.
+//
+// Each round is done in all the lanes before moving on to the next round, so
+// the core can overlap the long dependency chains inside each lane's rounds.
+template<typename Ops, size_t Lanes, size_t I,
+    bool done = (I == Ops::rounds)> struct sha2_interleaved_rounds {
+  typedef typename Ops::word_t word_t;
+
+  static SANCTUM_HASH_ALWAYS_INLINE void run(word_t (&s)[Lanes][8],
+      word_t (&w)[Lanes][16], const uintptr_t (&blocks)[Lanes]) {
+    sha2_lane_round<Ops, Lanes, I>::run(s, w, blocks);
+    sha2_interleaved_rounds<Ops, Lanes, I + 1>::run(s, w, blocks);
+  }
+};
+template<typename Ops, size_t Lanes, size_t I>
+    struct sha2_interleaved_rounds<Ops, Lanes, I, true> {
+  typedef typename Ops::word_t word_t;
+
+  static SANCTUM_HASH_ALWAYS_INLINE void run(word_t (&)[Lanes][8],
+      word_t (&)[Lanes][16], const uintptr_t (&)[Lanes]) {
+  }
+};
+
+// Runs the SHA-2 compression function on Lanes independent blocks.
+//
+// hash[i] holds the intermediate hash value that gets updated with the block
+// at physical address blocks[i].
+template<typename Ops, size_t Lanes>
+SANCTUM_HASH_ALWAYS_INLINE void sha2_compress_interleaved(
+    typename Ops::word_t (&hash)[Lanes][8], const uintptr_t (&blocks)[Lanes]) {
+  typedef typename Ops::word_t word_t;
+
+  word_t s[Lanes][8];
+  word_t w[Lanes][16];
+  for (size_t lane = 0; lane < Lanes; ++lane) {
+    for (size_t i = 0; i < 8; ++i)
+      s[lane][i] = hash[lane][i];
+  }
+  sha2_interleaved_rounds<Ops, Lanes, 0>::run(s, w, blocks);
+
+  for (size_t lane = 0; lane < Lanes; ++lane) {
+    for (size_t i = 0; i < 8; ++i)
+      hash[lane][i] += s[lane][i];
+  }
+}
+
+#undef SANCTUM_HASH_ALWAYS_INLINE
+
+// Runs the SHA-256 compression function on a run of consecutive blocks.
+//
+// `hash` holds the intermediate hash value, and is updated in place. `blocks`
+// points to block_count * 64 bytes.
+//
+// Each architecture supplies an implementation that uses the fastest SHA-256
+// instructions available, and falls back to sha2_compress() with
+// sha256_portable_ops.
+inline void sha256_compress_blocks(uint32_t (&hash)[8],
+    phys_ptr<uint32_t> blocks, size_t block_count);
+
+// Runs the SHA-512 compression function on a run of consecutive blocks.
+//
+// `blocks` points to block_count * 128 bytes. Architectures supply an
+// implementation in the same way as for sha256_compress_blocks().
+inline void sha512_compress_blocks(uint64_t (&hash)[8],
+    phys_ptr<uint64_t> blocks, size_t block_count);
+
+// Copies a run of consecutive blocks, and runs the SHA-256 compression
+// function on them.
+//
+// The result is the same as copying the blocks and then calling
+// sha256_compress_blocks() on the destination, but each word is loaded once.
+inline void sha256_copy_compress_blocks(uint32_t (&hash)[8],
+    phys_ptr<uint32_t> dest, phys_ptr<uint32_t> source, size_t block_count);
+
+// The SHA-512 equivalent of sha256_copy_compress_blocks().
+inline void sha512_copy_compress_blocks(uint64_t (&hash)[8],
+    phys_ptr<uint64_t> dest, phys_ptr<uint64_t> source, size_t block_count);
+
+// Each architecture also defines sha256_lanes, the number of independent
+// blocks that it hashes most efficiently at once, and the function below.
+//
+// inline void sha256_compress_multi(uint32_t (&hash)[sha256_lanes][8],
+//     const uintptr_t (&blocks)[sha256_lanes]);
+//
+// It updates hash[i] with the block at physical address blocks[i].
+
+};  // namespace sanctum::crypto
+};  // namespace sanctum
+
+// Per-architecture SHA-2 kernels.
+#include "hash_arch.h"
+
+namespace sanctum {
+namespace crypto {  // sanctum::crypto
+
+// The algorithm-specific parts of the hashing functions.
+//
+// This maps each hashing policy in hash.h to its initial hash value and to the
+// architecture's kernels.
+template<typename Policy> struct hash_traits;
+
+template<> struct hash_traits<sha256_policy> {
+  static constexpr size_t lanes = sha256_lanes;
+
+  static constexpr inline uint32_t initial_hash(size_t i) {
+    return sha256_initial_hash[i];
+  }
+  static inline void compress_blocks(uint32_t (&hash)[8],
+      phys_ptr<uint32_t> blocks, size_t block_count) {
+    sha256_compress_blocks(hash, blocks, block_count);
+  }
+  static inline void copy_compress_blocks(uint32_t (&hash)[8],
+      phys_ptr<uint32_t> dest, phys_ptr<uint32_t> source,
+      size_t block_count) {
+    sha256_copy_compress_blocks(hash, dest, source, block_count);
+  }
+  static inline void compress_multi(uint32_t (&hash)[lanes][8],
+      const uintptr_t (&blocks)[lanes]) {
+    sha256_compress_multi(hash, blocks);
+  }
+};
+
+template<> struct hash_traits<sha512_256_policy> {
+  // NOTE: 64-bit cores already get most of their throughput from the wider
+  //       words, so SHA-512/256 hashes independent states one at a time
+  static constexpr size_t lanes = 1;
+
+  static constexpr inline uint64_t initial_hash(size_t i) {
+    return sha512_256_initial_hash[i];
+  }
+  static inline void compress_blocks(uint64_t (&hash)[8],
+      phys_ptr<uint64_t> blocks, size_t block_count) {
+    sha512_compress_blocks(hash, blocks, block_count);
+  }
+  static inline void copy_compress_blocks(uint64_t (&hash)[8],
+      phys_ptr<uint64_t> dest, phys_ptr<uint64_t> source,
+      size_t block_count) {
+    sha512_copy_compress_blocks(hash, dest, source, block_count);
+  }
+  static inline void compress_multi(uint64_t (&hash)[lanes][8],
+      const uintptr_t (&blocks)[lanes]) {
+    sha512_compress_blocks(hash[0], phys_ptr<uint64_t>{blocks[0]}, 1);
+  }
+};
+
+};  // namespace sanctum::crypto
+};  // namespace sanctum
+#endif  // !defined(CRYPTO_HASH_INL_H_INCLUDED)
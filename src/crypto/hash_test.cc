@@ -1,16 +1,36 @@
 #include "hash.h"
+#include "hash_inl.h"
 
 #include "gtest/gtest.h"
 
 using sanctum::bare::phys_ptr;
 using sanctum::bare::uint32_t;
+using sanctum::bare::uint64_t;
+using sanctum::crypto::copy_and_extend_hash_blocks;
 using sanctum::crypto::extend_hash;
+using sanctum::crypto::extend_hash_blocks;
+using sanctum::crypto::extend_hash_multi;
+using sanctum::crypto::extend_hash_reference;
+using sanctum::crypto::basic_hash_state_t;
 using sanctum::crypto::finalize_hash;
-using sanctum::crypto::hash_block_size;
-using sanctum::crypto::hash_state_t;
 using sanctum::crypto::init_hash;
+using sanctum::crypto::sha2_compress;
+using sanctum::crypto::sha2_compress_interleaved;
+using sanctum::crypto::sha256_initial_hash;
+using sanctum::crypto::sha256_portable_ops;
+using sanctum::crypto::sha256_policy;
+using sanctum::crypto::sha512_256_policy;
 using sanctum::testing::phys_buffer;
 using sanctum::testing::phys_buffer_size;
+using sanctum::testing::use_sha_extensions;
+
+// Most tests check SHA-256 test vectors, regardless of the hashing algorithm
+// selected for the monitor.
+typedef basic_hash_state_t<sha256_policy> hash_state_t;
+constexpr size_t hash_block_size = sha256_policy::block_size;
+
+typedef basic_hash_state_t<sha512_256_policy> sha512_256_state_t;
+constexpr size_t sha512_256_block_size = sha512_256_policy::block_size;
 
 TEST(HashTest, EmptyString) {
   uintptr_t hash_addr = 160;
@@ -107,3 +127,473 @@ TEST(HashTest, PageOfU) {
   EXPECT_EQ(0xfbaa8c16, h[6]);
   EXPECT_EQ(0x84db80c3, h[7]);
 }
+
+TEST(HashTest, PageOfUAsBlocks) {
+  uintptr_t hash_addr = 160;
+  uintptr_t block_addr = 400;
+
+  ASSERT_LE(400 + 4096, phys_buffer_size);
+  memset(phys_buffer + 400, 'U', 4096);
+
+  phys_ptr<hash_state_t> state{hash_addr};
+  init_hash(state);
+  phys_ptr<uint32_t> blocks{block_addr};
+  extend_hash_blocks(state, blocks, 4096 / hash_block_size);
+  finalize_hash(state);
+
+  phys_ptr<uint32_t> h = state->*(&hash_state_t::h);
+  EXPECT_EQ(0x0561079e, h[0]);
+  EXPECT_EQ(0x4fe3390b, h[1]);
+  EXPECT_EQ(0xc1d8bb70, h[2]);
+  EXPECT_EQ(0x6edb7d80, h[3]);
+  EXPECT_EQ(0x243eeca7, h[4]);
+  EXPECT_EQ(0xddf876ce, h[5]);
+  EXPECT_EQ(0xfbaa8c16, h[6]);
+  EXPECT_EQ(0x84db80c3, h[7]);
+}
+
+TEST(HashTest, MixedBlockRuns) {
+  uintptr_t hash_addr = 160;
+  uintptr_t block_addr = 400;
+
+  ASSERT_LE(400 + 4096, phys_buffer_size);
+  memset(phys_buffer + 400, 'U', 4096);
+
+  phys_ptr<hash_state_t> state{hash_addr};
+  init_hash(state);
+  phys_ptr<uint32_t> blocks{block_addr};
+  extend_hash(state, blocks);
+  blocks += hash_block_size / sizeof(uint32_t);
+  extend_hash_blocks(state, blocks, 0);
+  extend_hash_blocks(state, blocks, 40);
+  blocks += 40 * hash_block_size / sizeof(uint32_t);
+  extend_hash_blocks(state, blocks, 23);
+  finalize_hash(state);
+
+  phys_ptr<uint32_t> h = state->*(&hash_state_t::h);
+  EXPECT_EQ(0x0561079e, h[0]);
+  EXPECT_EQ(0x4fe3390b, h[1]);
+  EXPECT_EQ(0xc1d8bb70, h[2]);
+  EXPECT_EQ(0x6edb7d80, h[3]);
+  EXPECT_EQ(0x243eeca7, h[4]);
+  EXPECT_EQ(0xddf876ce, h[5]);
+  EXPECT_EQ(0xfbaa8c16, h[6]);
+  EXPECT_EQ(0x84db80c3, h[7]);
+}
+
+TEST(HashTest, BitCounterCarry) {
+  uintptr_t hash_addr = 160;
+  uintptr_t block_addr = 400;
+
+  ASSERT_LE(400 + 4096, phys_buffer_size);
+  memset(phys_buffer + 400, 'U', 4096);
+
+  phys_ptr<hash_state_t> state{hash_addr};
+  init_hash(state);
+
+  // The last 8 bytes of the padding block hold the big-endian bit counter.
+  unsigned char* counter = reinterpret_cast<unsigned char*>(phys_buffer +
+      hash_addr + offsetof(hash_state_t, padding) + hash_block_size - 8);
+  counter[4] = 0xff; counter[5] = 0xff; counter[6] = 0xfe; counter[7] = 0x00;
+
+  phys_ptr<uint32_t> blocks{block_addr};
+  extend_hash_blocks(state, blocks, 4096 / hash_block_size);
+
+  EXPECT_EQ(0, counter[0]);
+  EXPECT_EQ(0, counter[1]);
+  EXPECT_EQ(0, counter[2]);
+  EXPECT_EQ(1, counter[3]);
+  EXPECT_EQ(0, counter[4]);
+  EXPECT_EQ(0, counter[5]);
+  EXPECT_EQ(0x7e, counter[6]);
+  EXPECT_EQ(0x00, counter[7]);
+}
+
+TEST(HashTest, ReferenceBlockOfLetters) {
+  uintptr_t hash_addr = 160;
+  uintptr_t block_addr = 400;
+  char block_data[] =
+      "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq01234567";
+
+  ASSERT_LE(400 + hash_block_size, phys_buffer_size);
+  memcpy(phys_buffer + 400, block_data, hash_block_size);
+
+  phys_ptr<hash_state_t> state{hash_addr};
+  init_hash(state);
+  phys_ptr<uint32_t> block{block_addr};
+  extend_hash_reference(state, block);
+  uintptr_t padding_addr = uintptr_t(state->*(&hash_state_t::padding));
+  extend_hash_reference(state, phys_ptr<uint32_t>{padding_addr});
+
+  phys_ptr<uint32_t> h = state->*(&hash_state_t::h);
+  EXPECT_EQ(0x9e411773, h[0]);
+  EXPECT_EQ(0x2130ab9d, h[1]);
+  EXPECT_EQ(0xc766d118, h[2]);
+  EXPECT_EQ(0x4ecb8dcc, h[3]);
+  EXPECT_EQ(0xf82bc6a4, h[4]);
+  EXPECT_EQ(0x2a12378a, h[5]);
+  EXPECT_EQ(0x0fd067b9, h[6]);
+  EXPECT_EQ(0x5d04ebff, h[7]);
+}
+
+namespace {
+
+// Hashes pseudo-random data with the selected kernel and the reference code.
+void check_kernel_against_reference() {
+  uintptr_t hash_addr = 160;
+  uintptr_t reference_addr = 400;
+  uintptr_t block_addr = 1024;
+
+  ASSERT_LE(1024 + 4096, phys_buffer_size);
+  uint32_t seed = 0x12345678;
+  for (size_t i = 0; i < 4096; ++i) {
+    seed = seed * 1103515245 + 12345;
+    phys_buffer[1024 + i] = static_cast<char>(seed >> 24);
+  }
+
+  phys_ptr<hash_state_t> state{hash_addr};
+  phys_ptr<hash_state_t> reference{reference_addr};
+  init_hash(state);
+  init_hash(reference);
+  for (size_t i = 0; i < 4096; i += hash_block_size) {
+    phys_ptr<uint32_t> block{block_addr + i};
+    extend_hash(state, block);
+    extend_hash_reference(reference, block);
+
+    phys_ptr<uint32_t> h = state->*(&hash_state_t::h);
+    phys_ptr<uint32_t> reference_h = reference->*(&hash_state_t::h);
+    for (size_t j = 0; j < 8; ++j)
+      ASSERT_EQ(uint32_t(reference_h[j]), uint32_t(h[j]));
+  }
+}
+
+};  // anonymous namespace
+
+TEST(HashTest, KernelMatchesReference) {
+  check_kernel_against_reference();
+}
+
+TEST(HashTest, PortableKernelMatchesReference) {
+  bool saved_use_sha_extensions = use_sha_extensions;
+  use_sha_extensions = false;
+  check_kernel_against_reference();
+  use_sha_extensions = saved_use_sha_extensions;
+}
+
+TEST(HashTest, PortableKernelPageOfU) {
+  uintptr_t hash_addr = 160;
+  uintptr_t block_addr = 400;
+
+  ASSERT_LE(400 + 4096, phys_buffer_size);
+  memset(phys_buffer + 400, 'U', 4096);
+
+  bool saved_use_sha_extensions = use_sha_extensions;
+  use_sha_extensions = false;
+  phys_ptr<hash_state_t> state{hash_addr};
+  init_hash(state);
+  extend_hash_blocks(state, phys_ptr<uint32_t>{block_addr},
+      4096 / hash_block_size);
+  finalize_hash(state);
+  use_sha_extensions = saved_use_sha_extensions;
+
+  phys_ptr<uint32_t> h = state->*(&hash_state_t::h);
+  EXPECT_EQ(0x0561079e, h[0]);
+  EXPECT_EQ(0x4fe3390b, h[1]);
+  EXPECT_EQ(0xc1d8bb70, h[2]);
+  EXPECT_EQ(0x6edb7d80, h[3]);
+  EXPECT_EQ(0x243eeca7, h[4]);
+  EXPECT_EQ(0xddf876ce, h[5]);
+  EXPECT_EQ(0xfbaa8c16, h[6]);
+  EXPECT_EQ(0x84db80c3, h[7]);
+}
+
+namespace {
+
+// Extends 7 states in lockstep, and compares them against separate hashes.
+void check_multi_against_single() {
+  uintptr_t states_addr = 160;
+  uintptr_t reference_addr = 4096;
+  uintptr_t block_addr = 8192;
+  constexpr size_t count = 7;
+
+  ASSERT_LE(8192 + 4096, phys_buffer_size);
+  ASSERT_LE(160 + count * sizeof(hash_state_t), 4096);
+  ASSERT_LE(4096 + count * sizeof(hash_state_t), 8192);
+  uint32_t seed = 0x9abcdef0;
+  for (size_t i = 0; i < 4096; ++i) {
+    seed = seed * 1103515245 + 12345;
+    phys_buffer[8192 + i] = static_cast<char>(seed >> 24);
+  }
+
+  phys_ptr<hash_state_t> states[count] = {
+    states_addr, states_addr + sizeof(hash_state_t),
+    states_addr + 2 * sizeof(hash_state_t),
+    states_addr + 3 * sizeof(hash_state_t),
+    states_addr + 4 * sizeof(hash_state_t),
+    states_addr + 5 * sizeof(hash_state_t),
+    states_addr + 6 * sizeof(hash_state_t),
+  };
+  for (size_t i = 0; i < count; ++i) {
+    init_hash(states[i]);
+    init_hash(phys_ptr<hash_state_t>{reference_addr +
+        i * sizeof(hash_state_t)});
+  }
+
+  // Each state gets a different block in each step, and the number of states
+  // extended varies from 1 to count.
+  for (size_t step = 0; step < 8; ++step) {
+    const size_t step_count = 1 + step % count;
+    phys_ptr<uint32_t> blocks[count] = {
+      block_addr, block_addr, block_addr, block_addr,
+      block_addr, block_addr, block_addr,
+    };
+    for (size_t i = 0; i < step_count; ++i) {
+      blocks[i] = phys_ptr<uint32_t>{block_addr +
+          ((step * count + i * 3) % 64) * hash_block_size};
+      extend_hash(phys_ptr<hash_state_t>{reference_addr +
+          i * sizeof(hash_state_t)}, blocks[i]);
+    }
+    extend_hash_multi(states, blocks, step_count);
+  }
+
+  for (size_t i = 0; i < count; ++i) {
+    phys_ptr<hash_state_t> reference{reference_addr +
+        i * sizeof(hash_state_t)};
+    finalize_hash(states[i]);
+    finalize_hash(reference);
+
+    phys_ptr<uint32_t> h = states[i]->*(&hash_state_t::h);
+    phys_ptr<uint32_t> reference_h = reference->*(&hash_state_t::h);
+    for (size_t j = 0; j < 8; ++j)
+      ASSERT_EQ(uint32_t(reference_h[j]), uint32_t(h[j]));
+  }
+}
+
+};  // anonymous namespace
+
+TEST(HashTest, MultiMatchesSingle) {
+  check_multi_against_single();
+}
+
+TEST(HashTest, PortableMultiMatchesSingle) {
+  bool saved_use_sha_extensions = use_sha_extensions;
+  use_sha_extensions = false;
+  check_multi_against_single();
+  use_sha_extensions = saved_use_sha_extensions;
+}
+
+TEST(HashTest, InterleavedKernelMatchesSingle) {
+  constexpr size_t lanes = 3;
+  uintptr_t block_addr = 8192;
+
+  ASSERT_LE(8192 + lanes * hash_block_size, phys_buffer_size);
+  uint32_t seed = 0x13579bdf;
+  for (size_t i = 0; i < lanes * hash_block_size; ++i) {
+    seed = seed * 1103515245 + 12345;
+    phys_buffer[8192 + i] = static_cast<char>(seed >> 24);
+  }
+
+  uint32_t hash[lanes][8];
+  uint32_t reference[lanes][8];
+  uintptr_t blocks[lanes];
+  for (size_t lane = 0; lane < lanes; ++lane) {
+    for (size_t i = 0; i < 8; ++i)
+      hash[lane][i] = reference[lane][i] = sha256_initial_hash[i] + lane;
+    blocks[lane] = block_addr + lane * hash_block_size;
+    sha2_compress<sha256_portable_ops>(reference[lane],
+        phys_ptr<uint32_t>{blocks[lane]});
+  }
+  sha2_compress_interleaved<sha256_portable_ops, lanes>(hash, blocks);
+
+  for (size_t lane = 0; lane < lanes; ++lane) {
+    for (size_t i = 0; i < 8; ++i)
+      ASSERT_EQ(reference[lane][i], hash[lane][i]);
+  }
+}
+
+namespace {
+
+// Copies and hashes a page of pseudo-random data, and compares the results
+// against a separate copy and hash.
+template<typename Policy> void check_copy_and_extend() {
+  typedef basic_hash_state_t<Policy> state_t;
+  typedef typename Policy::word_t word_t;
+  uintptr_t hash_addr = 160;
+  uintptr_t reference_addr = 480;
+  uintptr_t source_addr = 1024;
+  uintptr_t dest_addr = 8192;
+
+  ASSERT_LE(8192 + 4096, phys_buffer_size);
+  uint32_t seed = 0x2468ace0;
+  for (size_t i = 0; i < 4096; ++i) {
+    seed = seed * 1103515245 + 12345;
+    phys_buffer[1024 + i] = static_cast<char>(seed >> 24);
+  }
+  memset(phys_buffer + 8192, 0, 4096);
+
+  phys_ptr<state_t> state{hash_addr};
+  phys_ptr<state_t> reference{reference_addr};
+  init_hash(state);
+  init_hash(reference);
+
+  // The page is hashed in two uneven runs, to cover the block counter.
+  copy_and_extend_hash_blocks(state, phys_ptr<word_t>{dest_addr},
+      phys_ptr<word_t>{source_addr}, 1);
+  copy_and_extend_hash_blocks(state,
+      phys_ptr<word_t>{dest_addr + Policy::block_size},
+      phys_ptr<word_t>{source_addr + Policy::block_size},
+      4096 / Policy::block_size - 1);
+  extend_hash_blocks(reference, phys_ptr<word_t>{source_addr},
+      4096 / Policy::block_size);
+  finalize_hash(state);
+  finalize_hash(reference);
+
+  ASSERT_EQ(0, memcmp(phys_buffer + 1024, phys_buffer + 8192, 4096));
+  phys_ptr<word_t> h = state->*(&state_t::h);
+  phys_ptr<word_t> reference_h = reference->*(&state_t::h);
+  for (size_t i = 0; i < 8; ++i)
+    ASSERT_EQ(word_t(reference_h[i]), word_t(h[i]));
+}
+
+};  // anonymous namespace
+
+TEST(HashTest, CopyAndExtendMatchesExtend) {
+  check_copy_and_extend<sha256_policy>();
+}
+
+TEST(HashTest, PortableCopyAndExtendMatchesExtend) {
+  bool saved_use_sha_extensions = use_sha_extensions;
+  use_sha_extensions = false;
+  check_copy_and_extend<sha256_policy>();
+  use_sha_extensions = saved_use_sha_extensions;
+}
+
+TEST(HashTest, Sha512256CopyAndExtendMatchesExtend) {
+  check_copy_and_extend<sha512_256_policy>();
+}
+
+TEST(HashTest, MultiBlockOfA) {
+  uintptr_t hash_addr = 160;
+  uintptr_t block_addr = 400;
+
+  ASSERT_LE(400 + hash_block_size, phys_buffer_size);
+  memset(phys_buffer + 400, 'A', hash_block_size);
+
+  bool saved_use_sha_extensions = use_sha_extensions;
+  use_sha_extensions = false;
+  phys_ptr<hash_state_t> states[1] = { hash_addr };
+  phys_ptr<uint32_t> blocks[1] = { block_addr };
+  init_hash(states[0]);
+  extend_hash_multi(states, blocks, 1);
+  finalize_hash(states[0]);
+  use_sha_extensions = saved_use_sha_extensions;
+
+  phys_ptr<uint32_t> h = states[0]->*(&hash_state_t::h);
+  EXPECT_EQ(0xd53eda7a, h[0]);
+  EXPECT_EQ(0x637c99cc, h[1]);
+  EXPECT_EQ(0x7fb566d9, h[2]);
+  EXPECT_EQ(0x6e9fa109, h[3]);
+  EXPECT_EQ(0xbf15c478, h[4]);
+  EXPECT_EQ(0x410a3f5e, h[5]);
+  EXPECT_EQ(0xb4d4c4e2, h[6]);
+  EXPECT_EQ(0x6cd081f6, h[7]);
+}
+
+TEST(HashTest, Sha512256EmptyString) {
+  uintptr_t hash_addr = 160;
+
+  ASSERT_LE(160 + sizeof(sha512_256_state_t), phys_buffer_size);
+
+  phys_ptr<sha512_256_state_t> state{hash_addr};
+  init_hash(state);
+  finalize_hash(state);
+
+  phys_ptr<uint64_t> h = state->*(&sha512_256_state_t::h);
+  EXPECT_EQ(0xc672b8d1ef56ed28, h[0]);
+  EXPECT_EQ(0xab87c3622c511406, h[1]);
+  EXPECT_EQ(0x9bdd3ad7b8f97374, h[2]);
+  EXPECT_EQ(0x98d0c01ecef0967a, h[3]);
+}
+
+TEST(HashTest, Sha512256BlockOfA) {
+  uintptr_t hash_addr = 160;
+  uintptr_t block_addr = 800;
+
+  ASSERT_LE(800 + sha512_256_block_size, phys_buffer_size);
+  memset(phys_buffer + 800, 'A', sha512_256_block_size);
+
+  phys_ptr<sha512_256_state_t> state{hash_addr};
+  init_hash(state);
+  phys_ptr<uint64_t> block{block_addr};
+  extend_hash(state, block);
+  finalize_hash(state);
+
+  phys_ptr<uint64_t> h = state->*(&sha512_256_state_t::h);
+  EXPECT_EQ(0x6208fcba69ac2955, h[0]);
+  EXPECT_EQ(0xc082108a2e321826, h[1]);
+  EXPECT_EQ(0xa3b748328ede3ffe, h[2]);
+  EXPECT_EQ(0x6fce037562ccb0eb, h[3]);
+}
+
+TEST(HashTest, Sha512256PageOfU) {
+  uintptr_t hash_addr = 160;
+  uintptr_t multi_addr = 480;
+  uintptr_t block_addr = 1024;
+
+  ASSERT_LE(1024 + 4096, phys_buffer_size);
+  memset(phys_buffer + 1024, 'U', 4096);
+
+  phys_ptr<sha512_256_state_t> state{hash_addr};
+  init_hash(state);
+  extend_hash_blocks(state, phys_ptr<uint64_t>{block_addr},
+      4096 / sha512_256_block_size);
+  finalize_hash(state);
+
+  phys_ptr<sha512_256_state_t> multi_states[1] = { multi_addr };
+  init_hash(multi_states[0]);
+  for (size_t i = 0; i < 4096; i += sha512_256_block_size) {
+    phys_ptr<uint64_t> blocks[1] = { block_addr + i };
+    extend_hash_multi(multi_states, blocks, 1);
+  }
+  finalize_hash(multi_states[0]);
+
+  phys_ptr<uint64_t> h = state->*(&sha512_256_state_t::h);
+  EXPECT_EQ(0xd7cfad24e7a0af2e, h[0]);
+  EXPECT_EQ(0xaca1316b8bb22314, h[1]);
+  EXPECT_EQ(0x6746aaafbabd4641, h[2]);
+  EXPECT_EQ(0x8c8893e164fa9e10, h[3]);
+
+  phys_ptr<uint64_t> multi_h = multi_states[0]->*(&sha512_256_state_t::h);
+  for (size_t i = 0; i < 4; ++i)
+    EXPECT_EQ(uint64_t(h[i]), uint64_t(multi_h[i]));
+}
+
+TEST(HashTest, Sha512256BitCounterCarry) {
+  uintptr_t hash_addr = 160;
+  uintptr_t block_addr = 1024;
+
+  ASSERT_LE(1024 + 4096, phys_buffer_size);
+  memset(phys_buffer + 1024, 'U', 4096);
+
+  phys_ptr<sha512_256_state_t> state{hash_addr};
+  init_hash(state);
+
+  // The last 16 bytes of the padding block hold the big-endian bit counter.
+  unsigned char* counter = reinterpret_cast<unsigned char*>(phys_buffer +
+      hash_addr + offsetof(sha512_256_state_t, padding) +
+      sha512_256_block_size - 16);
+  for (size_t i = 8; i < 14; ++i)
+    counter[i] = 0xff;
+  counter[14] = 0xfe; counter[15] = 0x00;
+
+  phys_ptr<uint64_t> blocks{block_addr};
+  extend_hash_blocks(state, blocks, 4096 / sha512_256_block_size);
+
+  for (size_t i = 0; i < 7; ++i)
+    EXPECT_EQ(0, counter[i]);
+  EXPECT_EQ(1, counter[7]);
+  for (size_t i = 8; i < 14; ++i)
+    EXPECT_EQ(0, counter[i]);
+  EXPECT_EQ(0x7e, counter[14]);
+  EXPECT_EQ(0x00, counter[15]);
+}
@@ -12,6 +12,13 @@
         'monitor/monitor.gyp:monitor_tests',
       ],
     },
+    {
+      'target_name': 'tools',
+      'type': 'none',
+      'dependencies': [
+        'monitor/monitor.gyp:measure_tool',
+      ],
+    },
     {
       'target_name': 'libs',
       'type': 'none',
@@ -6,7 +6,9 @@
 #include "dram_regions.h"
 #include "dram_regions_inl.h"
 #include "enclave.h"
+#include "event_queue.h"
 #include "metadata_inl.h"
+#include "page_cache.h"
 
 using sanctum::api::null_enclave_id;
 using sanctum::api::os::dram_region_owned;
@@ -14,6 +16,7 @@ using sanctum::bare::atomic_flag_clear;
 using sanctum::bare::atomic_init;
 using sanctum::bare::address_bits_for;
 using sanctum::bare::ceil_power_of_two;
+using sanctum::bare::ceil_to_multiple;
 using sanctum::bare::is_shared_cache;
 using sanctum::bare::page_shift;
 using sanctum::bare::page_size;
@@ -66,6 +69,7 @@ void boot_init_dram_regions() {
   size_t line_bits = address_bits_for(line_size);
   if (line_size != (1 << line_bits))
     boot_panic();  // Sanctum assumes power-of-two cache line sizes.
+  g_cache_line_size = line_size;
 
   size_t set_count = read_cache_set_count(llc);
   size_t set_bits = address_bits_for(set_count);
@@ -133,26 +137,86 @@ void boot_init_metadata() {
   g_metadata_region_start = pages_needed_for(metadata_map_size);
 }
 
+namespace {
+
+// Allocates an array whose entries start at cache line boundaries.
+//
+// `entry_size` is rounded up to a multiple of the LLC line size, so entries
+// used by different cores never share a cache line. Returns the array's
+// start, and sets `stride` to the distance between entries.
+uintptr_t boot_alloc_cache_line_array(size_t entry_size, size_t count,
+    size_t& stride) {
+  stride = ceil_to_multiple(entry_size, g_cache_line_size);
+  const uintptr_t array_start =
+      ceil_to_multiple(g_monitor_top, g_cache_line_size);
+  g_monitor_top = array_start + stride * count;
+  return array_start;
+}
+
+}  // anonymous namespace
+
 void boot_init_dynamic_arrays() {
   g_core_count = read_core_count();
-  g_core = phys_ptr<core_info_t>{g_monitor_top};
-  g_monitor_top = static_cast<uintptr_t>(g_core + g_core_count);
+  g_core = phys_ptr<core_info_t>{boot_alloc_cache_line_array(
+      sizeof(core_info_t), g_core_count, g_core_stride)};
+  g_core_flush = phys_ptr<core_flush_info_t>{boot_alloc_cache_line_array(
+      sizeof(core_flush_info_t), g_core_count, g_core_flush_stride)};
+  for (size_t i = 0; i < g_core_count; ++i) {
+    phys_ptr<core_flush_info_t> flush_info = core_flush_info_for(i);
+    atomic_init(&(flush_info->*(&core_flush_info_t::flushed_at)),
+        static_cast<size_t>(0));
+  }
 
-  g_dram_region = phys_ptr<dram_region_info_t>{g_monitor_top};
-  g_monitor_top = static_cast<uintptr_t>(g_dram_region + g_dram_region_count);
+  g_dram_region = phys_ptr<dram_region_info_t>{boot_alloc_cache_line_array(
+      sizeof(dram_region_info_t), g_dram_region_count,
+      g_dram_region_stride)};
   for (size_t i = 0; i < g_dram_region_count; ++i) {
-    phys_ptr<dram_region_info_t> region{g_dram_region + i};
+    phys_ptr<dram_region_info_t> region = dram_region_info_for(i);
     atomic_flag_clear(&(region->*(&dram_region_info_t::lock)));
-    region->*(&dram_region_info_t::owner) = null_enclave_id;
+    atomic_init(&(region->*(&dram_region_info_t::owner)), null_enclave_id);
     region->*(&dram_region_info_t::previous_owner) = null_enclave_id;
     region->*(&dram_region_info_t::pinned_pages) = 0;
     region->*(&dram_region_info_t::blocked_at) = 0;
+    region->*(&dram_region_info_t::scrubbed_pages) = 0;
+    region->*(&dram_region_info_t::clone_region) = 0;
   }
 
-  g_dram_regions = phys_ptr<dram_regions_info_t>{g_monitor_top};
-  g_monitor_top = static_cast<uintptr_t>(g_dram_regions + 1);
+  size_t block_log_stride;
+  g_dram_region_block_log = phys_ptr<atomic<size_t>>{
+      boot_alloc_cache_line_array(sizeof(atomic<size_t>) * g_dram_region_count,
+          1, block_log_stride)};
+  for (size_t i = 0; i < g_dram_region_count; ++i)
+    atomic_init(&(g_dram_region_block_log[i]), static_cast<size_t>(0));
+
+  // NOTE: block_clock is incremented whenever a region is blocked, and read on
+  //       every TLB flush, so it gets a cache line of its own
+  size_t dram_regions_stride;
+  g_dram_regions = phys_ptr<dram_regions_info_t>{boot_alloc_cache_line_array(
+      sizeof(dram_regions_info_t), 1, dram_regions_stride)};
   atomic_init(&(g_dram_regions->*(&dram_regions_info_t::block_clock)),
       static_cast<size_t>(0));
+  atomic_init(&(g_dram_regions->*(&dram_regions_info_t::flushed_watermark)),
+      static_cast<size_t>(0));
+  atomic_init(&(g_dram_regions->*(&dram_regions_info_t::shootdown_clock)),
+      static_cast<size_t>(0));
+
+  size_t event_queue_info_stride;
+  g_event_queue_info = phys_ptr<event_queue_info_t>{
+      boot_alloc_cache_line_array(sizeof(event_queue_info_t), 1,
+          event_queue_info_stride)};
+  atomic_init(&(g_event_queue_info->*(&event_queue_info_t::tail)),
+      static_cast<size_t>(0));
+  atomic_init(&(g_event_queue_info->*(&event_queue_info_t::dropped)),
+      static_cast<size_t>(0));
+  atomic_init(&(g_event_queue_info->*(&event_queue_info_t::queue)),
+      static_cast<uintptr_t>(0));
+  g_event_queue_info->*(&event_queue_info_t::capacity) = 0;
+
+  size_t page_digest_cache_stride;
+  g_page_digest_cache = phys_ptr<atomic<uintptr_t>>{
+      boot_alloc_cache_line_array(sizeof(atomic<uintptr_t>), 1,
+          page_digest_cache_stride)};
+  atomic_init(g_page_digest_cache, static_cast<uintptr_t>(0));
 
   g_os_region_bitmap = phys_ptr<size_t>{g_monitor_top};
   g_monitor_top = static_cast<uintptr_t>(
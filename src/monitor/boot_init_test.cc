@@ -4,13 +4,16 @@
 #include "bare/cpu_context.h"
 #include "bare/memory.h"
 #include "bare/page_tables.h"
-#include "cpu_core.h"
-#include "dram_regions.h"
+#include "cpu_core_inl.h"
+#include "dram_regions_inl.h"
 #include "enclave.h"
+#include "event_queue.h"
 #include "metadata.h"
+#include "page_cache.h"
 
 #include "gtest/gtest.h"
 
+using sanctum::bare::ceil_to_multiple;
 using sanctum::bare::current_core;
 using sanctum::bare::is_power_of_two;
 using sanctum::bare::page_size;
@@ -20,16 +23,25 @@ using sanctum::internal::boot_init_dram_regions;
 using sanctum::internal::boot_init_dynamic_arrays;
 using sanctum::internal::boot_init_metadata;
 using sanctum::internal::boot_init_protection;
+using sanctum::internal::core_flush_info_for;
+using sanctum::internal::core_info_for;
 using sanctum::internal::core_info_t;
+using sanctum::internal::dram_region_info_for;
 using sanctum::internal::dram_region_info_t;
+using sanctum::internal::g_cache_line_size;
 using sanctum::internal::g_core;
+using sanctum::internal::g_core_flush;
+using sanctum::internal::g_core_flush_stride;
+using sanctum::internal::g_core_stride;
 using sanctum::internal::g_core_count;
 using sanctum::internal::g_dma_range_end;
 using sanctum::internal::g_dma_range_start;
 using sanctum::internal::g_dram_region;
+using sanctum::internal::g_dram_region_block_log;
 using sanctum::internal::g_dram_regions;
 using sanctum::internal::g_dram_region_bitmap_words;
 using sanctum::internal::g_dram_region_count;
+using sanctum::internal::g_dram_region_stride;
 using sanctum::internal::g_dram_region_mask;
 using sanctum::internal::g_dram_region_shift;
 using sanctum::internal::g_dram_size;
@@ -38,10 +50,12 @@ using sanctum::internal::g_dram_stripe_pages;
 using sanctum::internal::g_dram_stripe_page_mask;
 using sanctum::internal::g_dram_stripe_shift;
 using sanctum::internal::g_dram_stripe_size;
+using sanctum::internal::g_event_queue_info;
 using sanctum::internal::g_metadata_region_pages;
 using sanctum::internal::g_metadata_region_start;
 using sanctum::internal::g_monitor_top;
 using sanctum::internal::g_os_region_bitmap;
+using sanctum::internal::g_page_digest_cache;
 
 namespace {
 
@@ -263,18 +277,56 @@ TEST(BootInitTest, DynamicArrays) {
   g_monitor_top = 0x800;
   boot_init_dynamic_arrays();
 
+  ASSERT_EQ(g_cache_line_size, 64);
   ASSERT_EQ(g_core_count, 4);
+  ASSERT_EQ(g_core_stride, ceil_to_multiple(sizeof(core_info_t), 64));
+  ASSERT_EQ(g_core_flush_stride, 64);
+  ASSERT_EQ(g_dram_region_stride, 64);
+
   ASSERT_EQ(static_cast<uintptr_t>(g_core), static_cast<uintptr_t>(0x800));
-  ASSERT_EQ(static_cast<uintptr_t>(g_core + 4),
+  ASSERT_EQ(static_cast<uintptr_t>(g_core) + 4 * g_core_stride,
+            static_cast<uintptr_t>(g_core_flush));
+  ASSERT_EQ(static_cast<uintptr_t>(g_core_flush) + 4 * 64,
             static_cast<uintptr_t>(g_dram_region));
   ASSERT_EQ(g_dram_region_count, 8);
-  ASSERT_EQ(static_cast<uintptr_t>(g_dram_region + 8),
+  ASSERT_EQ(static_cast<uintptr_t>(g_dram_region) + 8 * 64,
+            static_cast<uintptr_t>(g_dram_region_block_log));
+  ASSERT_EQ(static_cast<uintptr_t>(g_dram_region_block_log) + 64,
             static_cast<uintptr_t>(g_dram_regions));
-  ASSERT_EQ(static_cast<uintptr_t>(g_dram_regions + 1),
+  ASSERT_EQ(static_cast<uintptr_t>(g_dram_regions) + 64,
+            static_cast<uintptr_t>(g_event_queue_info));
+  ASSERT_EQ(static_cast<uintptr_t>(g_event_queue_info) + 64,
+            static_cast<uintptr_t>(g_page_digest_cache));
+  ASSERT_EQ(static_cast<uintptr_t>(g_page_digest_cache) + 64,
             static_cast<uintptr_t>(g_os_region_bitmap));
   ASSERT_EQ(static_cast<uintptr_t>(g_os_region_bitmap + 1), g_monitor_top);
 }
 
+TEST(BootInitTest, DynamicArraysUseCacheLines) {
+  set_up_paper_memory_model();
+  sanctum::testing::cache_line_size[2] = 1 << 7;
+
+  boot_init_dram_regions();
+  boot_init_metadata();
+
+  // The arrays are aligned even if the monitor's top isn't.
+  g_monitor_top = 0x808;
+  boot_init_dynamic_arrays();
+
+  ASSERT_EQ(g_cache_line_size, 128);
+  ASSERT_EQ(static_cast<uintptr_t>(g_core), static_cast<uintptr_t>(0x880));
+  ASSERT_EQ(g_core_stride % 128, 0);
+  ASSERT_EQ(g_core_flush_stride, 128);
+  ASSERT_EQ(g_dram_region_stride, 128);
+  for (size_t i = 0; i < g_core_count; ++i) {
+    ASSERT_EQ(uintptr_t(core_flush_info_for(i)) % 128, 0);
+    ASSERT_EQ(uintptr_t(core_info_for(i)) % 128, 0);
+  }
+  for (size_t i = 0; i < g_dram_region_count; ++i)
+    ASSERT_EQ(uintptr_t(dram_region_info_for(i)) % 128, 0);
+  ASSERT_EQ(static_cast<uintptr_t>(g_dram_regions) % 128, 0);
+}
+
 TEST(BootInitTest, Protection) {
   set_up_paper_memory_model();
 
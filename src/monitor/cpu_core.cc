@@ -9,8 +9,11 @@ namespace sanctum {
 namespace internal {
 
 phys_ptr<core_info_t> g_core{0};
+phys_ptr<core_flush_info_t> g_core_flush{0};
 
 size_t g_core_count;
+size_t g_core_stride;
+size_t g_core_flush_stride;
 
 };  // namespace sanctum::internal
 };  // namespace sanctum
@@ -4,6 +4,7 @@
 #include "bare/base_types.h"
 #include "bare/cpu_context.h"
 #include "bare/phys_atomics.h"
+#include "crypto/hash.h"
 #include "public/api.h"
 
 namespace sanctum {
@@ -16,14 +17,18 @@ using sanctum::bare::current_core;
 using sanctum::bare::phys_ptr;
 using sanctum::bare::size_t;
 using sanctum::bare::uintptr_t;
+using sanctum::crypto::hash_block_size;
+using sanctum::crypto::hash_result_size;
+using sanctum::crypto::hash_state_t;
+using sanctum::crypto::hash_word_t;
 
 struct thread_info_t;
 
 // Per-core accounting information.
 //
-// Most information is only modified on the core that it corresponds to, so we
-// don't need atomics or locking. The notable exception is the flushed_at
-// timestamp.
+// This information is only accessed on the core that it corresponds to, so we
+// don't need atomics or locking. State that other cores read is in
+// core_flush_info_t.
 struct core_info_t {
   enclave_id_t enclave_id;  // 0 if the core isn't executing enclave code
   thread_id_t thread_id;
@@ -32,8 +37,23 @@ struct core_info_t {
   // while the thread is executing on a core.
   phys_ptr<thread_info_t> thread;
 
+  // Scratch space for hashing page tree leaves and nodes.
+  //
+  // Tree-format measurements hash each page separately, so the hashing can
+  // happen on any core. These are only used while the core is executing a
+  // monitor call.
+  hash_state_t scratch_hash;
+  hash_word_t scratch_blocks[2 * hash_block_size / sizeof(hash_word_t)];
+  hash_word_t scratch_digest[hash_result_size / sizeof(hash_word_t)];
+};
+
+// Per-core TLB flushing information.
+//
+// This is written by its core and read on other cores, so it is kept out of
+// core_info_t. Otherwise, every remote read would take away the cache line
+// holding the core's private state.
+struct core_flush_info_t {
   // The value of block_clock when this core's TLB was last flushed.
-  // This is read on other cores,
   atomic<size_t> flushed_at;
 };
 
@@ -41,11 +61,21 @@ struct core_info_t {
 //
 // These values are computed during the boot process. Once computed, the values
 // never change.
+//
+// The per-core arrays are laid out on LLC line boundaries, and their entries
+// are padded to whole cache lines, so cores never write to the same line. Use
+// core_info_for() and core_flush_info_for() to index them.
 
 extern phys_ptr<core_info_t> g_core;
+extern phys_ptr<core_flush_info_t> g_core_flush;
 
 extern size_t g_core_count;
 
+// The distance in bytes between consecutive entries in g_core.
+extern size_t g_core_stride;
+// The distance in bytes between consecutive entries in g_core_flush.
+extern size_t g_core_flush_stride;
+
 };  // namespace sanctum::internal
 };  // namespace sanctum
 #endif  // !defined(MONITOR_CPU_CORE_H_INCLUDED)
@@ -10,9 +10,24 @@ using sanctum::api::enclave_id_t;
 using sanctum::bare::current_core;
 using sanctum::bare::phys_ptr;
 
+// The physical address of the core_info_t for a core.
+//
+// Invalid core indices will yield invalid pointers.
+inline phys_ptr<core_info_t> core_info_for(size_t core) {
+  return phys_ptr<core_info_t>{uintptr_t(g_core) + core * g_core_stride};
+}
+
+// The physical address of the core_flush_info_t for a core.
+//
+// Invalid core indices will yield invalid pointers.
+inline phys_ptr<core_flush_info_t> core_flush_info_for(size_t core) {
+  return phys_ptr<core_flush_info_t>{
+      uintptr_t(g_core_flush) + core * g_core_flush_stride};
+}
+
 // The physical address of the core_info_t for the current core.
 inline phys_ptr<core_info_t> current_core_info() {
-  return &g_core[current_core()];
+  return core_info_for(current_core());
 }
 
 // The enclave running on the current core.
@@ -7,26 +7,31 @@
 
 using sanctum::api::null_enclave_id;
 using sanctum::bare::atomic_flag_test_and_set;
+using sanctum::bare::current_core;
 using sanctum::bare::is_valid_range;
 using sanctum::bare::phys_ptr;
+using sanctum::bare::send_monitor_ipi;
 using sanctum::bare::set_dmar_base;
 using sanctum::bare::set_dmar_mask;
 using sanctum::bare::set_drb_map;
 using sanctum::bare::set_edrb_map;
 using sanctum::bare::size_t;
 using sanctum::bare::uintptr_t;
+using sanctum::internal::atomic_store_max;
 using sanctum::internal::blocked_enclave_id;
+using sanctum::internal::clean_enclave_id;
 using sanctum::internal::clear_dram_region_lock;
 using sanctum::internal::current_enclave;
 using sanctum::internal::dram_region_for;
+using sanctum::internal::dram_region_info_for;
 using sanctum::internal::dram_region_info_t;
+using sanctum::internal::dram_region_scrub_max_pages;
 using sanctum::internal::dram_region_start;
 using sanctum::internal::dram_region_tlb_flush;
 using sanctum::internal::dram_regions_info_t;
 using sanctum::internal::enclave_region_bitmap;
 using sanctum::internal::free_enclave_id;
 using sanctum::internal::g_core_count;
-using sanctum::internal::g_core;
 using sanctum::internal::g_dma_range_end;
 using sanctum::internal::g_dma_range_start;
 using sanctum::internal::g_dram_regions;
@@ -38,23 +43,32 @@ using sanctum::internal::g_dram_size;
 using sanctum::internal::g_dram_stripe_size;
 using sanctum::internal::g_os_region_bitmap;
 using sanctum::internal::init_metadata_region;
+using sanctum::internal::is_core_tlb_flush_pending;
 using sanctum::internal::is_dram_address;
+using sanctum::internal::is_dram_region_tlb_flushed;
 using sanctum::internal::is_dynamic_dram_region;
+using sanctum::internal::is_free_dram_region_owner;
 using sanctum::internal::is_valid_dram_region;
 using sanctum::internal::is_valid_enclave_id;
+using sanctum::internal::log_blocked_dram_region;
 using sanctum::internal::metadata_enclave_id;
 using sanctum::internal::read_dram_region_owner;
+using sanctum::internal::scrub_locked_dram_region;
+using sanctum::internal::scrubbing_enclave_id;
 using sanctum::internal::set_enclave_region_bitmap_bit;
 using sanctum::internal::test_and_set_dram_region_lock;
-using sanctum::internal::core_info_t;
+using sanctum::internal::write_dram_region_owner;
 
 namespace sanctum {
 namespace internal {  // sanctum::internal
 
 phys_ptr<dram_region_info_t> g_dram_region{0};
+phys_ptr<atomic<size_t>> g_dram_region_block_log{0};
 phys_ptr<dram_regions_info_t> g_dram_regions{0};
+size_t g_dram_region_stride;
 
 size_t g_dram_size;
+size_t g_cache_line_size;
 size_t g_dram_region_shift;
 size_t g_dram_stripe_shift;
 size_t g_dram_stripe_page_mask;
@@ -91,9 +105,10 @@ api_result_t block_dram_region(size_t dram_region) {
     return monitor_access_denied;
   }
 
-  phys_ptr<dram_region_info_t> region = &g_dram_region[dram_region];
-  if (owner != null_enclave_id &&
-      region->*(&dram_region_info_t::pinned_pages) != 0) {
+  // NOTE: OS-owned regions only have pinned pages if they hold the monitor
+  //       event queue, which must never be given to an enclave
+  phys_ptr<dram_region_info_t> region = dram_region_info_for(dram_region);
+  if (region->*(&dram_region_info_t::pinned_pages) != 0) {
     clear_dram_region_lock(dram_region);
     return monitor_invalid_state;
   }
@@ -131,12 +146,13 @@ api_result_t block_dram_region(size_t dram_region) {
   }
 
   region->*(&dram_region_info_t::previous_owner) = owner;
-  region->*(&dram_region_info_t::owner) = blocked_enclave_id;
   size_t block_clock = atomic_fetch_add(
       &(g_dram_regions->*(&dram_regions_info_t::block_clock)),
       static_cast<size_t>(1));
   region->*(&dram_region_info_t::blocked_at) = block_clock;
   // TODO: panic if block_clock is max_size_t
+  write_dram_region_owner(dram_region, blocked_enclave_id);
+  log_blocked_dram_region(dram_region, block_clock);
 
   set_enclave_region_bitmap_bit(owner, dram_region, false);
   if (owner == 0)
@@ -159,22 +175,13 @@ namespace enclave { // sanctum::api::enclave
 api_result_t dram_region_check_ownership(size_t dram_region) {
   if (!is_dynamic_dram_region(dram_region))
     return monitor_invalid_value;
-  if (test_and_set_dram_region_lock(dram_region))
-    return monitor_concurrent_call;
-
-  api_result_t result;
-  phys_ptr<dram_region_info_t> region = &g_dram_region[dram_region];
 
   // NOTE: we don't need to read the state, because owner has special values
-  //       for non-owned states
-  if (read_dram_region_owner(dram_region) == current_enclave()) {
-    result = monitor_ok;
-  } else {
-    result = monitor_invalid_state;
-  }
-
-  clear_dram_region_lock(dram_region);
-  return result;
+  //       for non-owned states; we don't need the region's lock, because the
+  //       owner is read atomically
+  if (read_dram_region_owner(dram_region) == current_enclave())
+    return monitor_ok;
+  return monitor_invalid_state;
 }
 
 };  // namespace sanctum::api::enclave
@@ -189,9 +196,8 @@ dram_region_state_t dram_region_state(size_t dram_region) {
   if (!is_valid_dram_region(dram_region))
     return dram_region_invalid;
 
-  if (test_and_set_dram_region_lock(dram_region))
-    return dram_region_locked;
-
+  // NOTE: the owner encodes the region's state, and is read atomically, so
+  //       this doesn't need the region's lock
   dram_region_state_t state;
   switch (read_dram_region_owner(dram_region)) {
   case null_enclave_id:
@@ -201,13 +207,15 @@ dram_region_state_t dram_region_state(size_t dram_region) {
     state = dram_region_blocked;
     break;
   case free_enclave_id:
+  case clean_enclave_id:
     state = dram_region_free;
     break;
+  case scrubbing_enclave_id:
+    state = dram_region_scrubbing;
+    break;
   default:
     state = dram_region_owned;
   }
-
-  clear_dram_region_lock(dram_region);
   return state;
 }
 
@@ -215,14 +223,11 @@ enclave_id_t dram_region_owner(size_t dram_region) {
   if (!is_valid_dram_region(dram_region))
     return null_enclave_id;
 
-  if (test_and_set_dram_region_lock(dram_region))
-    return null_enclave_id;
-
   enclave_id_t owner = read_dram_region_owner(dram_region);
-  if (owner == blocked_enclave_id || owner == free_enclave_id)
+  if (owner == blocked_enclave_id || is_free_dram_region_owner(owner) ||
+      owner == scrubbing_enclave_id) {
     owner = null_enclave_id;
-
-  clear_dram_region_lock(dram_region);
+  }
   return owner;
 }
 
@@ -251,8 +256,7 @@ api_result_t set_dma_range(uintptr_t base, uintptr_t mask) {
         return monitor_concurrent_call;
       }
     }
-    phys_ptr<dram_region_info_t> region = &g_dram_region[dram_region];
-    if (region->*(&dram_region_info_t::owner) != 0)
+    if (read_dram_region_owner(dram_region) != 0)
       os_owns_regions = false;
 
     // NOTE: We're clearing each DRAM region lock after acquiring it, instead
@@ -282,7 +286,7 @@ api_result_t create_metadata_region(size_t dram_region) {
   if (test_and_set_dram_region_lock(dram_region))
     return monitor_concurrent_call;
 
-  if (read_dram_region_owner(dram_region) != free_enclave_id) {
+  if (!is_free_dram_region_owner(read_dram_region_owner(dram_region))) {
     clear_dram_region_lock(dram_region);
     return monitor_invalid_state;
   }
@@ -301,7 +305,7 @@ api_result_t assign_dram_region(size_t dram_region, enclave_id_t new_owner) {
   if (test_and_set_dram_region_lock(dram_region))
     return monitor_concurrent_call;
 
-  if (read_dram_region_owner(dram_region) != free_enclave_id) {
+  if (!is_free_dram_region_owner(read_dram_region_owner(dram_region))) {
     clear_dram_region_lock(dram_region);
     return monitor_invalid_state;
   }
@@ -318,8 +322,7 @@ api_result_t assign_dram_region(size_t dram_region, enclave_id_t new_owner) {
 
   api_result_t result;
   if (is_valid_enclave_id(new_owner)) {
-    phys_ptr<dram_region_info_t> region = &g_dram_region[dram_region];
-    region->*(&dram_region_info_t::owner) = new_owner;
+    write_dram_region_owner(dram_region, new_owner);
     set_enclave_region_bitmap_bit(new_owner, dram_region, true);
     // NOTE: This is an OS call, so we know for sure that no enclave DRAM
     //       region bitmap is in effect. We only need to apply changes to the
@@ -346,25 +349,22 @@ api_result_t free_dram_region(size_t dram_region) {
 
   api_result_t result;
   enclave_id_t region_owner = read_dram_region_owner(dram_region);
-  phys_ptr<dram_region_info_t> region = &g_dram_region[dram_region];
+  phys_ptr<dram_region_info_t> region = dram_region_info_for(dram_region);
   if (region_owner == blocked_enclave_id) {
-    size_t blocked_at = region->*(&dram_region_info_t::blocked_at);
-
-    bool can_free = true;
     // Mappings for OS-owned regions must be TLB-flushed from all cores.
     //
     // Mappings for enclave-owned regions must be TLB-flushed from cores that
     // execute enclave code. However, every enclave exit causes a TLB flush and
     // updates the core's clock.
-    for (size_t i = 0; i < g_core_count; ++i) {
-      phys_ptr<core_info_t> core = &g_core[i];
-      if (atomic_load(&(core->*(&core_info_t::flushed_at))) < blocked_at) {
-        can_free = false;
-        break;
-      }
-    }
-    if (can_free) {
-      region->*(&dram_region_info_t::owner) = free_enclave_id;
+    //
+    // NOTE: a core that flushed at block_clock == blocked_at flushed before
+    //       the region was blocked, so the watermark must be strictly greater
+    if (is_dram_region_tlb_flushed(
+        region->*(&dram_region_info_t::blocked_at))) {
+      // NOTE: the region still holds its previous owner's data; scrub_step()
+      //       zeroes it in the background
+      region->*(&dram_region_info_t::scrubbed_pages) = 0;
+      write_dram_region_owner(dram_region, free_enclave_id);
       result = monitor_ok;
     } else {
       result = monitor_invalid_state;
@@ -377,7 +377,8 @@ api_result_t free_dram_region(size_t dram_region) {
     // worry about TLB flushing. However, we do need to make sure they don't
     // have any in-use entries.
     if (region->*(&dram_region_info_t::pinned_pages) == 0) {
-      region->*(&dram_region_info_t::owner) = free_enclave_id;
+      region->*(&dram_region_info_t::scrubbed_pages) = 0;
+      write_dram_region_owner(dram_region, free_enclave_id);
       result = monitor_ok;
     } else {
       result = monitor_invalid_state;
@@ -390,11 +391,143 @@ api_result_t free_dram_region(size_t dram_region) {
   return result;
 }
 
+size_t free_blocked_dram_regions() {
+  size_t freed_regions = 0;
+  for (size_t i = 0; i < g_dram_region_count; ++i) {
+    // NOTE: like scrub_step(), this skips regions that don't need work or
+    //       whose locks are held, instead of returning monitor_concurrent_call
+    if (read_dram_region_owner(i) != blocked_enclave_id)
+      continue;
+    if (test_and_set_dram_region_lock(i))
+      continue;
+
+    phys_ptr<dram_region_info_t> region = dram_region_info_for(i);
+    if (read_dram_region_owner(i) == blocked_enclave_id &&
+        is_dram_region_tlb_flushed(
+            region->*(&dram_region_info_t::blocked_at))) {
+      region->*(&dram_region_info_t::scrubbed_pages) = 0;
+      write_dram_region_owner(i, free_enclave_id);
+      ++freed_regions;
+    }
+    clear_dram_region_lock(i);
+  }
+  return freed_regions;
+}
+
+api_result_t scrub_dram_region(size_t dram_region, size_t page_budget) {
+  if (!is_valid_dram_region(dram_region) || page_budget == 0)
+    return monitor_invalid_value;
+  if (test_and_set_dram_region_lock(dram_region))
+    return monitor_concurrent_call;
+
+  if (read_dram_region_owner(dram_region) != scrubbing_enclave_id) {
+    clear_dram_region_lock(dram_region);
+    return monitor_invalid_state;
+  }
+
+  if (page_budget > dram_region_scrub_max_pages)
+    page_budget = dram_region_scrub_max_pages;
+  scrub_locked_dram_region(dram_region, page_budget);
+
+  clear_dram_region_lock(dram_region);
+  return monitor_ok;
+}
+
+size_t scrub_step(size_t page_budget) {
+  if (page_budget > dram_region_scrub_max_pages)
+    page_budget = dram_region_scrub_max_pages;
+
+  // Regions released by delete_enclave() can't be used until they are zeroed,
+  // so they are scrubbed before the free regions that still hold data.
+  size_t scrubbed_pages = 0;
+  const enclave_id_t owners[] = { scrubbing_enclave_id, free_enclave_id };
+  for (enclave_id_t owner : owners) {
+    for (size_t i = 0; i < g_dram_region_count; ++i) {
+      if (scrubbed_pages == page_budget)
+        return scrubbed_pages;
+      // NOTE: the owner is checked without the lock first, so idle cores
+      //       don't contend for the locks of regions that need no work; busy
+      //       regions are skipped instead of waited for
+      if (read_dram_region_owner(i) != owner)
+        continue;
+      if (test_and_set_dram_region_lock(i))
+        continue;
+      scrubbed_pages += scrub_locked_dram_region(i,
+          page_budget - scrubbed_pages);
+      clear_dram_region_lock(i);
+    }
+  }
+  return scrubbed_pages;
+}
+
+size_t find_free_dram_region() {
+  size_t dirty_dram_region = g_dram_region_count;
+  for (size_t i = 0; i < g_dram_region_count; ++i) {
+    const enclave_id_t owner = read_dram_region_owner(i);
+    if (owner == clean_enclave_id)
+      return i;
+    if (owner == free_enclave_id && dirty_dram_region == g_dram_region_count)
+      dirty_dram_region = i;
+  }
+  return dirty_dram_region;
+}
+
+bool dram_region_is_clean(size_t dram_region) {
+  if (!is_valid_dram_region(dram_region))
+    return false;
+  return read_dram_region_owner(dram_region) == clean_enclave_id;
+}
+
 api_result_t flush_cached_dram_regions() {
   dram_region_tlb_flush();
   return monitor_ok;
 }
 
+api_result_t request_tlb_shootdown(size_t dram_region) {
+  if (!is_valid_dram_region(dram_region))
+    return monitor_invalid_value;
+  if (test_and_set_dram_region_lock(dram_region))
+    return monitor_concurrent_call;
+
+  if (read_dram_region_owner(dram_region) != blocked_enclave_id) {
+    clear_dram_region_lock(dram_region);
+    return monitor_invalid_state;
+  }
+  phys_ptr<dram_region_info_t> region = dram_region_info_for(dram_region);
+  const size_t blocked_at = region->*(&dram_region_info_t::blocked_at);
+  clear_dram_region_lock(dram_region);
+
+  // NOTE: the request is recorded before the IPIs are sent, so the cores see
+  //       it when they handle the IPIs
+  atomic_store_max(
+      &(g_dram_regions->*(&dram_regions_info_t::shootdown_clock)),
+      blocked_at + 1);
+
+  const size_t this_core = current_core();
+  for (size_t i = 0; i < g_core_count; ++i) {
+    if (!is_core_tlb_flush_pending(i, blocked_at))
+      continue;
+    if (i == this_core)
+      dram_region_tlb_flush();
+    else
+      send_monitor_ipi(i);
+  }
+  return monitor_ok;
+}
+
+bool dram_region_tlb_flush_pending(size_t dram_region, size_t core_id) {
+  if (!is_valid_dram_region(dram_region) || core_id >= g_core_count)
+    return false;
+
+  // NOTE: blocked_at is written before the owner, so it is valid once the
+  //       owner reads as blocked
+  if (read_dram_region_owner(dram_region) != blocked_enclave_id)
+    return false;
+  phys_ptr<dram_region_info_t> region = dram_region_info_for(dram_region);
+  return is_core_tlb_flush_pending(core_id,
+      region->*(&dram_region_info_t::blocked_at));
+}
+
 };  // namespace sanctum::api::os
 };  // namespace sanctum::api
 };  // namespace sanctum
@@ -38,12 +38,23 @@ using sanctum::bare::size_t;
 using sanctum::bare::uintptr_t;
 
 // Per-DRAM region accounting information.
+//
+// The owner field also encodes the region's state, using the special enclave
+// IDs below. It is a single atomic word, so the owner and state can be read
+// without acquiring the region's lock. Writing it still requires the lock.
 struct dram_region_info_t {
   atomic_flag lock;             // lock for all the DRAM region's state
-  enclave_id_t owner;           // nullptr if not owned by enclave
+  atomic<enclave_id_t> owner;   // nullptr if not owned by enclave
   enclave_id_t previous_owner;  // nullptr if previously owned by OS
   size_t pinned_pages;          // pages that can't be removed from DRAM
   size_t blocked_at;            // only valid for blocked regions
+  size_t scrubbed_pages;        // only valid for scrubbing and free regions
+
+  // The clone's DRAM region paired with this region by clone_enclave().
+  //
+  // Only valid during a clone_enclave() call that uses the region's owner as
+  // its template, and protected by the owner's enclave lock.
+  size_t clone_region;
 };
 
 // Accounting information for all DRAM regions.
@@ -52,20 +63,58 @@ struct dram_regions_info_t {
   //       must be accessible in flush_cached_dram_regions(), which must be
   //       lock-free.
   atomic<size_t> block_clock;
+
+  // The smallest flushed_at value across all cores.
+  //
+  // A blocked region can be freed once its blocked_at is below this value,
+  // because every core has flushed its TLB after the region was blocked. The
+  // watermark never decreases. It is advanced by dram_region_tlb_flush(), so
+  // checking if a region can be freed does not read every core's flush info.
+  atomic<size_t> flushed_watermark;
+
+  // Cores whose flushed_at is below this must flush their TLBs the next time
+  // they enter the monitor.
+  //
+  // This is raised by request_tlb_shootdown(). A single value serves as every
+  // core's pending flush request, so requesting a shootdown doesn't write to
+  // the cores' flush info lines. It never decreases.
+  atomic<size_t> shootdown_clock;
 };
 
 // The regions are allocated at boot time, so the physical pointers never
 // change.
+//
+// The arrays start at LLC line boundaries, and g_dram_region's entries are
+// padded to whole cache lines, so cores that work on different DRAM regions
+// don't invalidate each other's cache lines. Use dram_region_info_for() to
+// index g_dram_region.
 
 extern phys_ptr<dram_region_info_t> g_dram_region;
+
+// The DRAM regions blocked most recently, indexed by their blocked_at values.
+//
+// Entry `blocked_at & (g_dram_region_count - 1)` holds 1 + the index of the
+// region blocked at `blocked_at`, or 0 once the region's freeable event was
+// claimed. A region blocked at a value above the flush watermark cannot be
+// freed, so at most g_dram_region_count blocks wait for their events, and the
+// array never wraps onto a block whose event is still pending.
+extern phys_ptr<atomic<size_t>> g_dram_region_block_log;
 extern phys_ptr<dram_regions_info_t> g_dram_regions;
 
+// The distance in bytes between consecutive entries in g_dram_region.
+extern size_t g_dram_region_stride;
+
 // The fields below are set by boot_init_dram_regions() and never change
 // afterwards. Therefore, they do not require locking.
 
 // Amount of DRAM installed on the system.
 extern size_t g_dram_size;
 
+// The size of a line in the last-level cache.
+//
+// Monitor arrays that are written by different cores are aligned to this.
+extern size_t g_cache_line_size;
+
 // NOTE: There is no g_dram_stripe_page_shift -- that is simply page_shift().
 
 // The position of the least significant 1 bit in the DRAM region mask.
@@ -131,8 +180,25 @@ constexpr enclave_id_t blocked_enclave_id = 1;
 constexpr enclave_id_t metadata_enclave_id = 2;
 
 // The enclave ID used as the owner of a free DRAM region.
+//
+// The region may still hold data from its previous owner.
 constexpr enclave_id_t free_enclave_id = 3;
 
+// The enclave ID used as the owner of a DRAM region that is being zeroed.
+constexpr enclave_id_t scrubbing_enclave_id = 4;
+
+// The enclave ID used as the owner of a free DRAM region that was zeroed.
+//
+// Free regions in this state are reported as free by dram_region_state(), and
+// can be used wherever a free region is accepted.
+constexpr enclave_id_t clean_enclave_id = 5;
+
+// The most pages that a scrub_dram_region() call will zero.
+//
+// This bounds the latency of scrub_dram_region() and scrub_step(), and the time
+// that a region's lock is held.
+constexpr size_t dram_region_scrub_max_pages = 256;
+
 };  // namespace sanctum::internal
 };  // namespace sanctum
 #endif  // !defined(MONITOR_DRAM_REGIONS_H_INCLUDED)
@@ -4,15 +4,22 @@
 #include "bare/bit_masking.h"
 #include "bare/cpu_context.h"
 #include "bare/memory.h"
-#include "cpu_core.h"
+#include "cpu_core_inl.h"
 #include "dram_regions.h"
+#include "event_queue_inl.h"
 
 namespace sanctum {
 namespace internal {  // sanctum::internal
 
 using sanctum::api::enclave_id_t;
+using sanctum::api::os::monitor_event_dram_region_freeable;
+using sanctum::api::os::monitor_event_dram_region_scrubbed;
+using sanctum::bare::atomic_compare_exchange_strong;
 using sanctum::bare::atomic_flag;
+using sanctum::bare::atomic_load;
+using sanctum::bare::atomic_store;
 using sanctum::bare::bzero;
+using sanctum::bare::cache_bypass;
 using sanctum::bare::page_shift;
 using sanctum::bare::phys_ptr;
 using sanctum::bare::size_t;
@@ -86,6 +93,14 @@ inline size_t dram_region_page_for(uintptr_t address) {
       (g_dram_region_shift - g_dram_stripe_shift));
 }
 
+// The physical address of the accounting information for a DRAM region.
+//
+// Invalid DRAM region indices will yield invalid pointers.
+inline phys_ptr<dram_region_info_t> dram_region_info_for(size_t dram_region) {
+  return phys_ptr<dram_region_info_t>{
+      uintptr_t(g_dram_region) + dram_region * g_dram_region_stride};
+}
+
 // Acquires the lock for a DRAM region.
 //
 // Invalid DRAM region indices will cause memory thrashing.
@@ -93,7 +108,7 @@ inline size_t dram_region_page_for(uintptr_t address) {
 // Returns false if the lock was acquired, and true if it was already held by
 // someone else.
 inline bool test_and_set_dram_region_lock(size_t dram_region) {
-  phys_ptr<dram_region_info_t> region = &g_dram_region[dram_region];
+  phys_ptr<dram_region_info_t> region = dram_region_info_for(dram_region);
   return atomic_flag_test_and_set(&(region->*(&dram_region_info_t::lock)));
 }
 
@@ -104,20 +119,44 @@ inline bool test_and_set_dram_region_lock(size_t dram_region) {
 // Clear a lock that was not explicitly acquired is a security vulnerability,
 // because another piece of code might have acquired the lock.
 inline void clear_dram_region_lock(size_t dram_region) {
-  phys_ptr<dram_region_info_t> region = &g_dram_region[dram_region];
+  phys_ptr<dram_region_info_t> region = dram_region_info_for(dram_region);
   atomic_flag_clear(&(region->*(&dram_region_info_t::lock)));
 }
 
 // Reads the owner from a DRAM region.
 //
 // Invalid DRAM region indices will cause memory reads outside the DRAM space.
+//
+// This does not require holding the DRAM region's lock. Without the lock, the
+// result is a consistent snapshot of the owner and state, but it may be stale
+// by the time it is used.
 inline enclave_id_t read_dram_region_owner(size_t dram_region) {
-  const phys_ptr<dram_region_info_t> region = &g_dram_region[dram_region];
-  return region->*(&dram_region_info_t::owner);
+  const phys_ptr<dram_region_info_t> region = dram_region_info_for(dram_region);
+  return atomic_load(&(region->*(&dram_region_info_t::owner)));
+}
+
+// Changes the owner of a DRAM region.
+//
+// Invalid DRAM region indices will cause memory trashing.
+//
+// The caller must hold the DRAM region's lock. The new owner becomes visible
+// to lock-free readers at once, so the region's other fields must be updated
+// before the owner.
+inline void write_dram_region_owner(size_t dram_region, enclave_id_t owner) {
+  phys_ptr<dram_region_info_t> region = dram_region_info_for(dram_region);
+  atomic_store(&(region->*(&dram_region_info_t::owner)), owner);
+}
+
+// True if a DRAM region owner value indicates a free region.
+inline bool is_free_dram_region_owner(enclave_id_t owner) {
+  return owner == free_enclave_id || owner == clean_enclave_id;
 }
 
 // Wipes the data in a DRAM region.
 //
+// The zeros bypass the caches, so wiping a region does not evict the LLC lines
+// of other regions' data.
+//
 // Invalid DRAM region indices will cause memory trashing.
 inline void bzero_dram_region(size_t dram_region) {
   // The address diff between two stripes belonging to the same DRAM region.
@@ -126,8 +165,188 @@ inline void bzero_dram_region(size_t dram_region) {
   const uintptr_t region_start = dram_region << g_dram_region_shift;
   for (uintptr_t stripe = 0; stripe < g_dram_size; stripe += stripe_step) {
     const uintptr_t stripe_start = stripe | region_start;
-    bzero(phys_ptr<size_t>{stripe_start}, g_dram_stripe_size);
+    bzero(phys_ptr<size_t>{stripe_start}, g_dram_stripe_size, cache_bypass);
+  }
+}
+
+// The number of pages in a DRAM region.
+//
+// Page i of a DRAM region is page (i % g_dram_stripe_pages) of the region's
+// stripe number (i / g_dram_stripe_pages).
+inline size_t dram_region_page_count() {
+  // The address diff between two stripes belonging to the same DRAM region.
+  const uintptr_t stripe_step = g_dram_region_count << g_dram_region_shift;
+
+  const size_t stripe_count = (g_dram_size + stripe_step - 1) / stripe_step;
+  return stripe_count * g_dram_stripe_pages;
+}
+
+// Wipes a range of pages in a DRAM region.
+//
+// Pages are numbered as described in dram_region_page_count(). Each run of
+// pages in a stripe is wiped by a single bzero() call that bypasses the
+// caches, like bzero_dram_region().
+//
+// Invalid DRAM region indices or page ranges will cause memory trashing.
+inline void bzero_dram_region_pages(size_t dram_region, size_t first_page,
+    size_t page_count) {
+  // The address diff between two stripes belonging to the same DRAM region.
+  const uintptr_t stripe_step = g_dram_region_count << g_dram_region_shift;
+
+  const uintptr_t region_start = dram_region << g_dram_region_shift;
+  const size_t end_page = first_page + page_count;
+  for (size_t page = first_page; page < end_page;) {
+    // NOTE: relying on the compiler to optimize division to bitwise shift
+    const size_t stripe = page / g_dram_stripe_pages;
+    const size_t stripe_page = page % g_dram_stripe_pages;
+    size_t run_pages = g_dram_stripe_pages - stripe_page;
+    if (run_pages > end_page - page)
+      run_pages = end_page - page;
+
+    const uintptr_t run_start = (stripe * stripe_step) | region_start |
+        (stripe_page << page_shift());
+    bzero(phys_ptr<size_t>{run_start}, run_pages << page_shift(),
+        cache_bypass);
+    page += run_pages;
+  }
+}
+
+// Zeroes the next pages of a scrubbing or free DRAM region.
+//
+// The caller must hold the DRAM region's lock. The region's progress is kept
+// in its scrubbed_pages field. A region becomes clean when its last page is
+// zeroed.
+//
+// Returns the number of pages zeroed, which is at most `page_budget`. Returns
+// 0 if the region is in any other state, or if it is already clean.
+inline size_t scrub_locked_dram_region(size_t dram_region,
+    size_t page_budget) {
+  const enclave_id_t owner = read_dram_region_owner(dram_region);
+  if (owner != scrubbing_enclave_id && owner != free_enclave_id)
+    return 0;
+
+  phys_ptr<dram_region_info_t> region = dram_region_info_for(dram_region);
+  const size_t scrubbed_pages =
+      region->*(&dram_region_info_t::scrubbed_pages);
+  const size_t region_pages = dram_region_page_count();
+  size_t page_count = region_pages - scrubbed_pages;
+  if (page_count > page_budget)
+    page_count = page_budget;
+
+  bzero_dram_region_pages(dram_region, scrubbed_pages, page_count);
+  region->*(&dram_region_info_t::scrubbed_pages) =
+      scrubbed_pages + page_count;
+  if (scrubbed_pages + page_count == region_pages) {
+    write_dram_region_owner(dram_region, clean_enclave_id);
+    post_monitor_event(monitor_event_dram_region_scrubbed, dram_region);
   }
+  return page_count;
+}
+
+// Raises an atomic counter to a value, unless it is already larger.
+//
+// This is lock-free. Concurrent callers leave the counter at the largest of
+// their values.
+//
+// Returns the counter's value before the call. If that is smaller than
+// `value`, this call raised the counter from the returned value.
+inline size_t atomic_store_max(phys_ptr<atomic<size_t>> object, size_t value) {
+  size_t old_value = atomic_load(object);
+  while (old_value < value) {
+    if (atomic_compare_exchange_strong(object, &old_value, value))
+      break;
+  }
+  return old_value;
+}
+
+// The g_dram_region_block_log entry for a blocked_at value.
+inline phys_ptr<atomic<size_t>> dram_region_block_log_entry(
+    size_t blocked_at) {
+  return g_dram_region_block_log + (blocked_at & (g_dram_region_count - 1));
+}
+
+// Posts the freeable event for the DRAM region blocked at a block_clock value.
+//
+// This is lock-free. Both block_dram_region() and watermark advances call
+// this, so the event is claimed by clearing its log entry, and only the caller
+// that clears the entry posts the event. Nothing is posted if the entry was
+// overwritten by a later block, because that means the region was freed.
+inline void post_freeable_dram_region_event(size_t blocked_at) {
+  const phys_ptr<atomic<size_t>> entry =
+      dram_region_block_log_entry(blocked_at);
+  size_t logged = atomic_load(entry);
+  if (logged == 0)
+    return;
+  // NOTE: blocked_at is written before the log entry, so it is valid here
+  const size_t dram_region = logged - 1;
+  if (dram_region_info_for(dram_region)->*(&dram_region_info_t::blocked_at) !=
+      blocked_at) {
+    return;
+  }
+  if (atomic_compare_exchange_strong(entry, &logged, static_cast<size_t>(0)))
+    post_monitor_event(monitor_event_dram_region_freeable, dram_region);
+}
+
+// Posts events for the blocked DRAM regions freed up by a watermark advance.
+//
+// `old_watermark` and `new_watermark` are the flush watermark's values before
+// and after the advance. Regions blocked before `old_watermark` had their
+// events posted by an earlier advance.
+//
+// NOTE: This only visits the block_clock values passed by the advance. Every
+//       value belongs to a region that is still blocked, so an advance visits
+//       at most g_dram_region_count values, and each value is only visited
+//       once, which keeps TLB flushes O(1) per blocked region.
+inline void post_freeable_dram_region_events(size_t old_watermark,
+    size_t new_watermark) {
+  if (event_queue_addr() == 0)
+    return;
+  for (size_t i = old_watermark; i < new_watermark; ++i)
+    post_freeable_dram_region_event(i);
+}
+
+// Raises the flush watermark to the smallest flushed_at value of all cores.
+//
+// This is lock-free. Each core's flushed_at only increases, so the scanned
+// minimum is never above the true minimum, even if cores flush during the
+// scan. Concurrent callers may compute different minimums; the watermark
+// keeps the largest one.
+inline void advance_dram_region_flush_watermark() {
+  size_t min_flushed_at = atomic_load(
+      &(core_flush_info_for(0)->*(&core_flush_info_t::flushed_at)));
+  for (size_t i = 1; i < g_core_count; ++i) {
+    const size_t flushed_at = atomic_load(
+        &(core_flush_info_for(i)->*(&core_flush_info_t::flushed_at)));
+    if (flushed_at < min_flushed_at)
+      min_flushed_at = flushed_at;
+  }
+
+  const size_t old_watermark = atomic_store_max(
+      &(g_dram_regions->*(&dram_regions_info_t::flushed_watermark)),
+      min_flushed_at);
+  if (old_watermark < min_flushed_at)
+    post_freeable_dram_region_events(old_watermark, min_flushed_at);
+}
+
+// True if every core flushed its TLB after a DRAM region was blocked.
+//
+// `blocked_at` is the region's blocked_at value. This only reads the flush
+// watermark, so it is cheap enough for OS retry loops.
+inline bool is_dram_region_tlb_flushed(size_t blocked_at) {
+  return blocked_at < atomic_load(
+      &(g_dram_regions->*(&dram_regions_info_t::flushed_watermark)));
+}
+
+// Records that a DRAM region was blocked, for the freeable event queue.
+//
+// The caller must hold the region's lock, and must have set its blocked_at.
+inline void log_blocked_dram_region(size_t dram_region, size_t blocked_at) {
+  atomic_store(dram_region_block_log_entry(blocked_at), dram_region + 1);
+
+  // NOTE: the watermark may have advanced past blocked_at before the entry
+  //       was written, in which case the advance didn't post this region
+  if (is_dram_region_tlb_flushed(blocked_at))
+    post_freeable_dram_region_event(blocked_at);
 }
 
 // Flushes the core's TLBs and updates the relevant flush generation counter.
@@ -140,10 +359,45 @@ inline void dram_region_tlb_flush() {
   //       flushed; the moment the counter is incremented, some DRAM region may
   //       be freed and reallocated; this sequence is
 
-  const phys_ptr<core_info_t> core_info{&g_core[current_core()]};
+  const phys_ptr<core_flush_info_t> flush_info =
+      core_flush_info_for(current_core());
   const size_t block_clock = atomic_load(
       &(g_dram_regions->*(&dram_regions_info_t::block_clock)));
-  atomic_store(&(core_info->*(&core_info_t::flushed_at)), block_clock);
+  const size_t old_flushed_at =
+      atomic_load(&(flush_info->*(&core_flush_info_t::flushed_at)));
+  atomic_store(&(flush_info->*(&core_flush_info_t::flushed_at)), block_clock);
+
+  // NOTE: only the cores that are holding back the watermark need to advance
+  //       it; the last of them to flush always sees every core's new value,
+  //       because it scans after its own store
+  if (block_clock != old_flushed_at && old_flushed_at <= atomic_load(
+      &(g_dram_regions->*(&dram_regions_info_t::flushed_watermark)))) {
+    advance_dram_region_flush_watermark();
+  }
+}
+
+// True if a core has not flushed its TLB since a DRAM region was blocked.
+//
+// `blocked_at` is the region's blocked_at value. This is lock-free.
+inline bool is_core_tlb_flush_pending(size_t core_id, size_t blocked_at) {
+  return atomic_load(&(core_flush_info_for(core_id)->*(
+      &core_flush_info_t::flushed_at))) <= blocked_at;
+}
+
+// Flushes the core's TLBs if a TLB shootdown is waiting for this core.
+//
+// This must be called whenever a core enters the monitor, including when it
+// receives a monitor IPI. It is lock-free, and it does not write to memory
+// unless a shootdown is pending.
+inline void service_tlb_shootdown() {
+  const phys_ptr<core_flush_info_t> flush_info =
+      core_flush_info_for(current_core());
+  const size_t shootdown_clock = atomic_load(
+      &(g_dram_regions->*(&dram_regions_info_t::shootdown_clock)));
+  if (atomic_load(&(flush_info->*(&core_flush_info_t::flushed_at))) <
+      shootdown_clock) {
+    dram_region_tlb_flush();
+  }
 }
 
 };  // namespace sanctum::internal
@@ -1,35 +1,60 @@
 #include "dram_regions_inl.h"
 
 #include "boot_init.h"
+#include "event_queue_inl.h"
 
 #include "gtest/gtest.h"
 
+using sanctum::api::os::monitor_event_dram_region_freeable;
+using sanctum::api::os::monitor_event_dram_region_scrubbed;
+using sanctum::api::os::monitor_event_t;
+using sanctum::bare::atomic;
 using sanctum::bare::atomic_load;
 using sanctum::bare::atomic_store;
 using sanctum::bare::phys_ptr;
+using sanctum::internal::blocked_enclave_id;
+using sanctum::internal::advance_dram_region_flush_watermark;
+using sanctum::internal::atomic_store_max;
 using sanctum::internal::boot_init_dram_regions;
 using sanctum::internal::boot_init_metadata;
 using sanctum::internal::boot_init_dynamic_arrays;
 using sanctum::internal::bzero_dram_region;
+using sanctum::internal::bzero_dram_region_pages;
 using sanctum::internal::clamped_dram_region_for;
+using sanctum::internal::clean_enclave_id;
 using sanctum::internal::clear_dram_region_lock;
-using sanctum::internal::core_info_t;
+using sanctum::internal::core_flush_info_for;
+using sanctum::internal::core_flush_info_t;
 using sanctum::internal::dram_region_for;
+using sanctum::internal::dram_region_info_for;
 using sanctum::internal::dram_region_info_t;
+using sanctum::internal::dram_region_page_count;
 using sanctum::internal::dram_regions_info_t;
 using sanctum::internal::dram_region_page_for;
 using sanctum::internal::dram_region_start;
 using sanctum::internal::dram_region_tlb_flush;
 using sanctum::internal::dram_stripe_for;
 using sanctum::internal::dram_stripe_page_for;
-using sanctum::internal::g_core;
-using sanctum::internal::g_dram_region;
+using sanctum::internal::free_enclave_id;
+using sanctum::internal::event_queue_capacity;
+using sanctum::internal::event_queue_slot;
+using sanctum::internal::g_dram_region_block_log;
 using sanctum::internal::g_dram_regions;
+using sanctum::internal::g_dram_stripe_pages;
+using sanctum::internal::is_core_tlb_flush_pending;
 using sanctum::internal::is_dram_address;
+using sanctum::internal::is_dram_region_tlb_flushed;
 using sanctum::internal::is_dynamic_dram_region;
 using sanctum::internal::is_valid_dram_region;
+using sanctum::internal::log_blocked_dram_region;
+using sanctum::internal::post_freeable_dram_region_events;
+using sanctum::internal::publish_event_queue;
 using sanctum::internal::read_dram_region_owner;
+using sanctum::internal::scrub_locked_dram_region;
+using sanctum::internal::scrubbing_enclave_id;
+using sanctum::internal::service_tlb_shootdown;
 using sanctum::internal::test_and_set_dram_region_lock;
+using sanctum::internal::write_dram_region_owner;
 
 namespace {
 
@@ -216,10 +241,10 @@ TEST_F(DramRegionInlTest, DramRegionLocks) {
   clear_dram_region_lock(5);
   test_and_set_dram_region_lock(5);
   ASSERT_EQ(atomic_flag_test_and_set(
-    &((g_dram_region + 5)->*(&dram_region_info_t::lock))), 1);
+    &(dram_region_info_for(5)->*(&dram_region_info_t::lock))), 1);
   clear_dram_region_lock(5);
   ASSERT_EQ(atomic_flag_test_and_set(
-    &((g_dram_region + 5)->*(&dram_region_info_t::lock))), 0);
+    &(dram_region_info_for(5)->*(&dram_region_info_t::lock))), 0);
   clear_dram_region_lock(5);
 
   clear_dram_region_lock(0);
@@ -238,11 +263,11 @@ TEST_F(DramRegionInlTest, DramRegionLocks) {
 }
 
 TEST_F(DramRegionInlTest, ReadDramRegionOwner) {
-  (g_dram_region + 0)->*(&dram_region_info_t::owner) = 0x42424242;
-  (g_dram_region + 1)->*(&dram_region_info_t::owner) = 0xabababab;
-  (g_dram_region + 2)->*(&dram_region_info_t::owner) = 0x98765432;
-  (g_dram_region + 5)->*(&dram_region_info_t::owner) = 0x12345678;
-  (g_dram_region + 7)->*(&dram_region_info_t::owner) = 0xfccffccf;
+  write_dram_region_owner(0, 0x42424242);
+  write_dram_region_owner(1, 0xabababab);
+  write_dram_region_owner(2, 0x98765432);
+  write_dram_region_owner(5, 0x12345678);
+  write_dram_region_owner(7, 0xfccffccf);
   ASSERT_EQ(read_dram_region_owner(0), 0x42424242);
   ASSERT_EQ(read_dram_region_owner(1), 0xabababab);
   ASSERT_EQ(read_dram_region_owner(2), 0x98765432);
@@ -250,10 +275,21 @@ TEST_F(DramRegionInlTest, ReadDramRegionOwner) {
   ASSERT_EQ(read_dram_region_owner(7), 0xfccffccf);
 }
 
+TEST_F(DramRegionInlTest, ReadDramRegionOwnerWhileLocked) {
+  write_dram_region_owner(5, 0x12345678);
+  ASSERT_EQ(test_and_set_dram_region_lock(5), 0);
+  ASSERT_EQ(read_dram_region_owner(5), 0x12345678);
+  write_dram_region_owner(5, 0x87654321);
+  ASSERT_EQ(read_dram_region_owner(5), 0x87654321);
+  clear_dram_region_lock(5);
+}
+
 TEST_F(DramRegionInlTest, BzeroDramRegion) {
   for (size_t i = 0; i < 256 * 1024; i += sizeof(uintptr_t))
     *(phys_ptr<uintptr_t>{i}) = ~0;
+  sanctum::testing::cache_bypass_bytes = 0;
   bzero_dram_region(1);
+  ASSERT_EQ(sanctum::testing::cache_bypass_bytes, 32 * 1024);
 
   for (size_t i = 0; i < 32 * 1024; i += sizeof(uintptr_t))
     ASSERT_EQ(*(phys_ptr<uintptr_t>{i}), ~0);
@@ -263,6 +299,87 @@ TEST_F(DramRegionInlTest, BzeroDramRegion) {
     ASSERT_EQ(*(phys_ptr<uintptr_t>{i}), ~0);
 }
 
+TEST_F(DramRegionInlTest, DramRegionPageCount) {
+  ASSERT_EQ(dram_region_page_count(), 8);
+
+  sanctum::testing::max_cache_index_shift = 1;
+  boot_init_dram_regions();
+  ASSERT_EQ(dram_region_page_count(), 8);
+}
+
+TEST_F(DramRegionInlTest, BzeroDramRegionPages) {
+  for (size_t i = 0; i < 256 * 1024; i += sizeof(uintptr_t))
+    *(phys_ptr<uintptr_t>{i}) = ~0;
+  bzero_dram_region_pages(1, 2, 3);
+
+  for (size_t i = 0; i < 34 * 1024; i += sizeof(uintptr_t))
+    ASSERT_EQ(*(phys_ptr<uintptr_t>{i}), ~0);
+  for (size_t i = 40 * 1024; i < 52 * 1024; i += sizeof(uintptr_t))
+    ASSERT_EQ(*(phys_ptr<uintptr_t>{i}), 0);
+  for (size_t i = 52 * 1024; i < 256 * 1024; i += sizeof(uintptr_t))
+    ASSERT_EQ(*(phys_ptr<uintptr_t>{i}), ~0);
+}
+
+TEST_F(DramRegionInlTest, BzeroDramRegionPagesAcrossStripes) {
+  // Each region has 4 stripes with 2 pages each.
+  sanctum::testing::max_cache_index_shift = 1;
+  boot_init_dram_regions();
+  ASSERT_EQ(g_dram_stripe_pages, 2);
+
+  for (size_t i = 0; i < 256 * 1024; i += sizeof(uintptr_t))
+    *(phys_ptr<uintptr_t>{i}) = ~0;
+  bzero_dram_region_pages(1, 1, 4);
+
+  const uintptr_t zeroed_pages[] = { 0x3000, 0x12000, 0x13000, 0x22000 };
+  for (size_t i = 0; i < 256 * 1024; i += sizeof(uintptr_t)) {
+    bool is_zeroed = false;
+    for (uintptr_t page : zeroed_pages) {
+      if (i >= page && i < page + 0x1000)
+        is_zeroed = true;
+    }
+    ASSERT_EQ(*(phys_ptr<uintptr_t>{i}), is_zeroed ? 0 : ~0) << i;
+  }
+}
+
+TEST_F(DramRegionInlTest, ScrubLockedDramRegion) {
+  for (size_t i = 96 * 1024; i < 128 * 1024; i += sizeof(uintptr_t))
+    *(phys_ptr<uintptr_t>{i}) = ~0;
+  phys_ptr<dram_region_info_t> region = dram_region_info_for(3);
+  region->*(&dram_region_info_t::scrubbed_pages) = 0;
+  write_dram_region_owner(3, free_enclave_id);
+
+  ASSERT_EQ(scrub_locked_dram_region(3, 3), 3);
+  ASSERT_EQ(read_dram_region_owner(3), free_enclave_id);
+  ASSERT_EQ(region->*(&dram_region_info_t::scrubbed_pages), 3);
+  for (size_t i = 96 * 1024; i < 108 * 1024; i += sizeof(uintptr_t))
+    ASSERT_EQ(*(phys_ptr<uintptr_t>{i}), 0);
+  for (size_t i = 108 * 1024; i < 128 * 1024; i += sizeof(uintptr_t))
+    ASSERT_EQ(*(phys_ptr<uintptr_t>{i}), ~0);
+
+  ASSERT_EQ(scrub_locked_dram_region(3, 10), 5);
+  ASSERT_EQ(read_dram_region_owner(3), clean_enclave_id);
+  for (size_t i = 96 * 1024; i < 128 * 1024; i += sizeof(uintptr_t))
+    ASSERT_EQ(*(phys_ptr<uintptr_t>{i}), 0);
+
+  ASSERT_EQ(scrub_locked_dram_region(3, 10), 0);
+  ASSERT_EQ(read_dram_region_owner(3), clean_enclave_id);
+}
+
+TEST_F(DramRegionInlTest, ScrubLockedScrubbingDramRegion) {
+  phys_ptr<dram_region_info_t> region = dram_region_info_for(3);
+  region->*(&dram_region_info_t::scrubbed_pages) = 6;
+  write_dram_region_owner(3, scrubbing_enclave_id);
+  ASSERT_EQ(scrub_locked_dram_region(3, 10), 2);
+  ASSERT_EQ(read_dram_region_owner(3), clean_enclave_id);
+
+  // Owned and blocked regions are never zeroed.
+  region->*(&dram_region_info_t::scrubbed_pages) = 0;
+  write_dram_region_owner(3, 0);
+  ASSERT_EQ(scrub_locked_dram_region(3, 10), 0);
+  write_dram_region_owner(3, blocked_enclave_id);
+  ASSERT_EQ(scrub_locked_dram_region(3, 10), 0);
+}
+
 TEST_F(DramRegionInlTest, DramRegionTlbFlush) {
   sanctum::testing::core_tlb_flush_count[0] = 16;
   sanctum::testing::core_tlb_flush_count[1] = 32;
@@ -271,7 +388,7 @@ TEST_F(DramRegionInlTest, DramRegionTlbFlush) {
   sanctum::testing::set_current_core(2);
   atomic_store(&(g_dram_regions->*(&dram_regions_info_t::block_clock)),
                static_cast<size_t>(0x12345678));
-  atomic_store(&((g_core + 2)->*(&core_info_t::flushed_at)),
+  atomic_store(&(core_flush_info_for(2)->*(&core_flush_info_t::flushed_at)),
                static_cast<size_t>(0));
 
   dram_region_tlb_flush();
@@ -280,10 +397,157 @@ TEST_F(DramRegionInlTest, DramRegionTlbFlush) {
   ASSERT_EQ(sanctum::testing::core_tlb_flush_count[1], 32);
   ASSERT_EQ(sanctum::testing::core_tlb_flush_count[2], 65);
   ASSERT_EQ(sanctum::testing::core_tlb_flush_count[3], 128);
-  ASSERT_EQ(atomic_load(&((g_core + 2)->*(&core_info_t::flushed_at))),
+  ASSERT_EQ(atomic_load(&(core_flush_info_for(2)->*(&core_flush_info_t::flushed_at))),
             static_cast<size_t>(0x12345678));
 }
 
+TEST_F(DramRegionInlTest, DramRegionTlbFlushAdvancesWatermark) {
+  const phys_ptr<atomic<size_t>> watermark =
+      &(g_dram_regions->*(&dram_regions_info_t::flushed_watermark));
+  ASSERT_EQ(atomic_load(watermark), 0);
+
+  // Region blocked when block_clock was 4.
+  atomic_store(&(g_dram_regions->*(&dram_regions_info_t::block_clock)),
+               static_cast<size_t>(5));
+  for (size_t i = 0; i < 3; ++i) {
+    sanctum::testing::set_current_core(i);
+    dram_region_tlb_flush();
+    ASSERT_EQ(atomic_load(watermark), 0) << i;
+    ASSERT_FALSE(is_dram_region_tlb_flushed(4)) << i;
+  }
+
+  sanctum::testing::set_current_core(3);
+  dram_region_tlb_flush();
+  ASSERT_EQ(atomic_load(watermark), 5);
+  ASSERT_TRUE(is_dram_region_tlb_flushed(4));
+  ASSERT_FALSE(is_dram_region_tlb_flushed(5));
+}
+
+TEST_F(DramRegionInlTest, WatermarkAdvancePostsFreeableEvents) {
+  constexpr uintptr_t queue_addr = 0x38000;
+  memset(sanctum::testing::phys_buffer + queue_addr, 0, 0x1000);
+  publish_event_queue(queue_addr, event_queue_capacity(1));
+
+  // Region 3 was blocked when block_clock was 4, and region 5 when it was 6.
+  dram_region_info_for(3)->*(&dram_region_info_t::blocked_at) = 4;
+  write_dram_region_owner(3, blocked_enclave_id);
+  log_blocked_dram_region(3, 4);
+  dram_region_info_for(5)->*(&dram_region_info_t::blocked_at) = 6;
+  write_dram_region_owner(5, blocked_enclave_id);
+  log_blocked_dram_region(5, 6);
+  EXPECT_EQ(event_queue_slot(queue_addr, 0)->*(&monitor_event_t::sequence),
+            0);
+  atomic_store(&(g_dram_regions->*(&dram_regions_info_t::block_clock)),
+               static_cast<size_t>(5));
+  for (size_t i = 0; i < 4; ++i) {
+    sanctum::testing::set_current_core(i);
+    dram_region_tlb_flush();
+  }
+
+  phys_ptr<monitor_event_t> event = event_queue_slot(queue_addr, 0);
+  EXPECT_EQ(event->*(&monitor_event_t::sequence), 1);
+  EXPECT_EQ(event->*(&monitor_event_t::type),
+            monitor_event_dram_region_freeable);
+  EXPECT_EQ(event->*(&monitor_event_t::value), 3);
+  EXPECT_EQ(event_queue_slot(queue_addr, 1)->*(&monitor_event_t::sequence),
+            0);
+
+  // Scrubbing a region to completion posts an event as well.
+  dram_region_info_for(6)->*(&dram_region_info_t::scrubbed_pages) = 7;
+  write_dram_region_owner(6, scrubbing_enclave_id);
+  ASSERT_EQ(scrub_locked_dram_region(6, 10), 1);
+  event = event_queue_slot(queue_addr, 1);
+  EXPECT_EQ(event->*(&monitor_event_t::sequence), 2);
+  EXPECT_EQ(event->*(&monitor_event_t::type),
+            monitor_event_dram_region_scrubbed);
+  EXPECT_EQ(event->*(&monitor_event_t::value), 6);
+
+  publish_event_queue(0, 0);
+}
+
+TEST_F(DramRegionInlTest, FreeableEventsArePostedOnce) {
+  constexpr uintptr_t queue_addr = 0x38000;
+  memset(sanctum::testing::phys_buffer + queue_addr, 0, 0x1000);
+  publish_event_queue(queue_addr, event_queue_capacity(1));
+
+  // The watermark advanced past block_clock 2 before region 4's log entry was
+  // written, so logging the block posts the event.
+  atomic_store(&(g_dram_regions->*(&dram_regions_info_t::flushed_watermark)),
+               static_cast<size_t>(5));
+  dram_region_info_for(4)->*(&dram_region_info_t::blocked_at) = 2;
+  write_dram_region_owner(4, blocked_enclave_id);
+  log_blocked_dram_region(4, 2);
+
+  // Region 2 was logged at block_clock 1, then freed and blocked again at 9.
+  dram_region_info_for(2)->*(&dram_region_info_t::blocked_at) = 9;
+  write_dram_region_owner(2, blocked_enclave_id);
+  atomic_store(&(g_dram_region_block_log[1]), static_cast<size_t>(2 + 1));
+
+  post_freeable_dram_region_events(0, 5);
+
+  phys_ptr<monitor_event_t> event = event_queue_slot(queue_addr, 0);
+  EXPECT_EQ(event->*(&monitor_event_t::sequence), 1);
+  EXPECT_EQ(event->*(&monitor_event_t::value), 4);
+  EXPECT_EQ(event_queue_slot(queue_addr, 1)->*(&monitor_event_t::sequence),
+            0);
+  EXPECT_EQ(atomic_load(&(g_dram_region_block_log[2])), 0);
+
+  publish_event_queue(0, 0);
+}
+
+TEST_F(DramRegionInlTest, AdvanceDramRegionFlushWatermark) {
+  const phys_ptr<atomic<size_t>> watermark =
+      &(g_dram_regions->*(&dram_regions_info_t::flushed_watermark));
+  for (size_t i = 0; i < 4; ++i) {
+    atomic_store(&(core_flush_info_for(i)->*(&core_flush_info_t::flushed_at)),
+                 static_cast<size_t>(10 + i));
+  }
+  advance_dram_region_flush_watermark();
+  ASSERT_EQ(atomic_load(watermark), 10);
+
+  // The watermark never decreases.
+  atomic_store(&(core_flush_info_for(2)->*(&core_flush_info_t::flushed_at)),
+               static_cast<size_t>(7));
+  advance_dram_region_flush_watermark();
+  ASSERT_EQ(atomic_load(watermark), 10);
+}
+
+TEST_F(DramRegionInlTest, AtomicStoreMax) {
+  const phys_ptr<atomic<size_t>> clock =
+      &(g_dram_regions->*(&dram_regions_info_t::shootdown_clock));
+  atomic_store_max(clock, 7);
+  ASSERT_EQ(atomic_load(clock), 7);
+  atomic_store_max(clock, 3);
+  ASSERT_EQ(atomic_load(clock), 7);
+  atomic_store_max(clock, 9);
+  ASSERT_EQ(atomic_load(clock), 9);
+}
+
+TEST_F(DramRegionInlTest, ServiceTlbShootdown) {
+  for (size_t i = 0; i < 4; ++i)
+    sanctum::testing::core_tlb_flush_count[i] = 0;
+  atomic_store(&(g_dram_regions->*(&dram_regions_info_t::block_clock)),
+               static_cast<size_t>(3));
+
+  // No shootdown was requested.
+  sanctum::testing::set_current_core(1);
+  service_tlb_shootdown();
+  ASSERT_EQ(sanctum::testing::core_tlb_flush_count[1], 0);
+  ASSERT_TRUE(is_core_tlb_flush_pending(1, 2));
+
+  // A region blocked when block_clock was 2.
+  atomic_store(&(g_dram_regions->*(&dram_regions_info_t::shootdown_clock)),
+               static_cast<size_t>(3));
+  service_tlb_shootdown();
+  ASSERT_EQ(sanctum::testing::core_tlb_flush_count[1], 1);
+  ASSERT_FALSE(is_core_tlb_flush_pending(1, 2));
+  ASSERT_TRUE(is_core_tlb_flush_pending(0, 2));
+
+  // The core already flushed.
+  service_tlb_shootdown();
+  ASSERT_EQ(sanctum::testing::core_tlb_flush_count[1], 1);
+}
+
 // TODO: test dram_stripe_for in multi-stripe memory setting
 // TODO: test dram_region_page_for in multi-stripe memory setting
 // TODO: test bzero_dram_region in multi-stripe memory setting
@@ -5,6 +5,7 @@
 #include "cpu_core_inl.h"
 #include "dram_regions_inl.h"
 #include "enclave_inl.h"
+#include "event_queue_inl.h"
 #include "metadata_inl.h"
 
 using sanctum::api::api_result_t;
@@ -18,8 +19,11 @@ using sanctum::api::enclave_id_t;
 using sanctum::api::enclave::thread_init_info_t;
 using sanctum::api::os::dram_region_free;
 using sanctum::api::os::dram_region_owned;
+using sanctum::api::os::monitor_event_enclave_deleted;
 using sanctum::api::thread_id_t;
 using sanctum::bare::atomic_fetch_add;
+using sanctum::bare::find_next_set_bit;
+using sanctum::bare::for_each_set_bit;
 using sanctum::bare::is_page_aligned;
 using sanctum::bare::page_size;
 using sanctum::bare::phys_ptr;
@@ -31,25 +35,27 @@ using sanctum::bare::set_ev_base;
 using sanctum::bare::set_ev_mask;
 using sanctum::bare::size_t;
 using sanctum::bare::uintptr_t;
-using sanctum::internal::bzero_dram_region;
 using sanctum::internal::clamped_dram_region_for;
 using sanctum::internal::clear_dram_region_lock;
 using sanctum::internal::core_info_t;
 using sanctum::internal::current_core_info;
 using sanctum::internal::current_enclave;
 using sanctum::internal::dram_region_for;
+using sanctum::internal::dram_region_info_for;
 using sanctum::internal::dram_region_info_t;
 using sanctum::internal::dram_region_start;
 using sanctum::internal::enclave_info_t;
 using sanctum::internal::enclave_region_bitmap;
-using sanctum::internal::free_enclave_id;
-using sanctum::internal::g_dram_region;
 using sanctum::internal::g_dram_region_count;
 using sanctum::internal::is_dram_address;
 using sanctum::internal::is_valid_enclave_id;
+using sanctum::internal::post_monitor_event;
 using sanctum::internal::read_dram_region_owner;
 using sanctum::internal::read_enclave_region_bitmap_bit;
+using sanctum::internal::scrubbing_enclave_id;
+using sanctum::internal::service_tlb_shootdown;
 using sanctum::internal::test_and_set_dram_region_lock;
+using sanctum::internal::write_dram_region_owner;
 using sanctum::internal::thread_metadata_size;
 using sanctum::internal::thread_info_t;
 
@@ -83,38 +89,35 @@ api_result_t delete_enclave(enclave_id_t enclave_id) {
     return monitor_invalid_state;
   }
 
+  // NOTE: the bitmap walks below only visit the regions owned by the enclave,
+  //       so their cost doesn't depend on the number of DRAM regions
   phys_ptr<size_t> region_bitmap = enclave_region_bitmap(enclave_id);
-  size_t region_iterator = 0;
-  for (; region_iterator < g_dram_region_count; ++region_iterator) {
+  size_t region_iterator =
+      find_next_set_bit(region_bitmap, g_dram_region_count, 0);
+  for (; region_iterator < g_dram_region_count;
+       region_iterator = find_next_set_bit(region_bitmap, g_dram_region_count,
+           region_iterator + 1)) {
     if (region_iterator == dram_region)
       continue;  // We've already locked the enclave's main DRAM region.
-    if (!read_bitmap_bit(region_bitmap, region_iterator))
-      continue;  // This region does not belong to the enclave.
     if (test_and_set_dram_region_lock(region_iterator))
       break;  // Failed to acquire lock on region.
   }
   if (region_iterator < g_dram_region_count) {
     // We failed to acquire a DRAM region lock. Unlock everything we touched.
-    for (size_t i = 0; i < region_iterator; ++i) {
-      if (i == dram_region)
-        continue;  // We've already locked the enclave's main DRAM region.
-      if (!read_bitmap_bit(region_bitmap, i))
-        continue;  // This region does not belong to the enclave.
-      clear_dram_region_lock(i);
-    }
+    for_each_set_bit(region_bitmap, region_iterator, [&](size_t i) {
+      if (i != dram_region)
+        clear_dram_region_lock(i);
+    });
     clear_dram_region_lock(dram_region);
     return monitor_concurrent_call;
   }
 
-  // NOTE: we know that no enclave thread is running, so we can free the
+  // NOTE: we know that no enclave thread is running, so we can release the
   //       enclave's DRAM regions directly, without going through the blocking
-  //       state
-  for (size_t i = 0; i < g_dram_region_count; ++i) {
-    if (!read_bitmap_bit(region_bitmap, region_iterator))
-      continue;  // This region does not belong to the enclave.
-
-    phys_ptr<dram_region_info_t> region = &g_dram_region[i];
-    region->*(&dram_region_info_t::owner) = free_enclave_id;
+  //       state; the regions still hold the enclave's secrets, so they must be
+  //       scrubbed before they become free
+  for_each_set_bit(region_bitmap, g_dram_region_count, [](size_t i) {
+    phys_ptr<dram_region_info_t> region = dram_region_info_for(i);
 
     // NOTE: The enclave's DRAM regions have pages and pinned pages, due to
     //       threads. The rest of the system assumes that pinned_pages is zero
@@ -123,22 +126,26 @@ api_result_t delete_enclave(enclave_id_t enclave_id) {
     //       that pinned_pages is zero for the DRAM regions that we free.
     region->*(&dram_region_info_t::pinned_pages) = 0;
 
-    bzero_dram_region(i);
-  }
+    // NOTE: zeroing a whole region could take a very long time, so the OS
+    //       does it in bounded steps by calling scrub_dram_region()
+    region->*(&dram_region_info_t::scrubbed_pages) = 0;
+    write_dram_region_owner(i, scrubbing_enclave_id);
+  });
 
-  for (size_t i = 0; i < g_dram_region_count; ++i) {
-    if (i == dram_region)
-      continue;  // We've already locked the enclave's main DRAM region.
-    if (!read_bitmap_bit(region_bitmap, i))
-      continue;  // This region does not belong to the enclave.
-    clear_dram_region_lock(i);
-  }
+  for_each_set_bit(region_bitmap, g_dram_region_count, [&](size_t i) {
+    if (i != dram_region)
+      clear_dram_region_lock(i);
+  });
   clear_dram_region_lock(dram_region);
+
+  post_monitor_event(monitor_event_enclave_deleted, enclave_id);
   return monitor_ok;
 }
 
 api_result_t enter_enclave(enclave_id_t enclave_id,
     thread_id_t thread_id) {
+  service_tlb_shootdown();
+
   size_t dram_region = clamped_dram_region_for(enclave_id);
   if (test_and_set_dram_region_lock(dram_region))
     return monitor_concurrent_call;
@@ -399,6 +406,8 @@ api_result_t delete_thread(thread_id_t thread_id) {
 }
 
 api_result_t exit_enclave() {
+  service_tlb_shootdown();
+
   phys_ptr<core_info_t> core{current_core_info()};
 
   enclave_id_t enclave_id = core->*(&core_info_t::enclave_id);
@@ -19,7 +19,9 @@ using sanctum::bare::register_state_t;
 using sanctum::bare::size_t;
 using sanctum::bare::uintptr_t;
 using sanctum::crypto::hash_block_size;
+using sanctum::crypto::hash_result_size;
 using sanctum::crypto::hash_state_t;
+using sanctum::crypto::hash_word_t;
 
 // The per-thread information stored in metadata regions.
 struct thread_info_t {
@@ -51,6 +53,19 @@ struct thread_info_t {
   size_t can_resume;            // true if the AEX state is valid
 };
 
+// The height of the page tree used by tree-format measurements.
+//
+// An enclave measured in the tree format can have at most
+// 2^page_tree_height - 1 pages, which is well above the DRAM sizes we support.
+constexpr size_t page_tree_height = 32;
+
+// The number of hash words in a digest stored in the page tree.
+constexpr size_t page_tree_digest_words =
+    hash_result_size / sizeof(hash_word_t);
+
+// The number of words in a hash block that holds packed measurement records.
+constexpr size_t packed_block_words = hash_block_size / sizeof(size_t);
+
 // Per-enclave accounting information.
 //
 // This structure is stored at the beginning of an enclave's main DRAM region,
@@ -100,14 +115,53 @@ struct enclave_info_t {
   // The phyiscal address of the last page loaded into the enclave by the OS.
   uintptr_t last_load_addr;
 
+  // The level-0 page table that mapped the last page loaded into the enclave.
+  //
+  // This is a cache used by walk_load_page_tables(), because loaders tend to
+  // map consecutive virtual addresses. 0 means that the cache is empty.
+  uintptr_t walk_cursor_table;
+
+  // The lowest virtual address mapped by walk_cursor_table.
+  uintptr_t walk_cursor_base;
+
   // The enclave's measurement hash.
   //
   // This is updated by the enclave loading API calls, and finalized by
   // enclave_init(). It does not change afterwards.
   hash_state_t hash;
 
-  // Working area for the enclave measurement process.
-  uint32_t hash_block[hash_block_size / sizeof(uint32_t)];
+  // The format of the enclave's measurement.
+  //
+  // This is a measurement_mode_t value, stored as size_t so phys_ptr doesn't
+  // need to be specialized for the enum.
+  size_t measurement_mode;
+
+  // The number of page leaf digests added to the page tree.
+  //
+  // This is only used by tree-format measurements.
+  size_t page_tree_leaves;
+
+  // The roots of the complete subtrees in the page tree.
+  //
+  // When bit i of page_tree_leaves is set, the page_tree_digest_words words
+  // starting at i * page_tree_digest_words hold the root of a complete subtree
+  // with 2^i leaves. Adding a leaf merges equal-sized subtrees, like
+  // incrementing a binary counter, so the tree is built in O(log N) space.
+  hash_word_t page_tree[page_tree_height * page_tree_digest_words];
+
+  // The number of words in packed_block that hold measurement records.
+  //
+  // This is only used by packed measurements.
+  size_t packed_words;
+
+  // Packed measurement records that don't fill up a hash block yet.
+  //
+  // This can't live in the per-core scratch space, because records from
+  // separate monitor calls share hash blocks. Flushing the block at the end of
+  // each call would give most load_page_table() and load_thread() records a
+  // block of their own, and would make the measurement depend on how the OS
+  // batches its loading calls.
+  size_t packed_block[packed_block_words];
 };
 
 // The DRAM region bitmap for the OS.
@@ -10,11 +10,21 @@
 using sanctum::bare::atomic_fetch_add;
 using sanctum::bare::bcopy;
 using sanctum::bare::bzero;
+using sanctum::bare::cache_bypass;
 using sanctum::bare::ceil_power_of_two;
+using sanctum::bare::count_set_bitmap_bits;
+using sanctum::bare::find_next_set_bit;
+using sanctum::bare::for_each_set_bit;
+using sanctum::bare::is_leaf_page_table_entry;
 using sanctum::bare::is_page_aligned;
 using sanctum::bare::is_valid_page_table_entry;
 using sanctum::bare::is_valid_range;
 using sanctum::bare::page_size;
+using sanctum::bare::page_table_entry_acl;
+using sanctum::bare::page_table_entry_size;
+using sanctum::bare::page_table_entry_span;
+using sanctum::bare::page_table_entry_target;
+using sanctum::bare::page_table_leaf_acl_mask;
 using sanctum::bare::page_shift;
 using sanctum::bare::page_table_levels;
 using sanctum::bare::page_table_size;
@@ -24,31 +34,42 @@ using sanctum::bare::uintptr_t;
 using sanctum::bare::write_page_table_entry;
 using sanctum::internal::clamped_dram_region_for;
 using sanctum::internal::clear_dram_region_lock;
+using sanctum::internal::copy_and_extend_enclave_hash_with_page;
+using sanctum::internal::copy_enclave_hash;
 using sanctum::internal::dram_region_for;
+using sanctum::internal::dram_region_info_for;
 using sanctum::internal::dram_region_info_t;
 using sanctum::internal::dram_region_start;
+using sanctum::internal::dram_stripe_for;
 using sanctum::internal::enclave_info_t;
 using sanctum::internal::enclave_info_pages;
 using sanctum::internal::enclave_info_size;
 using sanctum::internal::enclave_region_bitmap;
-using sanctum::internal::extend_enclave_hash_with_page;
 using sanctum::internal::extend_enclave_hash_with_page_table;
 using sanctum::internal::extend_enclave_hash_with_thread;
+using sanctum::internal::extend_enclave_hash_with_zero_pages;
 using sanctum::internal::finalize_enclave_hash;
 using sanctum::internal::free_enclave_id;
 using sanctum::internal::g_dram_region;
+using sanctum::internal::g_dram_region_count;
+using sanctum::internal::g_dram_region_mask;
+using sanctum::internal::g_dram_size;
 using sanctum::internal::g_dram_stripe_size;
 using sanctum::internal::init_enclave_hash;
+using sanctum::internal::invalidate_walk_cursor;
 using sanctum::internal::is_dram_address;
 using sanctum::internal::is_enclave_virtual_address;
 using sanctum::internal::is_valid_dram_region;
 using sanctum::internal::is_valid_enclave_id;
+using sanctum::internal::lock_enclave;
 using sanctum::internal::read_dram_region_owner;
 using sanctum::internal::read_enclave_region_bitmap_bit;
 using sanctum::internal::test_and_set_dram_region_lock;
 using sanctum::internal::thread_metadata_pages;
 using sanctum::internal::thread_metadata_size;
 using sanctum::internal::thread_info_t;
+using sanctum::internal::unlock_enclave;
+using sanctum::internal::walk_load_page_tables;
 using sanctum::internal::walk_page_tables;
 using sanctum::internal::walk_page_tables_to_entry;
 
@@ -56,6 +77,261 @@ namespace sanctum {
 namespace api {  // sanctum::api
 namespace os {  // sancum::api::os
 
+namespace {
+
+// The number of DRAM region stripes touched by an aligned range of memory.
+//
+// DRAM regions are interleaved in stripes, so a large superpage can span many
+// regions. The stripes cycle through all the regions, so a range never
+// touches more than g_dram_region_count distinct stripes worth checking.
+inline size_t dram_stripes_for_range(size_t size) {
+  if (size <= g_dram_stripe_size)
+    return 1;
+  size_t stripes = size / g_dram_stripe_size;
+  return (stripes < g_dram_region_count) ? stripes : g_dram_region_count;
+}
+
+// Checks that an aligned range of memory is in DRAM regions owned by an
+// enclave.
+//
+// The caller must hold the enclave's lock.
+inline bool is_enclave_dram_range(enclave_id_t enclave_id, uintptr_t phys_addr,
+    size_t size) {
+  const size_t stripes = dram_stripes_for_range(size);
+  for (size_t i = 0; i < stripes; ++i) {
+    size_t dram_region = dram_region_for(phys_addr + i * g_dram_stripe_size);
+    if (!read_enclave_region_bitmap_bit(enclave_id, dram_region))
+      return false;
+  }
+  return true;
+}
+
+// Locks the DRAM regions holding an aligned range of OS memory.
+//
+// `held_region` is a region that the caller already locked and checked, or
+// g_dram_region_count if there is no such region. It is skipped.
+//
+// Returns a monitor API call error code. If the code is not monitor_ok, no new
+// lock is held.
+inline api_result_t lock_os_dram_range(uintptr_t os_addr, size_t size,
+    size_t held_region) {
+  const size_t stripes = dram_stripes_for_range(size);
+  for (size_t i = 0; i < stripes; ++i) {
+    size_t dram_region = dram_region_for(os_addr + i * g_dram_stripe_size);
+    if (dram_region == held_region)
+      continue;
+
+    api_result_t result = monitor_ok;
+    if (test_and_set_dram_region_lock(dram_region)) {
+      result = monitor_concurrent_call;
+    } else if (read_dram_region_owner(dram_region) != null_enclave_id) {
+      clear_dram_region_lock(dram_region);
+      result = monitor_access_denied;
+    }
+    if (result != monitor_ok) {
+      for (size_t j = 0; j < i; ++j) {
+        size_t locked_region =
+            dram_region_for(os_addr + j * g_dram_stripe_size);
+        if (locked_region != held_region)
+          clear_dram_region_lock(locked_region);
+      }
+      return result;
+    }
+  }
+  return monitor_ok;
+}
+
+// Releases the locks acquired by lock_os_dram_range().
+inline void unlock_os_dram_range(uintptr_t os_addr, size_t size,
+    size_t held_region) {
+  const size_t stripes = dram_stripes_for_range(size);
+  for (size_t i = 0; i < stripes; ++i) {
+    size_t dram_region = dram_region_for(os_addr + i * g_dram_stripe_size);
+    if (dram_region != held_region)
+      clear_dram_region_lock(dram_region);
+  }
+}
+
+// Validates a page load and finds the page table entry that will map the page.
+//
+// This performs the checks in load_page() that don't involve the OS page's
+// DRAM regions. The caller must hold the enclave's lock.
+//
+// Returns a monitor API call error code. On success, `entry_addr` is set to
+// the physical address of the page table entry at `level` for `virtual_addr`.
+inline api_result_t check_page_load(enclave_id_t enclave_id,
+    phys_ptr<enclave_info_t> enclave_info, uintptr_t phys_addr,
+    uintptr_t virtual_addr, uintptr_t os_addr, uintptr_t acl, size_t level,
+    uintptr_t& entry_addr) {
+  if (level >= page_table_levels())
+    return monitor_invalid_value;
+  const size_t size = page_table_entry_span(level);
+  if (!is_dram_address(phys_addr) || !is_dram_address(os_addr))
+    return monitor_invalid_value;
+  if (!is_dram_address(phys_addr + (size - 1)) ||
+      !is_dram_address(os_addr + (size - 1))) {
+    return monitor_invalid_value;
+  }
+  if (!is_page_aligned(phys_addr) || !is_page_aligned(os_addr))
+    return monitor_invalid_value;
+  if (level != 0) {
+    // NOTE: superpages must be naturally aligned, and an entry without the
+    //       leaf bits would be read as a pointer to a page table
+    if (((phys_addr | os_addr | virtual_addr) & (size - 1)) != 0)
+      return monitor_invalid_value;
+    if ((acl & page_table_leaf_acl_mask()) == 0)
+      return monitor_invalid_value;
+  }
+  if (phys_addr <= enclave_info->*(&enclave_info_t::last_load_addr))
+    return monitor_invalid_value;
+  if (!is_enclave_virtual_address(virtual_addr, enclave_id) ||
+      !is_enclave_virtual_address(virtual_addr + (size - 1), enclave_id)) {
+    return monitor_invalid_value;
+  }
+
+  // NOTE: We don't need to lock phys_addr's DRAM regions, because an enclave
+  //       cannot relinquish its DRAM regions until it is initialized and
+  //       running. Once the region's bit is set in the enclave's region
+  //       bitmap, the region stays with the enclave until initialization
+  //       completes.
+  if (!is_enclave_dram_range(enclave_id, phys_addr, size))
+    return monitor_invalid_value;
+
+  if (level == 0) {
+    entry_addr = walk_load_page_tables(enclave_info, virtual_addr);
+  } else {
+    entry_addr = walk_page_tables_to_entry(
+        enclave_info->*(&enclave_info_t::load_eptbr), virtual_addr, level);
+  }
+  if (entry_addr == 0 || is_valid_page_table_entry(entry_addr, level))
+    return monitor_invalid_state;
+  return monitor_ok;
+}
+
+// Maps a page validated by check_page_load() and loads its contents.
+//
+// The caller must hold the enclave's lock and the locks of the DRAM regions
+// holding the OS page, and must have checked that the OS owns those regions.
+inline void load_checked_page(phys_ptr<enclave_info_t> enclave_info,
+    uintptr_t entry_addr, uintptr_t phys_addr, uintptr_t virtual_addr,
+    uintptr_t os_addr, uintptr_t acl, size_t level) {
+  // NOTE: the walk cursor does not need to be invalidated, because the entry
+  //       was invalid, so it can't be on the path to the cached table
+  write_page_table_entry(entry_addr, level, phys_addr, acl);
+
+  // NOTE: last_load_addr points to the last allocated physical page, so
+  //       we have to subtract a page from the superpage's end address.
+  enclave_info->*(&enclave_info_t::last_load_addr) =
+      phys_addr + page_table_entry_span(level) - page_size();
+
+  // NOTE: The page is copied while it is measured, so the OS page is only
+  //       read once.
+  copy_and_extend_enclave_hash_with_page(enclave_info, virtual_addr, acl,
+      phys_addr, os_addr, level);
+}
+
+// The number of DRAM regions owned by an enclave.
+inline size_t enclave_dram_region_count(enclave_id_t enclave_id) {
+  return count_set_bitmap_bits(enclave_region_bitmap(enclave_id),
+      g_dram_region_count);
+}
+
+// Pairs a clone's DRAM regions with its template's DRAM regions.
+//
+// The regions are paired in increasing order of region indices, and each
+// template region's pair is stored in its clone_region field. The caller must
+// hold both enclaves' locks, and must have checked that the enclaves own the
+// same number of DRAM regions.
+inline void pair_cloned_dram_regions(enclave_id_t template_id,
+    enclave_id_t enclave_id) {
+  phys_ptr<size_t> enclave_bitmap = enclave_region_bitmap(enclave_id);
+  size_t enclave_region =
+      find_next_set_bit(enclave_bitmap, g_dram_region_count, 0);
+  for_each_set_bit(enclave_region_bitmap(template_id), g_dram_region_count,
+      [&](size_t i) {
+    dram_region_info_for(i)->*(&dram_region_info_t::clone_region) =
+        enclave_region;
+    enclave_region = find_next_set_bit(enclave_bitmap, g_dram_region_count,
+        enclave_region + 1);
+  });
+}
+
+// The address in a clone that corresponds to an address in its template.
+//
+// The regions must have been paired by pair_cloned_dram_regions(). Returns 0
+// if the address is not in one of the template's DRAM regions.
+inline uintptr_t cloned_address(enclave_id_t template_id,
+    uintptr_t phys_addr) {
+  if (!is_dram_address(phys_addr))
+    return 0;
+  const size_t dram_region = dram_region_for(phys_addr);
+  if (!read_enclave_region_bitmap_bit(template_id, dram_region))
+    return 0;
+  const size_t clone_region =
+      dram_region_info_for(dram_region)->*(&dram_region_info_t::clone_region);
+  return (phys_addr & ~g_dram_region_mask) | dram_region_start(clone_region);
+}
+
+// Copies a template's page table, and the memory it maps, into its clone.
+//
+// `table_addr` is the table's address in the template. The table is copied to
+// the matching address in the clone, and the copy's entries are pointed to the
+// clone's DRAM regions. The pages and page tables that the entries point to are
+// cloned recursively. The recursion depth is bounded by page_table_levels().
+//
+// Only the memory reachable from the template's page tables is copied. This
+// covers every page and page table loaded into the template, so the clone
+// still matches the template's measurement. The copies bypass the caches,
+// because the clone's memory is not read again until the clone runs.
+//
+// Entries that do not point into the template's DRAM regions are invalidated.
+// This never happens for page tables built by the load_ API calls.
+//
+// Returns false if the table, or a superpage that it maps, spans more than one
+// DRAM stripe. Such a range covers several of the template's DRAM regions, and
+// the matching clone regions are not necessarily adjacent.
+bool clone_page_table(enclave_id_t template_id, uintptr_t table_addr,
+    size_t level) {
+  const uintptr_t table_end = table_addr + page_table_size(level);
+  if (dram_stripe_for(table_addr) != dram_stripe_for(table_end - 1))
+    return false;
+  const uintptr_t clone_table_addr = cloned_address(template_id, table_addr);
+  bcopy(phys_ptr<size_t>{clone_table_addr}, phys_ptr<size_t>{table_addr},
+      page_table_size(level), cache_bypass);
+
+  const size_t entry_size = page_table_entry_size(level);
+  const uintptr_t clone_table_end = clone_table_addr + page_table_size(level);
+  for (uintptr_t entry_addr = clone_table_addr; entry_addr < clone_table_end;
+       entry_addr += entry_size) {
+    if (!is_valid_page_table_entry(entry_addr, level))
+      continue;
+
+    const bool is_leaf = is_leaf_page_table_entry(entry_addr, level);
+    const size_t span = page_table_entry_span(level);
+    if (is_leaf && dram_stripes_for_range(span) != 1)
+      return false;
+
+    const uintptr_t template_target =
+        page_table_entry_target(entry_addr, level);
+    const uintptr_t target = cloned_address(template_id, template_target);
+    if (target == 0) {
+      *(phys_ptr<uintptr_t>{entry_addr}) = 0;
+      continue;
+    }
+    write_page_table_entry(entry_addr, level, target,
+        page_table_entry_acl(entry_addr, level));
+
+    if (is_leaf) {
+      bcopy(phys_ptr<size_t>{target}, phys_ptr<size_t>{template_target}, span,
+          cache_bypass);
+    } else if (!clone_page_table(template_id, template_target, level - 1)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+};  // anonymous namespace
 
 api_result_t load_page_table(enclave_id_t enclave_id,
     uintptr_t phys_addr, uintptr_t virtual_addr, size_t level, size_t acl) {
@@ -67,35 +343,27 @@ api_result_t load_page_table(enclave_id_t enclave_id,
   //       any unnecessary checking on measured arguments
   if (level >= page_table_levels())
     return monitor_invalid_value;
-
-  size_t dram_region = clamped_dram_region_for(enclave_id);
-  if (test_and_set_dram_region_lock(dram_region))
-    return monitor_concurrent_call;
-
-  // NOTE: null_enclave_id is accepted by is_valid_enclave_id, but does not
-  //       have a useful meaning here
-  if (enclave_id == null_enclave_id || !is_valid_enclave_id(enclave_id)) {
-    clear_dram_region_lock(dram_region);
+  // NOTE: an entry with leaf bits would map a superpage, instead of pointing
+  //       to the new page table
+  if ((acl & page_table_leaf_acl_mask()) != 0)
     return monitor_invalid_value;
-  }
+
+  api_result_t result = lock_enclave(enclave_id);
+  if (result != monitor_ok)
+    return result;
 
   phys_ptr<enclave_info_t> enclave_info{enclave_id};
   if (enclave_info->*(&enclave_info_t::is_initialized) != 0) {
-    clear_dram_region_lock(dram_region);
+    unlock_enclave(enclave_id);
     return monitor_invalid_state;
   }
   if (phys_addr <= enclave_info->*(&enclave_info_t::last_load_addr)) {
-    clear_dram_region_lock(dram_region);
+    unlock_enclave(enclave_id);
     return monitor_invalid_value;
   }
   if (level != page_table_levels() - 1 &&
       !is_enclave_virtual_address(virtual_addr, enclave_id)) {
-    clear_dram_region_lock(dram_region);
-    return monitor_invalid_value;
-  }
-  /*
-  if (is_enclave_metadata_address(phys_addr, enclave_id)) {
-    clear_dram_region_lock(dram_region);
+    unlock_enclave(enclave_id);
     return monitor_invalid_value;
   }
 
@@ -104,14 +372,13 @@ api_result_t load_page_table(enclave_id_t enclave_id,
   //       initialized and running. Therefore, once the DRAM region is assigned
   //       and its bit is set in the enclave's region bitmap, we know the DRAM
   //       region will stay with the enclave until initialization completes.
-  phys_ptr<size_t> region_bitmap = enclave_region_bitmap(enclave_id);
   size_t table_size = page_table_size(level);
   size_t phys_end = phys_addr + table_size;
   for (size_t table_page_addr = phys_addr; table_page_addr < phys_end;
        table_page_addr += page_size()) {
     size_t table_dram_region = dram_region_for(table_page_addr);
-    if (!read_bitmap_bit(region_bitmap, table_dram_region)) {
-      clear_dram_region_lock(dram_region);
+    if (!read_enclave_region_bitmap_bit(enclave_id, table_dram_region)) {
+      unlock_enclave(enclave_id);
       return monitor_invalid_value;
     }
   }
@@ -128,11 +395,12 @@ api_result_t load_page_table(enclave_id_t enclave_id,
     uintptr_t entry_addr = walk_page_tables_to_entry(ptb, virtual_addr,
         edit_level);
     if (entry_addr == 0 || is_valid_page_table_entry(entry_addr, edit_level)) {
-      clear_dram_region_lock(dram_region);
+      unlock_enclave(enclave_id);
       return monitor_invalid_state;
     }
     write_page_table_entry(entry_addr, edit_level, phys_addr, acl);
   }
+  invalidate_walk_cursor(enclave_info);
 
   // NOTE: last_load_addr points to the last allocated physical page, so
   //       we have to subtract a page from the page table's end address.
@@ -140,95 +408,327 @@ api_result_t load_page_table(enclave_id_t enclave_id,
   bzero(phys_ptr<size_t>{phys_addr}, table_size);
 
   extend_enclave_hash_with_page_table(enclave_info, virtual_addr, level, acl);
-  */
 
-  clear_dram_region_lock(dram_region);
+  unlock_enclave(enclave_id);
   return monitor_ok;
 }
 
 api_result_t load_page(enclave_id_t enclave_id, uintptr_t phys_addr,
-    uintptr_t virtual_addr, uintptr_t os_addr, uintptr_t acl) {
-  if (!is_dram_address(phys_addr) || !is_dram_address(os_addr))
+    uintptr_t virtual_addr, uintptr_t os_addr, uintptr_t acl, size_t level) {
+  api_result_t result = lock_enclave(enclave_id);
+  if (result != monitor_ok)
+    return result;
+
+  phys_ptr<enclave_info_t> enclave_info{enclave_id};
+  if (enclave_info->*(&enclave_info_t::is_initialized) != 0) {
+    unlock_enclave(enclave_id);
+    return monitor_invalid_state;
+  }
+
+  uintptr_t entry_addr;
+  result = check_page_load(enclave_id, enclave_info, phys_addr, virtual_addr,
+      os_addr, acl, level, entry_addr);
+  if (result != monitor_ok) {
+    unlock_enclave(enclave_id);
+    return result;
+  }
+
+  // NOTE: We're performing the OS DRAM region checks last to minimize the
+  //       number of times we have two release two locks when bailing out due
+  //       to errors.
+
+  // NOTE: Even though we're reading the DRAM region ownership atomically, we
+  //       still need to lock the regions to make sure that they don't go away
+  //       while we copy a page out of them.
+  const size_t size = page_table_entry_span(level);
+  result = lock_os_dram_range(os_addr, size, g_dram_region_count);
+  if (result != monitor_ok) {
+    unlock_enclave(enclave_id);
+    return result;
+  }
+
+  load_checked_page(enclave_info, entry_addr, phys_addr, virtual_addr,
+      os_addr, acl, level);
+
+  unlock_os_dram_range(os_addr, size, g_dram_region_count);
+  unlock_enclave(enclave_id);
+  return monitor_ok;
+}
+
+api_result_t load_pages(enclave_id_t enclave_id, uintptr_t descriptors_addr,
+    size_t count) {
+  if (!is_dram_address(descriptors_addr))
     return monitor_invalid_value;
-  if (!is_page_aligned(phys_addr) || !is_page_aligned(os_addr))
+  if ((descriptors_addr & (sizeof(uintptr_t) - 1)) != 0)
+    return monitor_invalid_value;
+  // NOTE: checking the count separately avoids overflows in the page check
+  if (count > page_size() / sizeof(page_load_descriptor_t))
+    return monitor_invalid_value;
+  if ((descriptors_addr & (page_size() - 1)) +
+      count * sizeof(page_load_descriptor_t) > page_size()) {
     return monitor_invalid_value;
+  }
 
-  size_t dram_region = clamped_dram_region_for(enclave_id);
-  if (test_and_set_dram_region_lock(dram_region))
+  api_result_t result = lock_enclave(enclave_id);
+  if (result != monitor_ok)
+    return result;
+
+  phys_ptr<enclave_info_t> enclave_info{enclave_id};
+  if (enclave_info->*(&enclave_info_t::is_initialized) != 0) {
+    unlock_enclave(enclave_id);
+    return monitor_invalid_state;
+  }
+
+  // The descriptors' DRAM region stays locked for the whole call. The OS pages
+  // usually come from a few contiguous buffers, so the lock on the current OS
+  // page's DRAM region is kept until a page comes from a different region.
+  size_t descriptors_dram_region = dram_region_for(descriptors_addr);
+  if (test_and_set_dram_region_lock(descriptors_dram_region)) {
+    unlock_enclave(enclave_id);
     return monitor_concurrent_call;
+  }
+  if (read_dram_region_owner(descriptors_dram_region) != null_enclave_id) {
+    clear_dram_region_lock(descriptors_dram_region);
+    unlock_enclave(enclave_id);
+    return monitor_access_denied;
+  }
+  size_t os_dram_region = descriptors_dram_region;
 
-  // NOTE: null_enclave_id is accepted by is_valid_enclave_id, but does not
-  //       have a useful meaning here
-  if (enclave_id == null_enclave_id || !is_valid_enclave_id(enclave_id)) {
-    clear_dram_region_lock(dram_region);
-    return monitor_invalid_value;
+  phys_ptr<page_load_descriptor_t> descriptors{descriptors_addr};
+  for (size_t i = 0; i < count; ++i) {
+    // NOTE: the OS can change the descriptors while we're using them, so each
+    //       field is read exactly once
+    phys_ptr<page_load_descriptor_t> descriptor = descriptors + i;
+    const uintptr_t phys_addr =
+        descriptor->*(&page_load_descriptor_t::phys_addr);
+    const uintptr_t virtual_addr =
+        descriptor->*(&page_load_descriptor_t::virtual_addr);
+    const uintptr_t os_addr = descriptor->*(&page_load_descriptor_t::os_addr);
+    const uintptr_t acl = descriptor->*(&page_load_descriptor_t::acl);
+    const size_t level = descriptor->*(&page_load_descriptor_t::level);
+
+    uintptr_t entry_addr;
+    result = check_page_load(enclave_id, enclave_info, phys_addr,
+        virtual_addr, os_addr, acl, level, entry_addr);
+    if (result != monitor_ok)
+      break;
+
+    const size_t size = page_table_entry_span(level);
+    if (dram_stripes_for_range(size) != 1) {
+      // Superpages that span several DRAM regions lock them all, for the
+      // duration of the copy.
+      if (os_dram_region != descriptors_dram_region)
+        clear_dram_region_lock(os_dram_region);
+      os_dram_region = descriptors_dram_region;
+
+      result = lock_os_dram_range(os_addr, size, descriptors_dram_region);
+      if (result != monitor_ok)
+        break;
+      load_checked_page(enclave_info, entry_addr, phys_addr, virtual_addr,
+          os_addr, acl, level);
+      unlock_os_dram_range(os_addr, size, descriptors_dram_region);
+      continue;
+    }
+
+    size_t page_os_dram_region = dram_region_for(os_addr);
+    if (page_os_dram_region != os_dram_region) {
+      if (os_dram_region != descriptors_dram_region)
+        clear_dram_region_lock(os_dram_region);
+      os_dram_region = descriptors_dram_region;
+
+      // NOTE: the descriptors' region is already locked and checked
+      if (page_os_dram_region != descriptors_dram_region) {
+        if (test_and_set_dram_region_lock(page_os_dram_region)) {
+          result = monitor_concurrent_call;
+          break;
+        }
+        os_dram_region = page_os_dram_region;
+        if (read_dram_region_owner(os_dram_region) != null_enclave_id) {
+          result = monitor_access_denied;
+          break;
+        }
+      }
+    }
+
+    load_checked_page(enclave_info, entry_addr, phys_addr, virtual_addr,
+        os_addr, acl, level);
   }
 
+  if (os_dram_region != descriptors_dram_region)
+    clear_dram_region_lock(os_dram_region);
+  clear_dram_region_lock(descriptors_dram_region);
+  unlock_enclave(enclave_id);
+  return result;
+}
+
+api_result_t load_zero_pages(enclave_id_t enclave_id, uintptr_t phys_addr,
+    uintptr_t virtual_addr, size_t page_count, uintptr_t acl) {
+  if (!is_dram_address(phys_addr) || !is_page_aligned(phys_addr))
+    return monitor_invalid_value;
+  // NOTE: checking the count against the DRAM size avoids overflows below
+  if (page_count == 0 || page_count > (g_dram_size >> page_shift()))
+    return monitor_invalid_value;
+  const size_t size = page_count << page_shift();
+  if (!is_dram_address(phys_addr + (size - 1)))
+    return monitor_invalid_value;
+
+  api_result_t result = lock_enclave(enclave_id);
+  if (result != monitor_ok)
+    return result;
+
   phys_ptr<enclave_info_t> enclave_info{enclave_id};
   if (enclave_info->*(&enclave_info_t::is_initialized) != 0) {
-    clear_dram_region_lock(dram_region);
+    unlock_enclave(enclave_id);
     return monitor_invalid_state;
   }
   if (phys_addr <= enclave_info->*(&enclave_info_t::last_load_addr)) {
-    clear_dram_region_lock(dram_region);
+    unlock_enclave(enclave_id);
     return monitor_invalid_value;
   }
-  if (!is_enclave_virtual_address(virtual_addr, enclave_id)) {
-    clear_dram_region_lock(dram_region);
+  if (virtual_addr + (size - 1) < virtual_addr ||
+      !is_enclave_virtual_address(virtual_addr, enclave_id) ||
+      !is_enclave_virtual_address(virtual_addr + (size - 1), enclave_id)) {
+    unlock_enclave(enclave_id);
     return monitor_invalid_value;
   }
-  /*
-  if (is_enclave_metadata_address(phys_addr, enclave_id)) {
-    clear_dram_region_lock(dram_region);
+
+  // All the pages are checked before any of them is mapped, so the call has
+  // no effect if it fails.
+  //
+  // NOTE: See load_page for the explanation why we don't need to lock the
+  //       DRAM regions of the pages.
+  size_t checked_dram_region = g_dram_region_count;
+  for (size_t offset = 0; offset < size; offset += page_size()) {
+    size_t page_dram_region = dram_region_for(phys_addr + offset);
+    if (page_dram_region != checked_dram_region) {
+      if (!read_enclave_region_bitmap_bit(enclave_id, page_dram_region)) {
+        unlock_enclave(enclave_id);
+        return monitor_invalid_value;
+      }
+      checked_dram_region = page_dram_region;
+    }
+
+    uintptr_t entry_addr = walk_load_page_tables(enclave_info,
+        virtual_addr + offset);
+    if (entry_addr == 0 || is_valid_page_table_entry(entry_addr, 0)) {
+      unlock_enclave(enclave_id);
+      return monitor_invalid_state;
+    }
+  }
+
+  for (size_t offset = 0; offset < size; offset += page_size()) {
+    uintptr_t entry_addr = walk_load_page_tables(enclave_info,
+        virtual_addr + offset);
+    write_page_table_entry(entry_addr, 0, phys_addr + offset, acl);
+  }
+  enclave_info->*(&enclave_info_t::last_load_addr) =
+      phys_addr + size - page_size();
+  // NOTE: the zero pages are measured without being read, and enclaves
+  //       usually fill them in later, so their lines don't need to be cached
+  bzero(phys_ptr<size_t>{phys_addr}, size, cache_bypass);
+
+  extend_enclave_hash_with_zero_pages(enclave_info, virtual_addr, page_count,
+      acl);
+
+  unlock_enclave(enclave_id);
+  return monitor_ok;
+}
+
+api_result_t clone_enclave(enclave_id_t template_id,
+    enclave_id_t enclave_id) {
+  if (template_id == enclave_id)
     return monitor_invalid_value;
+
+  api_result_t result = lock_enclave(template_id);
+  if (result != monitor_ok)
+    return result;
+  result = lock_enclave(enclave_id);
+  if (result != monitor_ok) {
+    unlock_enclave(template_id);
+    return result;
   }
 
-  // NOTE: See load_page_table for the explanation why we don't need to
-  //       lock phys_addr's DRAM region.
-  size_t page_dram_region = dram_region_for(phys_addr);
-  if (!read_bitmap_bit(enclave_region_bitmap(enclave_id), page_dram_region)) {
-    clear_dram_region_lock(dram_region);
+  phys_ptr<enclave_info_t> template_info{template_id};
+  phys_ptr<enclave_info_t> enclave_info{enclave_id};
+  if (template_info->*(&enclave_info_t::is_initialized) != 0 ||
+      template_info->*(&enclave_info_t::thread_count) != 0 ||
+      enclave_info->*(&enclave_info_t::is_initialized) != 0 ||
+      enclave_info->*(&enclave_info_t::thread_count) != 0 ||
+      enclave_info->*(&enclave_info_t::load_eptbr) != 0 ||
+      enclave_info->*(&enclave_info_t::last_load_addr) != 0) {
+    unlock_enclave(enclave_id);
+    unlock_enclave(template_id);
+    return monitor_invalid_state;
+  }
+
+  // NOTE: these arguments are measured, so the clone would not match its
+  //       measurement if they differed
+  if (template_info->*(&enclave_info_t::ev_base) !=
+          enclave_info->*(&enclave_info_t::ev_base) ||
+      template_info->*(&enclave_info_t::ev_mask) !=
+          enclave_info->*(&enclave_info_t::ev_mask) ||
+      template_info->*(&enclave_info_t::mailbox_count) !=
+          enclave_info->*(&enclave_info_t::mailbox_count) ||
+      template_info->*(&enclave_info_t::is_debug) !=
+          enclave_info->*(&enclave_info_t::is_debug) ||
+      template_info->*(&enclave_info_t::measurement_mode) !=
+          enclave_info->*(&enclave_info_t::measurement_mode)) {
+    unlock_enclave(enclave_id);
+    unlock_enclave(template_id);
     return monitor_invalid_value;
   }
 
-  uintptr_t ptb = enclave_info->*(&enclave_info_t::load_eptbr);
-  uintptr_t entry_addr = walk_page_tables_to_entry(ptb, virtual_addr, 0);
-  if (entry_addr == 0 || is_valid_page_table_entry(entry_addr, 0)) {
-    clear_dram_region_lock(dram_region);
+  // NOTE: We don't need to lock the DRAM regions, because neither enclave is
+  //       initialized, so neither can relinquish its DRAM regions. The OS can
+  //       still assign new regions to the enclaves, which would change the
+  //       pairing between the regions, so the regions are counted again after
+  //       the copy. The counts only grow, so equal counts mean that nothing
+  //       changed.
+  const size_t template_region_count = enclave_dram_region_count(template_id);
+  if (template_region_count != enclave_dram_region_count(enclave_id)) {
+    unlock_enclave(enclave_id);
+    unlock_enclave(template_id);
     return monitor_invalid_state;
   }
 
-  // NOTE: We're performing the OS DRAM region checks last to minimize the
-  //       number of times we have two release two locks when bailing out due
-  //       to errors.
+  pair_cloned_dram_regions(template_id, enclave_id);
 
-  // NOTE: We don't need to check if os_dram_region is the same as dram_region.
-  //       If that's the case, we'll simply fail to acquire the lock and return
-  //       concurrent_call. This is acceptable. Ideally, we'd return
-  //       invalid_value, but that'd increase code size.
-  size_t os_dram_region = dram_region_for(os_addr);
-  if (test_and_set_dram_region_lock(os_dram_region)) {
-    clear_dram_region_lock(dram_region);
-    return monitor_concurrent_call;
+  // NOTE: If cloning fails, the clone's regions hold a partial copy, but the
+  //       clone's load_eptbr and last_load_addr are not set, so the copy is
+  //       not mapped, and the clone can still be loaded from scratch.
+  const uintptr_t template_eptbr =
+      template_info->*(&enclave_info_t::load_eptbr);
+  uintptr_t eptbr = 0;
+  if (template_eptbr != 0) {
+    eptbr = cloned_address(template_id, template_eptbr);
+    if (!clone_page_table(template_id, template_eptbr,
+        page_table_levels() - 1)) {
+      unlock_enclave(enclave_id);
+      unlock_enclave(template_id);
+      return monitor_invalid_state;
+    }
   }
 
-  // NOTE: Even though we're reading the DRAM region ownership atomically, we
-  //       still need to lock the region to make sure that it doesn't go away
-  //       while we bcopy a page out of it.
-  phys_ptr<dram_region_info_t> region = &g_dram_region[os_dram_region];
-  if (read_dram_region_owner(dram_region) != null_enclave_id) {
-    clear_dram_region_lock(os_dram_region);
-    clear_dram_region_lock(dram_region);
-    return monitor_access_denied;
+  if (template_region_count != enclave_dram_region_count(template_id) ||
+      template_region_count != enclave_dram_region_count(enclave_id)) {
+    unlock_enclave(enclave_id);
+    unlock_enclave(template_id);
+    return monitor_concurrent_call;
   }
 
-  enclave_info->*(&enclave_info_t::last_load_addr) = phys_addr;
-  bcopy(phys_ptr<size_t>{phys_addr}, phys_ptr<size_t>{os_addr}, page_size());
-  clear_dram_region_lock(os_dram_region);
+  // NOTE: The pairing preserves the order of physical addresses, so the
+  //       relocated last_load_addr still bounds all the loaded pages.
+  const uintptr_t template_last_load_addr =
+      template_info->*(&enclave_info_t::last_load_addr);
+  enclave_info->*(&enclave_info_t::load_eptbr) = eptbr;
+  enclave_info->*(&enclave_info_t::last_load_addr) =
+      (template_last_load_addr == 0) ? 0 :
+      cloned_address(template_id, template_last_load_addr);
+  invalidate_walk_cursor(enclave_info);
+  copy_enclave_hash(enclave_info, template_info);
 
-  extend_enclave_hash_with_page(enclave_info, virtual_addr, acl, phys_addr);
-  */
-  clear_dram_region_lock(dram_region);
+  unlock_enclave(enclave_id);
+  unlock_enclave(template_id);
   return monitor_ok;
 }
 
@@ -0,0 +1,190 @@
+#include "boot_init.h"
+#include "cpu_core_inl.h"
+#include "dram_regions_inl.h"
+#include "enclave_inl.h"
+#include "metadata_inl.h"
+#include "public/api.h"
+
+#include "gtest/gtest.h"
+
+using sanctum::api::block_dram_region;
+using sanctum::api::enclave_id_t;
+using sanctum::api::monitor_ok;
+using sanctum::api::os::clone_enclave;
+using sanctum::api::os::create_enclave;
+using sanctum::api::os::create_metadata_region;
+using sanctum::api::os::free_dram_region;
+using sanctum::api::os::load_page;
+using sanctum::api::os::load_page_table;
+using sanctum::api::os::load_pages;
+using sanctum::api::os::measurement_serial;
+using sanctum::api::os::page_load_descriptor_t;
+using sanctum::bare::page_size;
+using sanctum::bare::phys_ptr;
+using sanctum::internal::boot_init_dram_regions;
+using sanctum::internal::boot_init_dynamic_arrays;
+using sanctum::internal::boot_init_metadata;
+using sanctum::internal::boot_init_monitor_top;
+using sanctum::internal::boot_init_protection;
+using sanctum::internal::clear_dram_region_lock;
+using sanctum::internal::core_info_for;
+using sanctum::internal::core_info_t;
+using sanctum::internal::dram_region_tlb_flush;
+using sanctum::internal::g_monitor_top;
+using sanctum::internal::set_enclave_region_bitmap_bit;
+using sanctum::internal::test_and_set_dram_region_lock;
+using sanctum::internal::walk_page_tables;
+using sanctum::internal::write_dram_region_owner;
+using sanctum::testing::phys_buffer;
+
+namespace {
+
+// Sets up the test rig with the toy memory parameters from the Sanctum paper.
+//
+// The DRAM regions are 32kb, and each region is contiguous.
+void set_up_paper_memory_model() {
+  sanctum::testing::dram_size = 1 << 18;
+  sanctum::testing::cache_levels = 3;
+
+  sanctum::testing::is_shared_cache[0] = false;
+  sanctum::testing::is_shared_cache[1] = false;
+  sanctum::testing::is_shared_cache[2] = true;
+
+  sanctum::testing::cache_line_size[0] = 1 << 6;  // irrelevant to tests
+  sanctum::testing::cache_line_size[1] = 1 << 6;  // irrelevant to tests
+  sanctum::testing::cache_line_size[2] = 1 << 6;  // must be a power of 2
+
+  sanctum::testing::cache_set_count[0] = 1 << 6;  // irrelevant to tests
+  sanctum::testing::cache_set_count[1] = 1 << 8;  // irrelevant to tests
+  sanctum::testing::cache_set_count[2] = 1 << 9;  // must be a power of 2
+
+  sanctum::testing::min_cache_index_shift = 0;
+  sanctum::testing::max_cache_index_shift = 16;
+
+  sanctum::testing::set_core_count(4);
+}
+
+// Takes a DRAM region away from the OS, and frees it.
+void free_os_dram_region(size_t dram_region) {
+  ASSERT_EQ(monitor_ok, block_dram_region(dram_region));
+  for (size_t i = 0; i < 4; ++i) {
+    sanctum::testing::set_current_core(i);
+    dram_region_tlb_flush();
+  }
+  sanctum::testing::set_current_core(0);
+  ASSERT_EQ(monitor_ok, free_dram_region(dram_region));
+}
+
+// Takes a DRAM region away from the OS, and gives it to an enclave.
+//
+// NOTE: assign_dram_region() uses is_valid_enclave_id(), which doesn't accept
+//       enclaves yet, so the region is assigned directly
+void assign_enclave_dram_region(size_t dram_region, enclave_id_t enclave_id) {
+  free_os_dram_region(dram_region);
+  write_dram_region_owner(dram_region, enclave_id);
+  set_enclave_region_bitmap_bit(enclave_id, dram_region, true);
+}
+
+// DRAM region 1 holds the enclaves' metadata, and the enclave owns regions 3
+// and 4. Regions 0 and 2 stay with the OS.
+constexpr enclave_id_t enclave_id = 0x9000;
+constexpr uintptr_t enclave_region_start = 0x18000;
+
+}  // anonymous namespace
+
+class EnclaveInitTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    set_up_paper_memory_model();
+    boot_init_monitor_top();
+    boot_init_dram_regions();
+    boot_init_metadata();
+    boot_init_dynamic_arrays();
+    boot_init_protection();
+    ASSERT_LE(g_monitor_top, 0x6000);
+
+    for (size_t i = 0; i < 4; ++i)
+      core_info_for(i)->*(&core_info_t::enclave_id) = 0;
+    sanctum::testing::set_current_core(0);
+
+    // NOTE: create_enclave() doesn't clear the enclaves' DRAM region bitmaps,
+    //       so the metadata region is zeroed, like a scrubbed region
+    free_os_dram_region(1);
+    memset(phys_buffer + 0x8000, 0, 0x8000);
+    ASSERT_EQ(monitor_ok, create_metadata_region(1));
+    ASSERT_EQ(monitor_ok, create_enclave(enclave_id, 0, (1 << 30) - 1, 1,
+        false, measurement_serial));
+
+    assign_enclave_dram_region(3, enclave_id);
+    assign_enclave_dram_region(4, enclave_id);
+
+    // The root table fills up region 3, and the other tables start region 4.
+    ASSERT_EQ(monitor_ok, load_page_table(enclave_id, enclave_region_start, 0,
+        2, 0));
+    ASSERT_EQ(monitor_ok, load_page_table(enclave_id,
+        enclave_region_start + 0x8000, 0, 1, 0));
+    ASSERT_EQ(monitor_ok, load_page_table(enclave_id,
+        enclave_region_start + 0xC000, 0, 0, 0));
+  }
+};
+
+TEST_F(EnclaveInitTest, LoadPagesFromSeveralOsRegions) {
+  // The second page is in the descriptors' DRAM region, and comes after a
+  // page from another region.
+  const uintptr_t descriptors_addr = 0x6000;
+  const uintptr_t os_addrs[3] = { 0x11000, 0x7000, 0x12000 };
+  const uintptr_t phys_start = enclave_region_start + 0xD000;
+
+  phys_ptr<page_load_descriptor_t> descriptors{descriptors_addr};
+  for (size_t i = 0; i < 3; ++i) {
+    memset(phys_buffer + os_addrs[i], 'a' + i, page_size());
+
+    phys_ptr<page_load_descriptor_t> descriptor = descriptors + i;
+    descriptor->*(&page_load_descriptor_t::phys_addr) =
+        phys_start + i * page_size();
+    descriptor->*(&page_load_descriptor_t::virtual_addr) = i * page_size();
+    descriptor->*(&page_load_descriptor_t::os_addr) = os_addrs[i];
+    descriptor->*(&page_load_descriptor_t::acl) = 0xE;
+    descriptor->*(&page_load_descriptor_t::level) = 0;
+  }
+
+  ASSERT_EQ(monitor_ok, load_pages(enclave_id, descriptors_addr, 3));
+  for (size_t i = 0; i < 3; ++i) {
+    EXPECT_EQ(0, memcmp(phys_buffer + os_addrs[i],
+        phys_buffer + phys_start + i * page_size(), page_size()));
+  }
+
+  // All the OS regions' locks were released.
+  for (size_t dram_region = 0; dram_region < 3; ++dram_region) {
+    EXPECT_EQ(false, test_and_set_dram_region_lock(dram_region));
+    clear_dram_region_lock(dram_region);
+  }
+}
+
+TEST_F(EnclaveInitTest, CloneEnclaveCopiesLoadedMemory) {
+  // The clone owns regions 5 and 6, which are paired with regions 3 and 4.
+  const enclave_id_t clone_id = 0xC000;
+  const uintptr_t clone_offset = 0x10000;
+  ASSERT_EQ(monitor_ok, create_enclave(clone_id, 0, (1 << 30) - 1, 1, false,
+      measurement_serial));
+  assign_enclave_dram_region(5, clone_id);
+  assign_enclave_dram_region(6, clone_id);
+  memset(phys_buffer + enclave_region_start + clone_offset, 0, 0x10000);
+
+  const uintptr_t phys_addr = enclave_region_start + 0xD000;
+  const uintptr_t os_addr = 0x11000;
+  memset(phys_buffer + os_addr, 'a', page_size());
+  ASSERT_EQ(monitor_ok, load_page(enclave_id, phys_addr, 0, os_addr, 0xE, 0));
+  // The page after the loaded page holds data that was never loaded.
+  memset(phys_buffer + phys_addr + page_size(), 'x', page_size());
+
+  ASSERT_EQ(monitor_ok, clone_enclave(enclave_id, clone_id));
+  EXPECT_EQ(phys_addr + clone_offset, walk_page_tables(
+      enclave_region_start + clone_offset, 0));
+  EXPECT_EQ(0, memcmp(phys_buffer + os_addr,
+      phys_buffer + phys_addr + clone_offset, page_size()));
+  for (size_t i = 0; i < page_size(); ++i) {
+    ASSERT_EQ(0, phys_buffer[phys_addr + clone_offset + page_size() + i])
+        << i;
+  }
+}
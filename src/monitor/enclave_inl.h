@@ -12,12 +12,14 @@
 namespace sanctum {
 namespace internal {
 
+using sanctum::bare::is_leaf_page_table_entry;
 using sanctum::bare::is_valid_page_table_entry;
 using sanctum::bare::page_size;
 using sanctum::bare::page_shift;
 using sanctum::bare::page_table_levels;
 using sanctum::bare::page_table_shift;
 using sanctum::bare::page_table_entry_shift;
+using sanctum::bare::page_table_entry_span;
 using sanctum::bare::page_table_entry_target;
 using sanctum::bare::page_table_translated_bits;
 using sanctum::bare::pages_needed_for;
@@ -30,7 +32,9 @@ using sanctum::bare::uintptr_t;
 inline bool is_enclave_virtual_address(uintptr_t virtual_addr,
     enclave_id_t enclave_id) {
   phys_ptr<enclave_info_t> enclave_info{enclave_id};
-  return (virtual_addr & enclave_info->*(&enclave_info_t::ev_mask)) ==
+  // NOTE: the mask's 1s are the bits that vary inside the range, like in
+  //       is_valid_range()
+  return (virtual_addr & ~(enclave_info->*(&enclave_info_t::ev_mask))) ==
       enclave_info->*(&enclave_info_t::ev_base);
 }
 
@@ -42,7 +46,7 @@ inline bool is_enclave_virtual_address(uintptr_t virtual_addr,
 // initialized, when the monitor is in charge of its page tables.
 //
 // Returns 0 if the walk was interrupted due to a page table entry not being
-// valid / present.
+// valid / present, or due to a leaf entry above the given level.
 inline uintptr_t walk_page_tables_to_entry(uintptr_t ptb,
     uintptr_t virtual_addr, size_t level) {
   size_t addr_shift = page_table_translated_bits();
@@ -68,27 +72,85 @@ inline uintptr_t walk_page_tables_to_entry(uintptr_t ptb,
       return entry_addr;
     if (!is_valid_page_table_entry(entry_addr, walk_level))
       break;
+    if (is_leaf_page_table_entry(entry_addr, walk_level))
+      break;
     table_addr = page_table_entry_target(entry_addr, walk_level);
   }
   return 0;
 }
 
+// The log2 of the size of the virtual address range mapped by a level-0 table.
+constexpr inline size_t leaf_page_table_range_shift() {
+  return page_shift() + page_table_shift(0);
+}
+
+// Forgets the level-0 page table cached by walk_load_page_tables().
+//
+// This must be called whenever an entry at level 1 or above in the enclave's
+// loading page tables is written, or when load_eptbr changes.
+inline void invalidate_walk_cursor(phys_ptr<enclave_info_t> enclave_info) {
+  enclave_info->*(&enclave_info_t::walk_cursor_table) = 0;
+}
+
+// Finds the level-0 page table entry for a virtual address in an enclave.
+//
+// This is equivalent to calling walk_page_tables_to_entry() with the
+// enclave's load_eptbr and level 0, but it caches the last level-0 table that
+// it found. Consecutive virtual addresses that are mapped by the same table
+// are resolved without walking the upper levels.
+//
+// The caller must hold the enclave's lock, and the enclave must not be
+// initialized.
+inline uintptr_t walk_load_page_tables(phys_ptr<enclave_info_t> enclave_info,
+    uintptr_t virtual_addr) {
+  constexpr size_t range_shift = leaf_page_table_range_shift();
+  uintptr_t table_addr = enclave_info->*(&enclave_info_t::walk_cursor_table);
+  if (table_addr == 0 || (virtual_addr >> range_shift) !=
+      (enclave_info->*(&enclave_info_t::walk_cursor_base) >> range_shift)) {
+    uintptr_t ptb = enclave_info->*(&enclave_info_t::load_eptbr);
+    uintptr_t entry_addr = walk_page_tables_to_entry(ptb, virtual_addr, 1);
+    if (entry_addr == 0 || !is_valid_page_table_entry(entry_addr, 1) ||
+        is_leaf_page_table_entry(entry_addr, 1)) {
+      return 0;
+    }
+
+    table_addr = page_table_entry_target(entry_addr, 1);
+    enclave_info->*(&enclave_info_t::walk_cursor_table) = table_addr;
+    enclave_info->*(&enclave_info_t::walk_cursor_base) =
+        (virtual_addr >> range_shift) << range_shift;
+  }
+
+  uintptr_t entry_offset = (virtual_addr >> page_shift()) &
+      ((1 << page_table_shift(0)) - 1);
+  return table_addr + (entry_offset << page_table_entry_shift(0));
+}
+
 // Performs a software virtual address translation.
 //
-// The level is assumed to be valid (between 0 and page_table_levels() - 1).
 // The ptb (page table base) and the page tables are all assumed to point to
 // accessible memory. This assumption only holds before an enclave is
 // initialized, when the monitor is in charge of its page tables.
 //
+// Returns the physical address of the page that holds the virtual address.
+// Superpages are translated using the leaf entry at the level where the walk
+// ends.
+//
 // Returns 0 if the walk was interrupted due to a page table entry not being
 // valid / present.
 inline uintptr_t walk_page_tables(uintptr_t ptb, uintptr_t virtual_addr) {
-  uintptr_t entry_addr = walk_page_tables_to_entry(ptb, virtual_addr, 0);
-  if (entry_addr == 0)
-    return 0;
-  if (!is_valid_page_table_entry(entry_addr, 0))
-    return 0;
-  return page_table_entry_target(entry_addr, 0);
+  for (size_t level = page_table_levels(); level > 0; --level) {
+    uintptr_t entry_addr = walk_page_tables_to_entry(ptb, virtual_addr,
+        level - 1);
+    if (entry_addr == 0)
+      return 0;
+    if (!is_valid_page_table_entry(entry_addr, level - 1))
+      return 0;
+    if (is_leaf_page_table_entry(entry_addr, level - 1)) {
+      return page_table_entry_target(entry_addr, level - 1) | (virtual_addr &
+          (page_table_entry_span(level - 1) - page_size()));
+    }
+  }
+  return 0;
 }
 
 // Initializes an enclave's metadata structure.
@@ -96,7 +158,8 @@ inline uintptr_t walk_page_tables(uintptr_t ptb, uintptr_t virtual_addr) {
 // The caller is responsible for validating all input parameters. The caller
 // must also hold the lock for the metadata region of the enclave metadata.
 inline void init_enclave_info(phys_ptr<enclave_info_t> enclave_info,
-    uintptr_t ev_base, uintptr_t ev_mask, size_t mailbox_count, bool debug) {
+    uintptr_t ev_base, uintptr_t ev_mask, size_t mailbox_count, bool debug,
+    size_t measurement_mode) {
   atomic_flag_clear(&(enclave_info->*(&enclave_info_t::lock)));
   enclave_info->*(&enclave_info_t::mailbox_count) = mailbox_count;
   enclave_info->*(&enclave_info_t::is_initialized) = 0;
@@ -105,9 +168,11 @@ inline void init_enclave_info(phys_ptr<enclave_info_t> enclave_info,
   enclave_info->*(&enclave_info_t::ev_mask) = ev_mask;
   enclave_info->*(&enclave_info_t::load_eptbr) = 0;
   enclave_info->*(&enclave_info_t::last_load_addr) = 0;
+  invalidate_walk_cursor(enclave_info);
   enclave_info->*(&enclave_info_t::thread_count) = 0;
   enclave_info->*(&enclave_info_t::dram_region_count) = 0;
-  init_enclave_hash(enclave_info, ev_base, ev_mask, mailbox_count, debug);
+  init_enclave_hash(enclave_info, ev_base, ev_mask, mailbox_count, debug,
+      measurement_mode);
 }
 
 };  // namespace sanctum::internal
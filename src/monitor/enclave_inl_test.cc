@@ -2,3 +2,93 @@
 
 #include "gtest/gtest.h"
 
+using sanctum::bare::phys_ptr;
+using sanctum::bare::write_page_table_entry;
+using sanctum::internal::enclave_info_t;
+using sanctum::internal::invalidate_walk_cursor;
+using sanctum::internal::walk_load_page_tables;
+using sanctum::internal::walk_page_tables;
+using sanctum::internal::walk_page_tables_to_entry;
+using sanctum::testing::phys_buffer;
+using sanctum::testing::phys_buffer_size;
+
+namespace {
+
+constexpr uintptr_t enclave_addr = 0x1000;
+constexpr uintptr_t root_table_addr = 0x8000;  // L2, 32kb
+constexpr uintptr_t mid_table_addr = 0x10000;  // L1, 16kb
+constexpr uintptr_t leaf_table_addr = 0x14000;  // L0, 4kb each
+
+// Builds page tables where the first two L1 entries point to L0 tables.
+phys_ptr<enclave_info_t> set_up_page_tables() {
+  EXPECT_LE(leaf_table_addr + 3 * 0x1000, phys_buffer_size);
+  memset(phys_buffer + root_table_addr, 0,
+      leaf_table_addr + 3 * 0x1000 - root_table_addr);
+
+  write_page_table_entry(root_table_addr, 2, mid_table_addr, 0);
+  write_page_table_entry(mid_table_addr, 1, leaf_table_addr, 0);
+  write_page_table_entry(mid_table_addr + 16, 1, leaf_table_addr + 0x1000, 0);
+
+  phys_ptr<enclave_info_t> enclave_info{enclave_addr};
+  enclave_info->*(&enclave_info_t::load_eptbr) = root_table_addr;
+  invalidate_walk_cursor(enclave_info);
+  return enclave_info;
+}
+
+}  // anonymous namespace
+
+TEST(EnclaveInlTest, WalkLoadPageTablesMatchesWalk) {
+  phys_ptr<enclave_info_t> enclave_info = set_up_page_tables();
+
+  // Consecutive pages, a jump to the next L0 table, a jump back, and an
+  // address that is not mapped by an L0 table.
+  const uintptr_t addrs[] = {
+    0x0, 0x1000, 0x2000, 0x1ff000, 0x200000, 0x3ff000, 0x5000, 0x400000,
+    0x1000,
+  };
+  for (uintptr_t virtual_addr : addrs) {
+    EXPECT_EQ(walk_page_tables_to_entry(root_table_addr, virtual_addr, 0),
+        walk_load_page_tables(enclave_info, virtual_addr)) << virtual_addr;
+  }
+  EXPECT_EQ(leaf_table_addr + 8,
+      walk_load_page_tables(enclave_info, 0x1000));
+  EXPECT_EQ(0, walk_load_page_tables(enclave_info, 0x400000));
+}
+
+TEST(EnclaveInlTest, WalkLoadPageTablesCachesLeafTable) {
+  phys_ptr<enclave_info_t> enclave_info = set_up_page_tables();
+
+  EXPECT_EQ(leaf_table_addr + 8,
+      walk_load_page_tables(enclave_info, 0x1000));
+  EXPECT_EQ(leaf_table_addr,
+      uintptr_t(enclave_info->*(&enclave_info_t::walk_cursor_table)));
+  EXPECT_EQ(0, uintptr_t(enclave_info->*(&enclave_info_t::walk_cursor_base)));
+
+  // The cached table is used until the cursor is invalidated.
+  write_page_table_entry(mid_table_addr, 1, leaf_table_addr + 0x2000, 0);
+  EXPECT_EQ(leaf_table_addr + 16,
+      walk_load_page_tables(enclave_info, 0x2000));
+
+  invalidate_walk_cursor(enclave_info);
+  EXPECT_EQ(leaf_table_addr + 0x2000 + 16,
+      walk_load_page_tables(enclave_info, 0x2000));
+  EXPECT_EQ(leaf_table_addr + 0x2000,
+      uintptr_t(enclave_info->*(&enclave_info_t::walk_cursor_table)));
+}
+
+TEST(EnclaveInlTest, WalksStopAtSuperpages) {
+  phys_ptr<enclave_info_t> enclave_info = set_up_page_tables();
+
+  // The third L1 entry maps a 2MB superpage.
+  write_page_table_entry(mid_table_addr + 32, 1, 0x40000000, 0x3);
+
+  EXPECT_EQ(0, walk_page_tables_to_entry(root_table_addr, 0x401000, 0));
+  EXPECT_EQ(mid_table_addr + 32,
+      walk_page_tables_to_entry(root_table_addr, 0x401000, 1));
+  EXPECT_EQ(0, walk_load_page_tables(enclave_info, 0x401000));
+
+  EXPECT_EQ(0x400ab000, walk_page_tables(root_table_addr, 0x4ab123));
+  EXPECT_EQ(0, walk_page_tables(root_table_addr, 0x1000));
+  write_page_table_entry(leaf_table_addr + 8, 0, 0x50000000, 0);
+  EXPECT_EQ(0x50000000, walk_page_tables(root_table_addr, 0x1234));
+}
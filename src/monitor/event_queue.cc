@@ -0,0 +1,103 @@
+#include "event_queue.h"
+
+#include "bare/bit_masking.h"
+#include "bare/memory.h"
+#include "dram_regions_inl.h"
+#include "event_queue_inl.h"
+
+namespace sanctum {
+namespace internal {  // sanctum::internal
+
+phys_ptr<event_queue_info_t> g_event_queue_info{0};
+
+};  // namespace sanctum::internal
+};  // namespace sanctum
+
+using sanctum::api::null_enclave_id;
+using sanctum::bare::atomic_load;
+using sanctum::bare::bzero;
+using sanctum::bare::is_page_aligned;
+using sanctum::bare::page_shift;
+using sanctum::bare::phys_ptr;
+using sanctum::bare::size_t;
+using sanctum::bare::uintptr_t;
+using sanctum::internal::clear_dram_region_lock;
+using sanctum::internal::dram_region_for;
+using sanctum::internal::dram_region_info_for;
+using sanctum::internal::dram_region_info_t;
+using sanctum::internal::event_queue_addr;
+using sanctum::internal::event_queue_capacity;
+using sanctum::internal::event_queue_info_t;
+using sanctum::internal::event_queue_overlaps_monitor;
+using sanctum::internal::g_dram_size;
+using sanctum::internal::g_event_queue_info;
+using sanctum::internal::is_dram_address;
+using sanctum::internal::publish_event_queue;
+using sanctum::internal::read_dram_region_owner;
+using sanctum::internal::test_and_set_dram_region_lock;
+
+namespace sanctum {
+namespace api {  // sanctum::api
+namespace os {  // sancum::api::os
+
+size_t monitor_event_queue_capacity(size_t page_count) {
+  return event_queue_capacity(page_count);
+}
+
+size_t dropped_monitor_events() {
+  return atomic_load(&(g_event_queue_info->*(&event_queue_info_t::dropped)));
+}
+
+api_result_t create_event_queue(uintptr_t queue_addr, size_t page_count) {
+  if (!is_page_aligned(queue_addr))
+    return monitor_invalid_value;
+  // NOTE: checking the count against the DRAM size avoids overflows below
+  if (page_count == 0 || page_count > (g_dram_size >> page_shift()))
+    return monitor_invalid_value;
+  const uintptr_t queue_end = queue_addr + (page_count << page_shift());
+  if (queue_end <= queue_addr || !is_dram_address(queue_end - 1))
+    return monitor_invalid_value;
+  if (event_queue_overlaps_monitor(queue_addr))
+    return monitor_invalid_value;
+
+  // NOTE: A range of pages can cross into other DRAM regions if the regions
+  //       have more than one stripe, so every page is checked.
+  const size_t dram_region = dram_region_for(queue_addr);
+  for (uintptr_t page = queue_addr; page < queue_end;
+       page += (1 << page_shift())) {
+    if (dram_region_for(page) != dram_region)
+      return monitor_invalid_value;
+  }
+
+  if (test_and_set_dram_region_lock(0))
+    return monitor_concurrent_call;
+  if (dram_region != 0 && test_and_set_dram_region_lock(dram_region)) {
+    clear_dram_region_lock(0);
+    return monitor_concurrent_call;
+  }
+
+  api_result_t result;
+  if (event_queue_addr() != 0 ||
+      read_dram_region_owner(dram_region) != null_enclave_id) {
+    result = monitor_invalid_state;
+  } else {
+    // The queue is never removed, so its pages stay pinned. This prevents the
+    // OS from blocking the region and giving the pages to an enclave while
+    // the monitor writes events into them.
+    phys_ptr<dram_region_info_t> region = dram_region_info_for(dram_region);
+    region->*(&dram_region_info_t::pinned_pages) += page_count;
+
+    bzero(phys_ptr<size_t>{queue_addr}, page_count << page_shift());
+    publish_event_queue(queue_addr, event_queue_capacity(page_count));
+    result = monitor_ok;
+  }
+
+  if (dram_region != 0)
+    clear_dram_region_lock(dram_region);
+  clear_dram_region_lock(0);
+  return result;
+}
+
+};  // namespace sanctum::api::os
+};  // namespace sanctum::api
+};  // namespace sanctum
@@ -0,0 +1,58 @@
+#if !defined(MONITOR_EVENT_QUEUE_H_INCLUDED)
+#define MONITOR_EVENT_QUEUE_H_INCLUDED
+
+#include "bare/base_types.h"
+#include "bare/phys_atomics.h"
+#include "bare/phys_ptr.h"
+#include "public/api.h"
+
+// The monitor event queue tells the OS about DRAM region and enclave state
+// changes, so the OS doesn't have to poll for them.
+//
+// The queue is optional, and lives in OS-owned pages set aside via
+// create_event_queue(), so the OS can read it directly. The first
+// monitor_event_t-sized slot holds a monitor_event_queue_t header, followed by
+// an array of monitor_event_t. The OS only writes the header, and the monitor
+// only writes the events. The monitor keeps its own position in the queue in
+// monitor memory, so the OS cannot make the monitor write outside the queue.
+
+namespace sanctum {
+namespace internal {
+
+using sanctum::api::os::monitor_event_queue_t;
+using sanctum::api::os::monitor_event_t;
+using sanctum::bare::atomic;
+using sanctum::bare::phys_ptr;
+using sanctum::bare::size_t;
+using sanctum::bare::uintptr_t;
+
+// The monitor's private state for the event queue.
+struct event_queue_info_t {
+  // The number of events reserved by the monitor.
+  //
+  // Any core can post events, so slots are reserved by advancing this counter
+  // with compare-and-swap.
+  atomic<size_t> tail;
+
+  // The number of events dropped because the queue was full.
+  atomic<size_t> dropped;
+
+  // The physical address of the event queue, or 0 if there is no queue.
+  //
+  // This is set while holding the lock of DRAM region 0, which must belong to
+  // the OS. Once set, it never changes, so it is read without locking. It is
+  // published by an atomic store after `capacity` is written, so a core that
+  // loads a non-zero address also sees the capacity.
+  atomic<uintptr_t> queue;
+
+  // The number of events in the event queue's array.
+  size_t capacity;
+};
+
+// Allocated at boot time on its own LLC line, because every core that posts
+// an event writes to it.
+extern phys_ptr<event_queue_info_t> g_event_queue_info;
+
+};  // namespace sanctum::internal
+};  // namespace sanctum
+#endif  // !defined(MONITOR_EVENT_QUEUE_H_INCLUDED)
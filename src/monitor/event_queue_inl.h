@@ -0,0 +1,104 @@
+#if !defined(MONITOR_EVENT_QUEUE_INL_H_INCLUDED)
+#define MONITOR_EVENT_QUEUE_INL_H_INCLUDED
+
+#include "bare/page_tables.h"
+#include "bare/phys_atomics.h"
+#include "bare/phys_ptr.h"
+#include "boot_init.h"
+#include "event_queue.h"
+
+namespace sanctum {
+namespace internal {
+
+using sanctum::api::os::monitor_event_type_t;
+using sanctum::bare::atomic_compare_exchange_strong;
+using sanctum::bare::atomic_fetch_add;
+using sanctum::bare::atomic_load;
+using sanctum::bare::atomic_store;
+using sanctum::bare::page_size;
+
+static_assert(sizeof(monitor_event_queue_t) == sizeof(monitor_event_t),
+    "The event queue header must take up exactly one event slot");
+
+// The number of events that fit in an event queue that uses some pages.
+inline size_t event_queue_capacity(size_t page_count) {
+  if (page_count == 0)
+    return 0;
+  // NOTE: relying on the compiler to optimize division to bitwise shift
+  return page_count * (page_size() / sizeof(monitor_event_t)) - 1;
+}
+
+// The physical address of the OS's event queue, or 0 if there is no queue.
+//
+// The queue's capacity can be read after this returns a non-zero address.
+inline uintptr_t event_queue_addr() {
+  return atomic_load(&(g_event_queue_info->*(&event_queue_info_t::queue)));
+}
+
+// Makes the OS's event queue visible to all cores.
+//
+// The caller must hold the lock of DRAM region 0.
+inline void publish_event_queue(uintptr_t queue_addr, size_t capacity) {
+  g_event_queue_info->*(&event_queue_info_t::capacity) = capacity;
+  atomic_store(&(g_event_queue_info->*(&event_queue_info_t::queue)),
+      queue_addr);
+}
+
+// True if an event queue starting at an address overlaps the monitor's memory.
+//
+// The monitor lives at [0, g_monitor_top), inside DRAM region 0, which belongs
+// to the OS. The region's ownership doesn't keep the OS from pointing the queue
+// at the monitor's state, so the address is checked separately. The queue
+// grows upwards, so only its start needs to be checked.
+inline bool event_queue_overlaps_monitor(uintptr_t queue_addr) {
+  return queue_addr < g_monitor_top;
+}
+
+// The slot at an index in the event queue's array.
+inline phys_ptr<monitor_event_t> event_queue_slot(uintptr_t queue_addr,
+    size_t index) {
+  return phys_ptr<monitor_event_t>{queue_addr + sizeof(monitor_event_queue_t)}
+      + index;
+}
+
+// Posts an event to the OS's event queue.
+//
+// This is lock-free, so it can be used on paths that must not fail, like TLB
+// flushes. Does nothing if the OS has not set up an event queue. The event is
+// dropped and counted if the queue is full.
+inline void post_monitor_event(monitor_event_type_t type, size_t value) {
+  const uintptr_t queue_addr = event_queue_addr();
+  if (queue_addr == 0)
+    return;
+  const size_t capacity = g_event_queue_info->*(&event_queue_info_t::capacity);
+
+  // NOTE: the head is written by the OS, so it is only used to decide if the
+  //       queue is full; a bad head can only cause the OS's events to be
+  //       dropped, because event indices are reduced modulo the capacity
+  const phys_ptr<monitor_event_queue_t> queue{queue_addr};
+  const size_t head = queue->*(&monitor_event_queue_t::head);
+  const phys_ptr<atomic<size_t>> tail =
+      &(g_event_queue_info->*(&event_queue_info_t::tail));
+  size_t index = atomic_load(tail);
+  do {
+    if (index - head >= capacity) {
+      atomic_fetch_add(&(g_event_queue_info->*(&event_queue_info_t::dropped)),
+          static_cast<size_t>(1));
+      return;
+    }
+  } while (!atomic_compare_exchange_strong(tail, &index, index + 1));
+
+  phys_ptr<monitor_event_t> event =
+      event_queue_slot(queue_addr, index % capacity);
+  event->*(&monitor_event_t::type) = static_cast<size_t>(type);
+  event->*(&monitor_event_t::value) = value;
+  event->*(&monitor_event_t::reserved) = 0;
+  // NOTE: the sequence is stored atomically, after the other fields, so the
+  //       OS never sees a partially written event
+  atomic_store(phys_ptr<atomic<size_t>>{
+      uintptr_t(&(event->*(&monitor_event_t::sequence)))}, index + 1);
+}
+
+};  // namespace sanctum::internal
+};  // namespace sanctum
+#endif  // !defined(MONITOR_EVENT_QUEUE_INL_H_INCLUDED)
@@ -0,0 +1,120 @@
+#include "event_queue_inl.h"
+
+#include "gtest/gtest.h"
+
+using sanctum::api::os::monitor_event_dram_region_freeable;
+using sanctum::api::os::monitor_event_dram_region_scrubbed;
+using sanctum::api::os::monitor_event_queue_t;
+using sanctum::api::os::monitor_event_t;
+using sanctum::bare::atomic_init;
+using sanctum::bare::atomic_load;
+using sanctum::bare::page_size;
+using sanctum::bare::phys_ptr;
+using sanctum::internal::event_queue_capacity;
+using sanctum::internal::event_queue_info_t;
+using sanctum::internal::event_queue_overlaps_monitor;
+using sanctum::internal::event_queue_slot;
+using sanctum::internal::g_event_queue_info;
+using sanctum::internal::g_monitor_top;
+using sanctum::internal::post_monitor_event;
+using sanctum::internal::publish_event_queue;
+using sanctum::testing::phys_buffer;
+using sanctum::testing::phys_buffer_size;
+
+namespace {
+
+constexpr uintptr_t info_addr = 0x10000;
+constexpr uintptr_t queue_addr = 0x11000;
+
+size_t dropped_events() {
+  return atomic_load(&(g_event_queue_info->*(&event_queue_info_t::dropped)));
+}
+
+}  // anonymous namespace
+
+class EventQueueInlTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    ASSERT_LE(queue_addr + page_size(), phys_buffer_size);
+    memset(phys_buffer + queue_addr, 0xcc, page_size());
+    memset(phys_buffer + queue_addr, 0, sizeof(monitor_event_queue_t));
+
+    g_event_queue_info = phys_ptr<event_queue_info_t>{info_addr};
+    atomic_init(&(g_event_queue_info->*(&event_queue_info_t::tail)),
+        static_cast<size_t>(0));
+    atomic_init(&(g_event_queue_info->*(&event_queue_info_t::dropped)),
+        static_cast<size_t>(0));
+    publish_event_queue(queue_addr, event_queue_capacity(1));
+  }
+  virtual void TearDown() {
+    publish_event_queue(0, 0);
+  }
+};
+
+TEST_F(EventQueueInlTest, EventQueueCapacity) {
+  const size_t page_events = page_size() / sizeof(monitor_event_t);
+  EXPECT_EQ(0, event_queue_capacity(0));
+  EXPECT_EQ(page_events - 1, event_queue_capacity(1));
+  EXPECT_EQ(3 * page_events - 1, event_queue_capacity(3));
+}
+
+TEST_F(EventQueueInlTest, EventQueueOverlapsMonitor) {
+  const uintptr_t saved_monitor_top = g_monitor_top;
+  g_monitor_top = 0x1800;
+
+  EXPECT_EQ(event_queue_overlaps_monitor(0), true);
+  EXPECT_EQ(event_queue_overlaps_monitor(0x1000), true);
+  EXPECT_EQ(event_queue_overlaps_monitor(0x2000), false);
+  EXPECT_EQ(event_queue_overlaps_monitor(queue_addr), false);
+
+  g_monitor_top = saved_monitor_top;
+}
+
+TEST_F(EventQueueInlTest, PostMonitorEvent) {
+  post_monitor_event(monitor_event_dram_region_freeable, 5);
+  post_monitor_event(monitor_event_dram_region_scrubbed, 7);
+
+  phys_ptr<monitor_event_t> event = event_queue_slot(queue_addr, 0);
+  EXPECT_EQ(1, event->*(&monitor_event_t::sequence));
+  EXPECT_EQ(monitor_event_dram_region_freeable,
+      event->*(&monitor_event_t::type));
+  EXPECT_EQ(5, event->*(&monitor_event_t::value));
+
+  event = event_queue_slot(queue_addr, 1);
+  EXPECT_EQ(2, event->*(&monitor_event_t::sequence));
+  EXPECT_EQ(monitor_event_dram_region_scrubbed,
+      event->*(&monitor_event_t::type));
+  EXPECT_EQ(7, event->*(&monitor_event_t::value));
+
+  EXPECT_EQ(0, dropped_events());
+}
+
+TEST_F(EventQueueInlTest, PostMonitorEventWithoutQueue) {
+  publish_event_queue(0, 0);
+  post_monitor_event(monitor_event_dram_region_freeable, 5);
+
+  EXPECT_EQ(0, atomic_load(
+      &(g_event_queue_info->*(&event_queue_info_t::tail))));
+  EXPECT_EQ(0, dropped_events());
+}
+
+TEST_F(EventQueueInlTest, FullQueueDropsEvents) {
+  publish_event_queue(queue_addr, 2);
+  post_monitor_event(monitor_event_dram_region_freeable, 1);
+  post_monitor_event(monitor_event_dram_region_freeable, 2);
+  post_monitor_event(monitor_event_dram_region_freeable, 3);
+  EXPECT_EQ(1, dropped_events());
+
+  // Consuming an event makes room for one more, which reuses its slot.
+  phys_ptr<monitor_event_queue_t> queue{queue_addr};
+  queue->*(&monitor_event_queue_t::head) = 1;
+  post_monitor_event(monitor_event_dram_region_freeable, 4);
+  EXPECT_EQ(1, dropped_events());
+
+  phys_ptr<monitor_event_t> event = event_queue_slot(queue_addr, 0);
+  EXPECT_EQ(3, event->*(&monitor_event_t::sequence));
+  EXPECT_EQ(4, event->*(&monitor_event_t::value));
+  event = event_queue_slot(queue_addr, 1);
+  EXPECT_EQ(2, event->*(&monitor_event_t::sequence));
+  EXPECT_EQ(2, event->*(&monitor_event_t::value));
+}
@@ -0,0 +1,97 @@
+#include "boot_init.h"
+#include "dram_regions_inl.h"
+#include "event_queue_inl.h"
+#include "public/api.h"
+
+#include "gtest/gtest.h"
+
+using sanctum::api::monitor_invalid_value;
+using sanctum::api::monitor_ok;
+using sanctum::api::os::create_event_queue;
+using sanctum::api::os::monitor_event_queue_capacity;
+using sanctum::internal::boot_init_dram_regions;
+using sanctum::internal::boot_init_dynamic_arrays;
+using sanctum::internal::boot_init_metadata;
+using sanctum::internal::boot_init_monitor_top;
+using sanctum::internal::boot_init_protection;
+using sanctum::internal::dram_region_info_for;
+using sanctum::internal::dram_region_info_t;
+using sanctum::internal::event_queue_addr;
+using sanctum::internal::event_queue_info_t;
+using sanctum::internal::g_event_queue_info;
+using sanctum::internal::g_monitor_top;
+using sanctum::internal::publish_event_queue;
+
+namespace {
+
+// Sets up the test rig with the toy memory parameters from the Sanctum paper.
+//
+// The DRAM regions are 32kb, and each region is contiguous.
+void set_up_paper_memory_model() {
+  sanctum::testing::dram_size = 1 << 18;
+  sanctum::testing::cache_levels = 3;
+
+  sanctum::testing::is_shared_cache[0] = false;
+  sanctum::testing::is_shared_cache[1] = false;
+  sanctum::testing::is_shared_cache[2] = true;
+
+  sanctum::testing::cache_line_size[0] = 1 << 6;  // irrelevant to tests
+  sanctum::testing::cache_line_size[1] = 1 << 6;  // irrelevant to tests
+  sanctum::testing::cache_line_size[2] = 1 << 6;  // must be a power of 2
+
+  sanctum::testing::cache_set_count[0] = 1 << 6;  // irrelevant to tests
+  sanctum::testing::cache_set_count[1] = 1 << 8;  // irrelevant to tests
+  sanctum::testing::cache_set_count[2] = 1 << 9;  // must be a power of 2
+
+  sanctum::testing::min_cache_index_shift = 0;
+  sanctum::testing::max_cache_index_shift = 16;
+
+  sanctum::testing::set_core_count(4);
+}
+
+// The last page of DRAM region 0, which belongs to the OS.
+constexpr uintptr_t queue_addr = 0x7000;
+
+size_t pinned_pages(size_t dram_region) {
+  return dram_region_info_for(dram_region)->*(
+      &dram_region_info_t::pinned_pages);
+}
+
+}  // anonymous namespace
+
+class EventQueueTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    set_up_paper_memory_model();
+    boot_init_monitor_top();
+    boot_init_dram_regions();
+    boot_init_metadata();
+    boot_init_dynamic_arrays();
+    boot_init_protection();
+    ASSERT_LE(g_monitor_top, queue_addr);
+    ASSERT_EQ(event_queue_addr(), 0);
+  }
+  virtual void TearDown() {
+    publish_event_queue(0, 0);
+  }
+};
+
+TEST_F(EventQueueTest, CreateEventQueue) {
+  ASSERT_EQ(monitor_ok, create_event_queue(queue_addr, 1));
+  EXPECT_EQ(event_queue_addr(), queue_addr);
+  EXPECT_EQ(g_event_queue_info->*(&event_queue_info_t::capacity),
+            monitor_event_queue_capacity(1));
+  EXPECT_EQ(pinned_pages(0), 1);
+}
+
+TEST_F(EventQueueTest, CreateEventQueueRejectsHugePageCounts) {
+  // The DRAM has 64 pages. The last count wraps around to a single page when
+  // it is turned into a size.
+  const size_t page_counts[] = { 65, (static_cast<size_t>(1) << 52) + 1 };
+  for (size_t page_count : page_counts) {
+    EXPECT_EQ(monitor_invalid_value, create_event_queue(queue_addr,
+        page_count)) << page_count;
+    EXPECT_EQ(event_queue_addr(), 0) << page_count;
+    EXPECT_EQ(pinned_pages(0), 0) << page_count;
+  }
+}
@@ -1,37 +1,53 @@
 #if !defined(MONITOR_MEASURE_INL_H_INCLUDED)
 #define MONITOR_MEASURE_INL_H_INCLUDED
 
+#include "bare/bit_masking.h"
 #include "bare/memory.h"
 #include "bare/page_tables.h"
+#include "cpu_core_inl.h"
 #include "crypto/hash.h"
 #include "enclave.h"
+#include "page_cache_inl.h"
 #include "public/api.h"
 
 namespace sanctum {
 namespace internal {
 
+using sanctum::api::os::measurement_packed;
+using sanctum::api::os::measurement_tree;
 using sanctum::api::thread_id_t;
+using sanctum::bare::bcopy;
+using sanctum::bare::bzero;
+using sanctum::bare::is_big_endian;
 using sanctum::bare::page_size;
+using sanctum::bare::page_table_entry_span;
+using sanctum::bare::reverse_bytes;
+using sanctum::crypto::copy_and_extend_hash_blocks;
 using sanctum::crypto::extend_hash;
+using sanctum::crypto::extend_hash_blocks;
 using sanctum::crypto::finalize_hash;
 using sanctum::crypto::hash_block_size;
+using sanctum::crypto::hash_result_size;
 using sanctum::crypto::hash_state_t;
+using sanctum::crypto::hash_word_t;
 using sanctum::crypto::init_hash;
 
 // The layout of a hash block used to measure an enclave operation.
 //
-// The structure may not overlap the entire hash block, so init_enclave_hash()
-// zeroes the entire hash block. Every other function that uses the structure
-// is responsible for zeroing out the arguments that it sets after it's done
-// extending the enclave hash. The opcode field does not need to be zeroed out,
-// because every operation needs to set it.
+// The structure may not overlap the entire hash block. Blocks are built in the
+// current core's scratch space by scratch_measurement_block(), which zeroes
+// the entire hash block, so each operation only sets the fields it measures.
 struct measurement_block_t {
   size_t opcode;
   uintptr_t ptr1, ptr2, ptr3, ptr4;
-  size_t size1, size2;
+  size_t size1, size2, size3;
 };
 static_assert(sizeof(measurement_block_t) <= hash_block_size,
     "measurement_block_t does not fit in a hash block");
+static_assert(hash_result_size <= sanctum::api::enclave::measurement_size,
+    "the hash result does not fit in an enclave measurement");
+static_assert(2 * hash_result_size <= hash_block_size,
+    "two page tree digests do not fit in a hash block");
 
 // Opcodes for enclave operations.
 constexpr size_t enclave_init_opcode = 0xAAAAAAAA;
@@ -39,43 +55,139 @@ constexpr size_t load_page_table_opcode = 0xBBBBBBBB;
 constexpr size_t load_page_opcode = 0xCCCCCCCC;
 constexpr size_t load_thread_opcode = 0xDDDDDDDD;
 constexpr size_t finalize_enclave_opcode = 0xEEEEEEEE;
+constexpr size_t page_tree_node_opcode = 0xF0F0F0F0;
+constexpr size_t page_tree_root_opcode = 0xF1F1F1F1;
+constexpr size_t load_zero_pages_opcode = 0xCDCDCDCD;
 
-// Computes the address of an enclave's buffer for measurement hashing.
+// The measurement_block_t fields that make up an operation's packed record.
 //
-// The buffer is used to put together
-inline phys_ptr<measurement_block_t> enclave_measurement_block(
-    phys_ptr<enclave_info_t> enclave_info) {
-  phys_ptr<uint32_t> block_ptr = enclave_info->*(&enclave_info_t::hash_block);
-  return phys_ptr<measurement_block_t>{uintptr_t(block_ptr)};
+// Bit i is set if the i-th word of measurement_block_t is a part of the
+// record. The first word is always the opcode, which determines the record's
+// length, so packed records can be decoded unambiguously.
+constexpr size_t packed_page_fields = 0x27;  // opcode, ptr1, ptr2, size1
+constexpr size_t packed_thread_fields = 0x1F;  // opcode, ptr1 to ptr4
+constexpr size_t packed_root_fields = 0x21;  // opcode, size1
+constexpr size_t packed_finalize_fields = 0x01;  // opcode
+
+// True if an enclave's measurement uses the tree format.
+inline bool is_tree_measurement(phys_ptr<enclave_info_t> enclave_info) {
+  const size_t mode = enclave_info->*(&enclave_info_t::measurement_mode);
+  return (mode & ~static_cast<size_t>(measurement_packed)) ==
+      measurement_tree;
 }
 
-// Initializes an enclave's measurement hash.
+// True if an enclave's measurement packs small operations into hash blocks.
+inline bool is_packed_measurement(phys_ptr<enclave_info_t> enclave_info) {
+  const size_t mode = enclave_info->*(&enclave_info_t::measurement_mode);
+  return (mode & measurement_packed) != 0;
+}
+
+// Starts building a measurement block in a core's scratch space.
 //
-// The caller must hold the lock of the enclave's main DRAM region.
-inline void init_enclave_hash(phys_ptr<enclave_info_t> enclave_info,
-    uintptr_t ev_base, uintptr_t ev_mask, size_t mailbox_count, bool debug) {
+// The block is zeroed, so each operation only sets the fields it measures.
+// Building blocks in per-core scratch space keeps the stores out of the
+// enclave's metadata, and the blocks don't need to be cleaned up after use.
+inline phys_ptr<measurement_block_t> scratch_measurement_block(
+    phys_ptr<core_info_t> core_info) {
   // NOTE: 32-bit operations may be slow on 64-bit architectures, so we convert
   //       the pointer to an architecture-native type before instantiating the
   //       bzero template
-  phys_ptr<size_t> fast_hash_block = phys_ptr<size_t>{uintptr_t(
-      enclave_info->*(&enclave_info_t::hash_block))};
-  bzero(fast_hash_block, hash_block_size);
+  phys_ptr<hash_word_t> blocks = core_info->*(&core_info_t::scratch_blocks);
+  bzero(phys_ptr<size_t>{uintptr_t(blocks)}, hash_block_size);
+  return phys_ptr<measurement_block_t>{uintptr_t(blocks)};
+}
+
+// Extends an enclave's measurement hash with a core's scratch block.
+//
+// The block must have been built by scratch_measurement_block().
+inline void extend_enclave_hash_with_scratch_block(
+    phys_ptr<enclave_info_t> enclave_info, phys_ptr<core_info_t> core_info) {
+  extend_hash(&(enclave_info->*(&enclave_info_t::hash)),
+      core_info->*(&core_info_t::scratch_blocks));
+}
+
+// Appends words to an enclave's packed measurement records.
+//
+// Each hash block is added to the enclave's measurement hash as soon as it
+// fills up, so records can straddle hash blocks.
+inline void append_packed_measurement_words(
+    phys_ptr<enclave_info_t> enclave_info, phys_ptr<size_t> words,
+    size_t count) {
+  phys_ptr<size_t> block = enclave_info->*(&enclave_info_t::packed_block);
+  size_t used = enclave_info->*(&enclave_info_t::packed_words);
+  for (size_t i = 0; i < count; ++i) {
+    block[used] = size_t(words[i]);
+    ++used;
+    if (used == packed_block_words) {
+      extend_hash(&(enclave_info->*(&enclave_info_t::hash)),
+          phys_ptr<hash_word_t>{uintptr_t(block)});
+      used = 0;
+    }
+  }
+  enclave_info->*(&enclave_info_t::packed_words) = used;
+}
+
+// Adds an enclave's partially filled packed block to its measurement hash.
+//
+// The block's unused words are zeroed. Zero is not an opcode, so the padding
+// can't be mistaken for a record. This must be called before anything else is
+// added to the measurement hash, such as page contents.
+inline void flush_packed_measurement(phys_ptr<enclave_info_t> enclave_info) {
+  size_t used = enclave_info->*(&enclave_info_t::packed_words);
+  if (used == 0)
+    return;
+
+  phys_ptr<size_t> block = enclave_info->*(&enclave_info_t::packed_block);
+  for (; used < packed_block_words; ++used)
+    block[used] = 0;
+  extend_hash(&(enclave_info->*(&enclave_info_t::hash)),
+      phys_ptr<hash_word_t>{uintptr_t(block)});
+  enclave_info->*(&enclave_info_t::packed_words) = 0;
+}
+
+// Adds the operation in a core's scratch block to an enclave's measurement.
+//
+// `fields` selects the measurement_block_t fields that go into the
+// operation's record, if the enclave uses packed measurements. Otherwise, the
+// entire scratch block is added to the measurement hash.
+inline void extend_enclave_hash_with_scratch_record(
+    phys_ptr<enclave_info_t> enclave_info, phys_ptr<core_info_t> core_info,
+    size_t fields) {
+  if (!is_packed_measurement(enclave_info)) {
+    extend_enclave_hash_with_scratch_block(enclave_info, core_info);
+    return;
+  }
+
+  phys_ptr<size_t> words{
+      uintptr_t(core_info->*(&core_info_t::scratch_blocks))};
+  for (size_t i = 0; i < sizeof(measurement_block_t) / sizeof(size_t); ++i) {
+    if ((fields >> i) & 1)
+      append_packed_measurement_words(enclave_info, words + i, 1);
+  }
+}
+
+// Initializes an enclave's measurement hash.
+//
+// The caller must hold the lock of the enclave's main DRAM region.
+inline void init_enclave_hash(phys_ptr<enclave_info_t> enclave_info,
+    uintptr_t ev_base, uintptr_t ev_mask, size_t mailbox_count, bool debug,
+    size_t measurement_mode) {
   init_hash(&(enclave_info->*(&enclave_info_t::hash)));
+  enclave_info->*(&enclave_info_t::measurement_mode) = measurement_mode;
+  enclave_info->*(&enclave_info_t::page_tree_leaves) = 0;
+  enclave_info->*(&enclave_info_t::packed_words) = 0;
 
-  phys_ptr<measurement_block_t> block =
-      enclave_measurement_block(enclave_info);
+  // NOTE: the initialization block is never packed, because it carries the
+  //       measurement mode that tells verifiers how to decode the records
+  phys_ptr<core_info_t> core_info = current_core_info();
+  phys_ptr<measurement_block_t> block = scratch_measurement_block(core_info);
   block->*(&measurement_block_t::opcode) = enclave_init_opcode;
   block->*(&measurement_block_t::ptr1) = ev_base;
   block->*(&measurement_block_t::ptr2) = ev_mask;
   block->*(&measurement_block_t::size1) = mailbox_count;
   block->*(&measurement_block_t::size2) = debug;
-
-  extend_hash(&(enclave_info->*(&enclave_info_t::hash)),
-      enclave_info->*(&enclave_info_t::hash_block));
-  block->*(&measurement_block_t::ptr1) = 0;
-  block->*(&measurement_block_t::ptr2) = 0;
-  block->*(&measurement_block_t::size1) = 0;
-  block->*(&measurement_block_t::size2) = 0;
+  block->*(&measurement_block_t::size3) = measurement_mode;
+  extend_enclave_hash_with_scratch_block(enclave_info, core_info);
 }
 
 // Adds a page table creation operation to an enclave's measurement hash.
@@ -84,18 +196,265 @@ inline void init_enclave_hash(phys_ptr<enclave_info_t> enclave_info,
 inline void extend_enclave_hash_with_page_table(
     phys_ptr<enclave_info_t> enclave_info, uintptr_t virtual_addr,
     size_t level, uintptr_t acl) {
-  phys_ptr<measurement_block_t> block =
-      enclave_measurement_block(enclave_info);
+  phys_ptr<core_info_t> core_info = current_core_info();
+  phys_ptr<measurement_block_t> block = scratch_measurement_block(core_info);
   block->*(&measurement_block_t::opcode) = load_page_table_opcode;
   block->*(&measurement_block_t::ptr1) = virtual_addr;
   block->*(&measurement_block_t::ptr2) = acl;
   block->*(&measurement_block_t::size1) = level;
+  extend_enclave_hash_with_scratch_record(enclave_info, core_info,
+      packed_page_fields);
+}
 
-  extend_hash(&(enclave_info->*(&enclave_info_t::hash)),
-      enclave_info->*(&enclave_info_t::hash_block));
-  block->*(&measurement_block_t::ptr1) = 0;
-  block->*(&measurement_block_t::ptr2) = 0;
-  block->*(&measurement_block_t::size1) = 0;
+// Copies the result of a finalized hash into a page tree digest.
+//
+// Digests are stored as big-endian byte strings, so measurements don't depend
+// on the monitor's endianness.
+inline void store_page_tree_digest(phys_ptr<hash_word_t> digest,
+    phys_ptr<hash_state_t> hash) {
+  phys_ptr<hash_word_t> result = hash->*(&hash_state_t::h);
+  for (size_t i = 0; i < page_tree_digest_words; ++i) {
+    const hash_word_t word = result[i];
+    digest[i] = is_big_endian() ? word : reverse_bytes(word);
+  }
+}
+
+// Extends a hash with the contents of a page or superpage.
+//
+// `size` is the page's size in bytes. If `source_addr` differs from
+// `phys_addr`, the page is copied from `source_addr` to `phys_addr` as it is
+// hashed, so the page is only read once.
+inline void extend_hash_with_page_contents(phys_ptr<hash_state_t> hash,
+    uintptr_t phys_addr, uintptr_t source_addr, size_t size) {
+  if (source_addr == phys_addr) {
+    extend_hash_blocks(hash, phys_ptr<hash_word_t>{phys_addr},
+        size / hash_block_size);
+  } else {
+    copy_and_extend_hash_blocks(hash, phys_ptr<hash_word_t>{phys_addr},
+        phys_ptr<hash_word_t>{source_addr}, size / hash_block_size);
+  }
+}
+
+// Computes the digest of a page's contents.
+//
+// The digest is stored in the scratch_digest field of `core_info`. If
+// `source_addr` differs from `phys_addr`, the page is copied from
+// `source_addr` while it is hashed.
+inline void hash_page_contents(phys_ptr<core_info_t> core_info,
+    uintptr_t phys_addr, uintptr_t source_addr, size_t level) {
+  phys_ptr<hash_state_t> hash = &(core_info->*(&core_info_t::scratch_hash));
+  init_hash(hash);
+  extend_hash_with_page_contents(hash, phys_addr, source_addr,
+      page_table_entry_span(level));
+  finalize_hash(hash);
+  store_page_tree_digest(core_info->*(&core_info_t::scratch_digest), hash);
+}
+
+// Computes the digest of a page's contents, using the page digest cache.
+//
+// Superpages are not cached, and neither are pages hashed while another core
+// holds the cache's lock. Those are hashed by hash_page_contents().
+inline void hash_cached_page_contents(phys_ptr<core_info_t> core_info,
+    uintptr_t phys_addr, uintptr_t source_addr, size_t level) {
+  const uintptr_t cache_addr = page_digest_cache_addr();
+  if (level != 0 || cache_addr == 0) {
+    hash_page_contents(core_info, phys_addr, source_addr, level);
+    return;
+  }
+  phys_ptr<page_digest_cache_t> cache{cache_addr};
+  if (test_and_set_page_digest_cache_lock(cache)) {
+    hash_page_contents(core_info, phys_addr, source_addr, level);
+    return;
+  }
+
+  // NOTE: The page is copied before it is looked up, so the lookup checks
+  //       the enclave's copy. Looking up the OS page would let the OS change
+  //       it after the comparison.
+  if (source_addr != phys_addr) {
+    bcopy(phys_ptr<size_t>{phys_addr}, phys_ptr<size_t>{source_addr},
+        page_size());
+  }
+  phys_ptr<hash_word_t> digest = core_info->*(&core_info_t::scratch_digest);
+  const size_t fingerprint = page_fingerprint(phys_addr);
+  if (!find_page_digest(cache, phys_addr, fingerprint, digest)) {
+    hash_page_contents(core_info, phys_addr, phys_addr, level);
+    store_page_digest(cache, phys_addr, fingerprint, digest);
+  }
+  clear_page_digest_cache_lock(cache);
+}
+
+// Computes the leaf digest for a page in a tree-format measurement.
+//
+// The leaf digest covers the same information as a serial page measurement.
+// It is the hash of a block describing the page, followed by a block holding
+// the digest of the page's contents, so the contents digest can come from the
+// page digest cache.
+//
+// This does not read or write the enclave's state. `core_info` supplies the
+// scratch space, and the digest is stored in its scratch_digest field.
+//
+// NOTE: The loading calls hold the enclave's lock while they compute leaves,
+//       because they copy the page into the enclave's memory as it is hashed.
+//
+// `level` is the page table level of the entry that maps the page, so leaves
+// for superpages cover the whole superpage. If `source_addr` differs from
+// `phys_addr`, the page is copied from `source_addr` while it is hashed.
+inline void hash_page_tree_leaf(phys_ptr<core_info_t> core_info,
+    uintptr_t virtual_addr, uintptr_t acl, uintptr_t phys_addr,
+    uintptr_t source_addr, size_t level) {
+  hash_cached_page_contents(core_info, phys_addr, source_addr, level);
+
+  phys_ptr<hash_word_t> blocks = core_info->*(&core_info_t::scratch_blocks);
+  bzero(phys_ptr<size_t>{uintptr_t(blocks)}, 2 * hash_block_size);
+  phys_ptr<measurement_block_t> block{uintptr_t(blocks)};
+  block->*(&measurement_block_t::opcode) = load_page_opcode;
+  block->*(&measurement_block_t::ptr1) = virtual_addr;
+  block->*(&measurement_block_t::ptr2) = acl;
+  block->*(&measurement_block_t::size1) = level;
+
+  phys_ptr<hash_word_t> contents_digest =
+      core_info->*(&core_info_t::scratch_digest);
+  phys_ptr<hash_word_t> digest_block = blocks +
+      hash_block_size / sizeof(hash_word_t);
+  for (size_t i = 0; i < page_tree_digest_words; ++i)
+    digest_block[i] = contents_digest[i];
+
+  phys_ptr<hash_state_t> hash = &(core_info->*(&core_info_t::scratch_hash));
+  init_hash(hash);
+  extend_hash_blocks(hash, blocks, 2);
+  finalize_hash(hash);
+  store_page_tree_digest(core_info->*(&core_info_t::scratch_digest), hash);
+}
+
+// Computes the leaf digest for a page that is already in place.
+inline void hash_page_tree_leaf(phys_ptr<core_info_t> core_info,
+    uintptr_t virtual_addr, uintptr_t acl, uintptr_t phys_addr) {
+  hash_page_tree_leaf(core_info, virtual_addr, acl, phys_addr, phys_addr, 0);
+}
+
+// Computes an interior node in a tree-format measurement.
+//
+// `level` is the height of the left subtree. The node digest is stored in
+// `digest`, which can be the same as `left` or `right`.
+inline void hash_page_tree_node(phys_ptr<core_info_t> core_info,
+    size_t level, phys_ptr<hash_word_t> left, phys_ptr<hash_word_t> right,
+    phys_ptr<hash_word_t> digest) {
+  // The first block identifies the operation. The second block holds the
+  // children's digests.
+  phys_ptr<hash_word_t> blocks = core_info->*(&core_info_t::scratch_blocks);
+  bzero(phys_ptr<size_t>{uintptr_t(blocks)}, 2 * hash_block_size);
+  phys_ptr<measurement_block_t> block{uintptr_t(blocks)};
+  block->*(&measurement_block_t::opcode) = page_tree_node_opcode;
+  block->*(&measurement_block_t::size1) = level;
+
+  phys_ptr<hash_word_t> children = blocks +
+      hash_block_size / sizeof(hash_word_t);
+  for (size_t i = 0; i < page_tree_digest_words; ++i) {
+    children[i] = left[i];
+    children[page_tree_digest_words + i] = right[i];
+  }
+
+  phys_ptr<hash_state_t> hash = &(core_info->*(&core_info_t::scratch_hash));
+  init_hash(hash);
+  extend_hash_blocks(hash, blocks, 2);
+  finalize_hash(hash);
+  store_page_tree_digest(digest, hash);
+}
+
+// The root of the complete subtree with 2^level leaves in an enclave's tree.
+inline phys_ptr<hash_word_t> page_tree_subtree(
+    phys_ptr<enclave_info_t> enclave_info, size_t level) {
+  return enclave_info->*(&enclave_info_t::page_tree) +
+      level * page_tree_digest_words;
+}
+
+// Adds a leaf digest to an enclave's page tree.
+//
+// The leaf digest is read from the scratch_digest field of `core_info`, which
+// is used as scratch space.
+//
+// The caller must hold the lock of the enclave's main DRAM region.
+inline void add_page_tree_leaf(phys_ptr<enclave_info_t> enclave_info,
+    phys_ptr<core_info_t> core_info) {
+  phys_ptr<hash_word_t> carry = core_info->*(&core_info_t::scratch_digest);
+  const size_t leaves = enclave_info->*(&enclave_info_t::page_tree_leaves);
+
+  // Each set low-order bit is a subtree of the same size as the carry.
+  size_t level = 0;
+  for (; (leaves >> level) & 1; ++level) {
+    hash_page_tree_node(core_info, level,
+        page_tree_subtree(enclave_info, level), carry, carry);
+  }
+
+  phys_ptr<hash_word_t> subtree = page_tree_subtree(enclave_info, level);
+  for (size_t i = 0; i < page_tree_digest_words; ++i)
+    subtree[i] = carry[i];
+  enclave_info->*(&enclave_info_t::page_tree_leaves) = leaves + 1;
+}
+
+// Computes the root of an enclave's page tree.
+//
+// The subtrees are combined from the smallest to the largest, so the leaves
+// stay in the order that they were added. The root is stored in the
+// scratch_digest field of `core_info`. An empty tree has an all-zero root.
+inline void page_tree_root(phys_ptr<enclave_info_t> enclave_info,
+    phys_ptr<core_info_t> core_info) {
+  phys_ptr<hash_word_t> root = core_info->*(&core_info_t::scratch_digest);
+  for (size_t i = 0; i < page_tree_digest_words; ++i)
+    root[i] = 0;
+
+  const size_t leaves = enclave_info->*(&enclave_info_t::page_tree_leaves);
+  bool has_root = false;
+  for (size_t level = 0; level < page_tree_height; ++level) {
+    if (((leaves >> level) & 1) == 0)
+      continue;
+
+    phys_ptr<hash_word_t> subtree = page_tree_subtree(enclave_info, level);
+    if (has_root) {
+      hash_page_tree_node(core_info, level, subtree, root, root);
+    } else {
+      for (size_t i = 0; i < page_tree_digest_words; ++i)
+        root[i] = subtree[i];
+      has_root = true;
+    }
+  }
+}
+
+// Copies a page into an enclave, and adds its creation to the measurement.
+//
+// The caller must hold the lock of the encalve's main DRAM region.
+//
+// The page is copied from `source_addr` to `phys_addr` while it is hashed, so
+// the source is read once, instead of once by bcopy() and once by the hash.
+// Neither address is included in the measurement.
+//
+// `level` is the page table level of the entry that maps the page. Pages at
+// levels above 0 are superpages, and are measured in their entirety. The
+// level is measured, so a superpage and the equivalent run of pages have
+// different measurements.
+inline void copy_and_extend_enclave_hash_with_page(
+    phys_ptr<enclave_info_t> enclave_info, uintptr_t virtual_addr,
+    uintptr_t acl, uintptr_t phys_addr, uintptr_t source_addr, size_t level) {
+  phys_ptr<core_info_t> core_info = current_core_info();
+  if (is_tree_measurement(enclave_info)) {
+    hash_page_tree_leaf(core_info, virtual_addr, acl, phys_addr,
+        source_addr, level);
+    add_page_tree_leaf(enclave_info, core_info);
+    return;
+  }
+
+  phys_ptr<measurement_block_t> block = scratch_measurement_block(core_info);
+  block->*(&measurement_block_t::opcode) = load_page_opcode;
+  block->*(&measurement_block_t::ptr1) = virtual_addr;
+  block->*(&measurement_block_t::ptr2) = acl;
+  block->*(&measurement_block_t::size1) = level;
+  extend_enclave_hash_with_scratch_record(enclave_info, core_info,
+      packed_page_fields);
+
+  // The page's contents start at a hash block boundary.
+  flush_packed_measurement(enclave_info);
+  extend_hash_with_page_contents(&(enclave_info->*(&enclave_info_t::hash)),
+      phys_addr, source_addr, page_table_entry_span(level));
 }
 
 // Adds a page creation operation to an enclave's measurement hash.
@@ -107,22 +466,37 @@ inline void extend_enclave_hash_with_page_table(
 inline void extend_enclave_hash_with_page(
     phys_ptr<enclave_info_t> enclave_info, uintptr_t virtual_addr,
     uintptr_t acl, uintptr_t phys_addr) {
-  phys_ptr<measurement_block_t> block =
-      enclave_measurement_block(enclave_info);
-  block->*(&measurement_block_t::opcode) = load_page_opcode;
+  copy_and_extend_enclave_hash_with_page(enclave_info, virtual_addr, acl,
+      phys_addr, phys_addr, 0);
+}
+
+// Adds a zero-filled page range creation to an enclave's measurement hash.
+//
+// The caller must hold the lock of the encalve's main DRAM region.
+//
+// The pages' contents are known to be zero, so they are not hashed. In
+// tree-format measurements, the whole range becomes a single leaf.
+inline void extend_enclave_hash_with_zero_pages(
+    phys_ptr<enclave_info_t> enclave_info, uintptr_t virtual_addr,
+    size_t page_count, uintptr_t acl) {
+  phys_ptr<core_info_t> core_info = current_core_info();
+  phys_ptr<measurement_block_t> block = scratch_measurement_block(core_info);
+  block->*(&measurement_block_t::opcode) = load_zero_pages_opcode;
   block->*(&measurement_block_t::ptr1) = virtual_addr;
   block->*(&measurement_block_t::ptr2) = acl;
+  block->*(&measurement_block_t::size1) = page_count;
 
-  extend_hash(&(enclave_info->*(&enclave_info_t::hash)),
-      enclave_info->*(&enclave_info_t::hash_block));
-  block->*(&measurement_block_t::ptr1) = 0;
-  block->*(&measurement_block_t::ptr2) = 0;
-
-  phys_ptr<uint32_t> page_end{phys_addr + page_size()};
-  for(phys_ptr<uint32_t> page_ptr{phys_addr}; page_ptr != page_end;
-      page_ptr += hash_block_size / sizeof(uint32_t)) {
-    extend_hash(&(enclave_info->*(&enclave_info_t::hash)), page_ptr);
+  if (is_tree_measurement(enclave_info)) {
+    phys_ptr<hash_state_t> hash = &(core_info->*(&core_info_t::scratch_hash));
+    init_hash(hash);
+    extend_hash(hash, core_info->*(&core_info_t::scratch_blocks));
+    finalize_hash(hash);
+    store_page_tree_digest(core_info->*(&core_info_t::scratch_digest), hash);
+    add_page_tree_leaf(enclave_info, core_info);
+    return;
   }
+  extend_enclave_hash_with_scratch_record(enclave_info, core_info,
+      packed_page_fields);
 }
 
 // Adds a thread creation operation to an enclave's measurement hash.
@@ -131,33 +505,107 @@ inline void extend_enclave_hash_with_page(
 inline void extend_enclave_hash_with_thread(
     phys_ptr<enclave_info_t> enclave_info, uintptr_t entry_pc,
     uintptr_t entry_stack, uintptr_t fault_pc, uintptr_t fault_stack) {
-  phys_ptr<measurement_block_t> block =
-      enclave_measurement_block(enclave_info);
+  phys_ptr<core_info_t> core_info = current_core_info();
+  phys_ptr<measurement_block_t> block = scratch_measurement_block(core_info);
   block->*(&measurement_block_t::opcode) = load_thread_opcode;
   block->*(&measurement_block_t::ptr1) = entry_pc;
   block->*(&measurement_block_t::ptr2) = entry_stack;
   block->*(&measurement_block_t::ptr3) = fault_pc;
   block->*(&measurement_block_t::ptr4) = fault_stack;
-
-  extend_hash(&(enclave_info->*(&enclave_info_t::hash)),
-      enclave_info->*(&enclave_info_t::hash_block));
-  block->*(&measurement_block_t::ptr1) = 0;
-  block->*(&measurement_block_t::ptr2) = 0;
-  block->*(&measurement_block_t::ptr3) = 0;
-  block->*(&measurement_block_t::ptr4) = 0;
+  extend_enclave_hash_with_scratch_record(enclave_info, core_info,
+      packed_thread_fields);
 }
 
 // Finalizes the enclave's measurement hash.
+//
+// For tree-format measurements, this also measures the page tree's root. For
+// packed measurements, this also flushes the last packed block.
+//
+// The caller must hold the lock of the encalve's main DRAM region.
 inline void finalize_enclave_hash(phys_ptr<enclave_info_t> enclave_info) {
-  phys_ptr<measurement_block_t> block =
-      enclave_measurement_block(enclave_info);
-  block->*(&measurement_block_t::opcode) = finalize_enclave_opcode;
+  phys_ptr<core_info_t> core_info = current_core_info();
 
-  extend_hash(&(enclave_info->*(&enclave_info_t::hash)),
-      enclave_info->*(&enclave_info_t::hash_block));
+  if (is_tree_measurement(enclave_info)) {
+    phys_ptr<measurement_block_t> root_op_block =
+        scratch_measurement_block(core_info);
+    root_op_block->*(&measurement_block_t::opcode) = page_tree_root_opcode;
+    root_op_block->*(&measurement_block_t::size1) =
+        enclave_info->*(&enclave_info_t::page_tree_leaves);
+    extend_enclave_hash_with_scratch_record(enclave_info, core_info,
+        packed_root_fields);
+
+    page_tree_root(enclave_info, core_info);
+    phys_ptr<hash_word_t> root = core_info->*(&core_info_t::scratch_digest);
+    if (is_packed_measurement(enclave_info)) {
+      // The root digest is a part of the root operation's record.
+      append_packed_measurement_words(enclave_info,
+          phys_ptr<size_t>{uintptr_t(root)},
+          hash_result_size / sizeof(size_t));
+    } else {
+      // The root digest is measured in a block of its own, zero-padded.
+      phys_ptr<hash_word_t> root_block =
+          core_info->*(&core_info_t::scratch_blocks);
+      bzero(phys_ptr<size_t>{uintptr_t(root_block)}, hash_block_size);
+      for (size_t i = 0; i < page_tree_digest_words; ++i)
+        root_block[i] = root[i];
+      extend_hash(&(enclave_info->*(&enclave_info_t::hash)), root_block);
+    }
+  }
+
+  phys_ptr<measurement_block_t> block = scratch_measurement_block(core_info);
+  block->*(&measurement_block_t::opcode) = finalize_enclave_opcode;
+  extend_enclave_hash_with_scratch_record(enclave_info, core_info,
+      packed_finalize_fields);
+  flush_packed_measurement(enclave_info);
   finalize_hash(&(enclave_info->*(&enclave_info_t::hash)));
 }
 
+// Copies words of measurement state between two enclaves' metadata.
+//
+// bcopy() is not used because the fields are not cache-line-aligned.
+inline void copy_measurement_words(phys_ptr<size_t> dest,
+    phys_ptr<size_t> source, size_t bytes) {
+  for (size_t i = 0; i < bytes / sizeof(size_t); ++i)
+    dest[i] = size_t(source[i]);
+}
+
+// Copies an enclave's measurement in progress to another enclave.
+//
+// The destination's measurement ends up in the same state as if its enclave
+// had gone through the same loading operations as the source enclave, without
+// re-hashing any page.
+//
+// The caller must hold the locks of both enclaves' main DRAM regions.
+inline void copy_enclave_hash(phys_ptr<enclave_info_t> dest_info,
+    phys_ptr<enclave_info_t> source_info) {
+  static_assert(sizeof(hash_state_t) % sizeof(size_t) == 0,
+      "hash_state_t size not a multiple of size_t");
+  static_assert(sizeof(enclave_info_t::page_tree) % sizeof(size_t) == 0,
+      "page_tree size not a multiple of size_t");
+  static_assert(sizeof(enclave_info_t::packed_block) % sizeof(size_t) == 0,
+      "packed_block size not a multiple of size_t");
+
+  dest_info->*(&enclave_info_t::measurement_mode) =
+      size_t(source_info->*(&enclave_info_t::measurement_mode));
+  dest_info->*(&enclave_info_t::page_tree_leaves) =
+      size_t(source_info->*(&enclave_info_t::page_tree_leaves));
+  dest_info->*(&enclave_info_t::packed_words) =
+      size_t(source_info->*(&enclave_info_t::packed_words));
+  copy_measurement_words(
+      phys_ptr<size_t>{uintptr_t(&(dest_info->*(&enclave_info_t::hash)))},
+      phys_ptr<size_t>{uintptr_t(&(source_info->*(&enclave_info_t::hash)))},
+      sizeof(hash_state_t));
+  copy_measurement_words(
+      phys_ptr<size_t>{uintptr_t(dest_info->*(&enclave_info_t::page_tree))},
+      phys_ptr<size_t>{uintptr_t(source_info->*(&enclave_info_t::page_tree))},
+      sizeof(enclave_info_t::page_tree));
+  copy_measurement_words(
+      phys_ptr<size_t>{uintptr_t(dest_info->*(&enclave_info_t::packed_block))},
+      phys_ptr<size_t>{
+          uintptr_t(source_info->*(&enclave_info_t::packed_block))},
+      sizeof(enclave_info_t::packed_block));
+}
+
 };  // namespace sanctum::internal
 };  // namespace sanctum
 #endif  // !defined(MONITOR_MEASURE_INL_H_INCLUDED)
@@ -1 +1,389 @@
 #include "measure_inl.h"
+
+#include "gtest/gtest.h"
+
+using sanctum::api::os::measurement_packed;
+using sanctum::api::os::measurement_serial;
+using sanctum::api::os::measurement_tree;
+using sanctum::bare::atomic;
+using sanctum::bare::atomic_init;
+using sanctum::bare::atomic_load;
+using sanctum::bare::phys_ptr;
+using sanctum::crypto::hash_state_t;
+using sanctum::crypto::hash_word_t;
+using sanctum::internal::copy_enclave_hash;
+using sanctum::internal::copy_and_extend_enclave_hash_with_page;
+using sanctum::internal::core_info_t;
+using sanctum::internal::enclave_info_t;
+using sanctum::internal::extend_enclave_hash_with_page;
+using sanctum::internal::extend_enclave_hash_with_page_table;
+using sanctum::internal::extend_enclave_hash_with_thread;
+using sanctum::internal::extend_enclave_hash_with_zero_pages;
+using sanctum::internal::finalize_enclave_hash;
+using sanctum::internal::g_core;
+using sanctum::internal::g_page_digest_cache;
+using sanctum::internal::hash_page_tree_leaf;
+using sanctum::internal::hash_page_tree_node;
+using sanctum::internal::init_enclave_hash;
+using sanctum::internal::init_page_digest_cache;
+using sanctum::internal::packed_block_words;
+using sanctum::internal::page_digest_cache_t;
+using sanctum::internal::page_tree_digest_words;
+using sanctum::internal::page_tree_root;
+using sanctum::internal::publish_page_digest_cache;
+using sanctum::testing::phys_buffer;
+using sanctum::testing::phys_buffer_size;
+
+namespace {
+
+constexpr uintptr_t core_addr = 0x1000;
+constexpr uintptr_t enclave_addr = 0x4000;
+constexpr uintptr_t enclave2_addr = 0x8000;
+constexpr uintptr_t page_addr = 0x10000;
+constexpr uintptr_t copy_addr = 0x18000;
+constexpr uintptr_t digest_addr = 0x20000;
+constexpr uintptr_t cache_addr = 0x30000;
+constexpr uintptr_t cache_info_addr = 0x28000;
+
+// Fills the test pages with distinct contents, sets up the core array, and
+// turns off the page digest cache.
+void set_up_pages() {
+  ASSERT_LE(sizeof(core_info_t), enclave_addr - core_addr);
+  ASSERT_LE(sizeof(enclave_info_t), enclave2_addr - enclave_addr);
+  ASSERT_LE(sizeof(enclave_info_t), page_addr - enclave2_addr);
+  ASSERT_LE(digest_addr + 0x1000, phys_buffer_size);
+
+  for (size_t i = 0; i < 4 * 0x1000; ++i)
+    phys_buffer[page_addr + i] = static_cast<char>(i * 7 + (i >> 12));
+
+  sanctum::testing::set_core_count(1);
+  g_core = phys_ptr<core_info_t>{core_addr};
+  g_page_digest_cache = phys_ptr<atomic<uintptr_t>>{cache_info_addr};
+  atomic_init(g_page_digest_cache, static_cast<uintptr_t>(0));
+}
+
+// Measures a sequence of pages into an enclave.
+void measure_pages(uintptr_t enclave_id, size_t mode,
+    const size_t* pages, size_t page_count) {
+  phys_ptr<enclave_info_t> enclave_info{enclave_id};
+  init_enclave_hash(enclave_info, 0x80000000, 0x3fffffff, 1, false, mode);
+  for (size_t i = 0; i < page_count; ++i) {
+    extend_enclave_hash_with_page(enclave_info, 0x80000000 + i * 0x1000, 7,
+        page_addr + pages[i] * 0x1000);
+  }
+  finalize_enclave_hash(enclave_info);
+}
+
+// Copies a sequence of pages into an enclave while measuring them.
+void copy_and_measure_pages(uintptr_t enclave_id, size_t mode,
+    const size_t* pages, size_t page_count) {
+  phys_ptr<enclave_info_t> enclave_info{enclave_id};
+  init_enclave_hash(enclave_info, 0x80000000, 0x3fffffff, 1, false, mode);
+  for (size_t i = 0; i < page_count; ++i) {
+    copy_and_extend_enclave_hash_with_page(enclave_info,
+        0x80000000 + i * 0x1000, 7, copy_addr + i * 0x1000,
+        page_addr + pages[i] * 0x1000, 0);
+  }
+  finalize_enclave_hash(enclave_info);
+}
+
+// Measures page tables, a page and threads into an enclave.
+//
+// `threads` is the number of threads measured after the page.
+void measure_metadata(uintptr_t enclave_id, size_t mode, size_t threads) {
+  phys_ptr<enclave_info_t> enclave_info{enclave_id};
+  init_enclave_hash(enclave_info, 0x80000000, 0x3fffffff, 1, false, mode);
+  for (size_t level = 3; level > 0; --level)
+    extend_enclave_hash_with_page_table(enclave_info, 0x80000000, level, 7);
+  extend_enclave_hash_with_page(enclave_info, 0x80000000, 7, page_addr);
+  for (size_t i = 0; i < threads; ++i) {
+    extend_enclave_hash_with_thread(enclave_info, 0x80000000 + i, 0x80001000,
+        0x80000100, 0x80002000 + i);
+  }
+  finalize_enclave_hash(enclave_info);
+}
+
+// True if two enclaves have the same measurement.
+bool same_measurement(uintptr_t enclave_id, uintptr_t enclave2_id) {
+  phys_ptr<hash_state_t> hash =
+      &(phys_ptr<enclave_info_t>{enclave_id}->*(&enclave_info_t::hash));
+  phys_ptr<hash_state_t> hash2 =
+      &(phys_ptr<enclave_info_t>{enclave2_id}->*(&enclave_info_t::hash));
+  phys_ptr<hash_word_t> h = hash->*(&hash_state_t::h);
+  phys_ptr<hash_word_t> h2 = hash2->*(&hash_state_t::h);
+  for (size_t i = 0; i < 8; ++i) {
+    if (hash_word_t(h[i]) != hash_word_t(h2[i]))
+      return false;
+  }
+  return true;
+}
+
+}  // anonymous namespace
+
+TEST(MeasureInlTest, PageTreeRoot) {
+  set_up_pages();
+  phys_ptr<core_info_t> core_info{core_addr};
+  phys_ptr<enclave_info_t> enclave_info{enclave_addr};
+
+  init_enclave_hash(enclave_info, 0x80000000, 0x3fffffff, 1, false,
+      measurement_tree);
+  for (size_t i = 0; i < 3; ++i) {
+    extend_enclave_hash_with_page(enclave_info, 0x80000000 + i * 0x1000, 7,
+        page_addr + i * 0x1000);
+  }
+  ASSERT_EQ(3, enclave_info->*(&enclave_info_t::page_tree_leaves));
+  page_tree_root(enclave_info, core_info);
+
+  // Compute the leaves by hand, then combine them as ((L0, L1), L2).
+  phys_ptr<hash_word_t> leaves[3] = {
+    digest_addr, digest_addr + 0x100, digest_addr + 0x200,
+  };
+  phys_ptr<hash_word_t> expected{digest_addr + 0x300};
+  phys_ptr<hash_word_t> root{digest_addr + 0x400};
+  phys_ptr<hash_word_t> scratch = core_info->*(&core_info_t::scratch_digest);
+  for (size_t i = 0; i < page_tree_digest_words; ++i)
+    root[i] = scratch[i];
+  for (size_t leaf = 0; leaf < 3; ++leaf) {
+    hash_page_tree_leaf(core_info, 0x80000000 + leaf * 0x1000, 7,
+        page_addr + leaf * 0x1000);
+    for (size_t i = 0; i < page_tree_digest_words; ++i)
+      leaves[leaf][i] = scratch[i];
+  }
+  hash_page_tree_node(core_info, 0, leaves[0], leaves[1], expected);
+  hash_page_tree_node(core_info, 1, expected, leaves[2], expected);
+
+  for (size_t i = 0; i < page_tree_digest_words; ++i)
+    ASSERT_EQ(hash_word_t(expected[i]), hash_word_t(root[i]));
+}
+
+TEST(MeasureInlTest, PageTreeRootOfOneLeaf) {
+  set_up_pages();
+  phys_ptr<core_info_t> core_info{core_addr};
+  phys_ptr<enclave_info_t> enclave_info{enclave_addr};
+
+  init_enclave_hash(enclave_info, 0x80000000, 0x3fffffff, 1, false,
+      measurement_tree);
+  extend_enclave_hash_with_page(enclave_info, 0x80000000, 7, page_addr);
+  page_tree_root(enclave_info, core_info);
+  phys_ptr<hash_word_t> root{digest_addr};
+  phys_ptr<hash_word_t> scratch = core_info->*(&core_info_t::scratch_digest);
+  for (size_t i = 0; i < page_tree_digest_words; ++i)
+    root[i] = scratch[i];
+
+  hash_page_tree_leaf(core_info, 0x80000000, 7, page_addr);
+  for (size_t i = 0; i < page_tree_digest_words; ++i)
+    ASSERT_EQ(hash_word_t(scratch[i]), hash_word_t(root[i]));
+}
+
+TEST(MeasureInlTest, TreeMeasurementIsDeterministic) {
+  set_up_pages();
+
+  const size_t pages[] = { 0, 1, 2, 3, 1 };
+  measure_pages(enclave_addr, measurement_tree, pages, 5);
+  measure_pages(enclave2_addr, measurement_tree, pages, 5);
+  EXPECT_TRUE(same_measurement(enclave_addr, enclave2_addr));
+}
+
+TEST(MeasureInlTest, TreeMeasurementDependsOnPageOrder) {
+  set_up_pages();
+
+  const size_t pages[] = { 0, 1, 2 };
+  const size_t swapped_pages[] = { 1, 0, 2 };
+  measure_pages(enclave_addr, measurement_tree, pages, 3);
+  measure_pages(enclave2_addr, measurement_tree, swapped_pages, 3);
+  EXPECT_FALSE(same_measurement(enclave_addr, enclave2_addr));
+}
+
+TEST(MeasureInlTest, TreeMeasurementDependsOnPageCount) {
+  set_up_pages();
+
+  const size_t pages[] = { 0, 1, 2 };
+  measure_pages(enclave_addr, measurement_tree, pages, 2);
+  measure_pages(enclave2_addr, measurement_tree, pages, 3);
+  EXPECT_FALSE(same_measurement(enclave_addr, enclave2_addr));
+}
+
+TEST(MeasureInlTest, SerialAndTreeMeasurementsDiffer) {
+  set_up_pages();
+
+  const size_t pages[] = { 0, 1, 2 };
+  measure_pages(enclave_addr, measurement_serial, pages, 3);
+  measure_pages(enclave2_addr, measurement_tree, pages, 3);
+  EXPECT_FALSE(same_measurement(enclave_addr, enclave2_addr));
+}
+
+TEST(MeasureInlTest, CopyingMeasurementMatchesInPlace) {
+  set_up_pages();
+  ASSERT_LE(copy_addr + 4 * 0x1000, digest_addr);
+
+  const size_t pages[] = { 2, 0, 3, 1 };
+  const size_t modes[] = { measurement_serial, measurement_tree };
+  for (size_t mode : modes) {
+    memset(phys_buffer + copy_addr, 0, 4 * 0x1000);
+    measure_pages(enclave_addr, mode, pages, 4);
+    copy_and_measure_pages(enclave2_addr, mode, pages, 4);
+    EXPECT_TRUE(same_measurement(enclave_addr, enclave2_addr));
+
+    for (size_t i = 0; i < 4; ++i) {
+      EXPECT_EQ(0, memcmp(phys_buffer + copy_addr + i * 0x1000,
+          phys_buffer + page_addr + pages[i] * 0x1000, 0x1000));
+    }
+  }
+}
+
+TEST(MeasureInlTest, ZeroPagesMeasurement) {
+  set_up_pages();
+  memset(phys_buffer + copy_addr, 0, 2 * 0x1000);
+
+  const size_t modes[] = { measurement_serial, measurement_tree };
+  for (size_t mode : modes) {
+    phys_ptr<enclave_info_t> enclave_info{enclave_addr};
+    phys_ptr<enclave_info_t> enclave2_info{enclave2_addr};
+
+    // The same range is measured the same way.
+    init_enclave_hash(enclave_info, 0x80000000, 0x3fffffff, 1, false, mode);
+    extend_enclave_hash_with_zero_pages(enclave_info, 0x80000000, 2, 7);
+    finalize_enclave_hash(enclave_info);
+    init_enclave_hash(enclave2_info, 0x80000000, 0x3fffffff, 1, false, mode);
+    extend_enclave_hash_with_zero_pages(enclave2_info, 0x80000000, 2, 7);
+    finalize_enclave_hash(enclave2_info);
+    EXPECT_TRUE(same_measurement(enclave_addr, enclave2_addr));
+
+    // The page count is measured.
+    init_enclave_hash(enclave2_info, 0x80000000, 0x3fffffff, 1, false, mode);
+    extend_enclave_hash_with_zero_pages(enclave2_info, 0x80000000, 3, 7);
+    finalize_enclave_hash(enclave2_info);
+    EXPECT_FALSE(same_measurement(enclave_addr, enclave2_addr));
+
+    // Loading zeroed pages one by one is a different operation.
+    init_enclave_hash(enclave2_info, 0x80000000, 0x3fffffff, 1, false, mode);
+    extend_enclave_hash_with_page(enclave2_info, 0x80000000, 7, copy_addr);
+    extend_enclave_hash_with_page(enclave2_info, 0x80001000, 7,
+        copy_addr + 0x1000);
+    finalize_enclave_hash(enclave2_info);
+    EXPECT_FALSE(same_measurement(enclave_addr, enclave2_addr));
+  }
+}
+
+TEST(MeasureInlTest, CopiedMeasurementMatchesOriginal) {
+  set_up_pages();
+
+  const size_t modes[] = { measurement_serial, measurement_tree };
+  const size_t pages[] = { 0, 1, 2, 3 };
+  for (size_t mode : modes) {
+    // The second enclave continues loading from a copy of a partially
+    // measured enclave.
+    phys_ptr<enclave_info_t> enclave_info{enclave_addr};
+    phys_ptr<enclave_info_t> enclave2_info{enclave2_addr};
+    init_enclave_hash(enclave_info, 0x80000000, 0x3fffffff, 1, false, mode);
+    for (size_t i = 0; i < 3; ++i) {
+      extend_enclave_hash_with_page(enclave_info, 0x80000000 + i * 0x1000, 7,
+          page_addr + pages[i] * 0x1000);
+    }
+    memset(phys_buffer + enclave2_addr, 0, sizeof(enclave_info_t));
+    copy_enclave_hash(enclave2_info, enclave_info);
+    extend_enclave_hash_with_page(enclave2_info, 0x80003000, 7,
+        page_addr + pages[3] * 0x1000);
+    finalize_enclave_hash(enclave2_info);
+
+    measure_pages(enclave_addr, mode, pages, 4);
+    EXPECT_TRUE(same_measurement(enclave_addr, enclave2_addr)) << mode;
+  }
+}
+
+TEST(MeasureInlTest, CachedTreeMeasurementMatchesUncached) {
+  set_up_pages();
+  ASSERT_LE(cache_addr + 3 * 0x1000, phys_buffer_size);
+
+  // Repeats follow their originals, so they hit even if the cache is full.
+  const size_t pages[] = { 0, 0, 1, 1, 2, 2 };
+  measure_pages(enclave2_addr, measurement_tree, pages, 6);
+
+  phys_ptr<page_digest_cache_t> cache{cache_addr};
+  init_page_digest_cache(cache, 2);
+  publish_page_digest_cache(cache_addr);
+  measure_pages(enclave_addr, measurement_tree, pages, 6);
+  EXPECT_TRUE(same_measurement(enclave_addr, enclave2_addr));
+  EXPECT_EQ(3, atomic_load(&(cache->*(&page_digest_cache_t::hits))));
+  EXPECT_EQ(3, atomic_load(&(cache->*(&page_digest_cache_t::misses))));
+
+  // Pages copied into the enclave use the cache as well.
+  copy_and_measure_pages(enclave_addr, measurement_tree, pages, 4);
+  publish_page_digest_cache(0);
+  EXPECT_LE(5, atomic_load(&(cache->*(&page_digest_cache_t::hits))));
+  for (size_t i = 0; i < 4; ++i) {
+    EXPECT_EQ(0, memcmp(phys_buffer + copy_addr + i * 0x1000,
+        phys_buffer + page_addr + pages[i] * 0x1000, 0x1000));
+  }
+  copy_and_measure_pages(enclave2_addr, measurement_tree, pages, 4);
+  EXPECT_TRUE(same_measurement(enclave_addr, enclave2_addr));
+}
+
+TEST(MeasureInlTest, PackedRecordsShareHashBlocks) {
+  set_up_pages();
+  phys_ptr<enclave_info_t> enclave_info{enclave_addr};
+  init_enclave_hash(enclave_info, 0x80000000, 0x3fffffff, 1, false,
+      measurement_serial | measurement_packed);
+  EXPECT_EQ(0, enclave_info->*(&enclave_info_t::packed_words));
+
+  extend_enclave_hash_with_page_table(enclave_info, 0x80000000, 1, 7);
+  EXPECT_EQ(4, enclave_info->*(&enclave_info_t::packed_words));
+  extend_enclave_hash_with_thread(enclave_info, 0x80000000, 0x80001000,
+      0x80000100, 0x80002000);
+  EXPECT_EQ(9 % packed_block_words,
+      enclave_info->*(&enclave_info_t::packed_words));
+
+  // Page contents start at a hash block boundary.
+  extend_enclave_hash_with_page(enclave_info, 0x80000000, 7, page_addr);
+  EXPECT_EQ(0, enclave_info->*(&enclave_info_t::packed_words));
+}
+
+TEST(MeasureInlTest, PackedMeasurements) {
+  set_up_pages();
+
+  const size_t modes[] = { measurement_serial, measurement_tree };
+  for (size_t mode : modes) {
+    const size_t packed_mode = mode | measurement_packed;
+
+    measure_metadata(enclave_addr, packed_mode, 3);
+    measure_metadata(enclave2_addr, packed_mode, 3);
+    EXPECT_TRUE(same_measurement(enclave_addr, enclave2_addr)) << mode;
+
+    // The encoding is a part of the measurement.
+    measure_metadata(enclave2_addr, mode, 3);
+    EXPECT_FALSE(same_measurement(enclave_addr, enclave2_addr)) << mode;
+
+    // Records in the last, partially filled, block are measured.
+    measure_metadata(enclave2_addr, packed_mode, 2);
+    EXPECT_FALSE(same_measurement(enclave_addr, enclave2_addr)) << mode;
+    measure_metadata(enclave2_addr, packed_mode, 4);
+    EXPECT_FALSE(same_measurement(enclave_addr, enclave2_addr)) << mode;
+  }
+}
+
+TEST(MeasureInlTest, CopiedPackedMeasurementMatchesOriginal) {
+  set_up_pages();
+
+  const size_t modes[] = { measurement_serial, measurement_tree };
+  for (size_t mode : modes) {
+    const size_t packed_mode = mode | measurement_packed;
+
+    // The copy happens while the packed block holds records.
+    phys_ptr<enclave_info_t> enclave_info{enclave_addr};
+    phys_ptr<enclave_info_t> enclave2_info{enclave2_addr};
+    init_enclave_hash(enclave_info, 0x80000000, 0x3fffffff, 1, false,
+        packed_mode);
+    for (size_t level = 3; level > 0; --level)
+      extend_enclave_hash_with_page_table(enclave_info, 0x80000000, level, 7);
+    ASSERT_NE(0, enclave_info->*(&enclave_info_t::packed_words));
+    memset(phys_buffer + enclave2_addr, 0, sizeof(enclave_info_t));
+    copy_enclave_hash(enclave2_info, enclave_info);
+    extend_enclave_hash_with_page(enclave2_info, 0x80000000, 7, page_addr);
+    extend_enclave_hash_with_thread(enclave2_info, 0x80000000, 0x80001000,
+        0x80000100, 0x80002000);
+    finalize_enclave_hash(enclave2_info);
+
+    measure_metadata(enclave_addr, packed_mode, 1);
+    EXPECT_TRUE(same_measurement(enclave_addr, enclave2_addr)) << mode;
+  }
+}
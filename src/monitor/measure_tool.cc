@@ -0,0 +1,353 @@
+// Computes enclave measurements on the host, so attestations can be verified.
+//
+// The tool replays the loading operations in a manifest through the same
+// measurement code used by the monitor, so its results always match the
+// measurements of enclaves loaded by the monitor. It runs on top of the test
+// implementation of the bare-metal layer, and uses the host's hashing
+// instructions when available.
+//
+// Usage: measure_tool manifest...
+//
+// Each manifest describes one enclave, and prints one line with the enclave's
+// measurement followed by the manifest's path. Each line in a manifest holds
+// one operation; blank lines and lines starting with # are ignored. Numbers
+// can be written in decimal, or in hexadecimal with a 0x prefix.
+//
+//   image <path>
+//       The file holding the enclave's page contents. Must come before the
+//       first page operation.
+//   create <ev_base> <ev_mask> <mailbox_count> <debug> <serial|tree> [packed]
+//       The create_enclave() call. Must be the first operation. `packed`
+//       selects the packed encoding for small operations.
+//   page_table <virtual_addr> <level> <acl>
+//       A load_page_table() call.
+//   page <virtual_addr> <acl> <image_offset> [<level>]
+//       A load_page() call, whose contents are read from the image file at
+//       <image_offset>. <level> defaults to 0.
+//   zero_pages <virtual_addr> <page_count> <acl>
+//       A load_zero_pages() call.
+//   thread <entry_pc> <entry_stack> <fault_pc> <fault_stack>
+//       A load_thread() call.
+//
+// The image is memory-mapped and copied into the measurement buffer one page
+// or superpage at a time, so the tool's memory use does not grow with the
+// image size.
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "bare/page_tables.h"
+#include "bare/phys_ptr.h"
+#include "measure_inl.h"
+
+using sanctum::api::os::measurement_packed;
+using sanctum::api::os::measurement_serial;
+using sanctum::api::os::measurement_tree;
+using sanctum::bare::page_shift;
+using sanctum::bare::page_size;
+using sanctum::bare::page_table_entry_span;
+using sanctum::bare::page_table_levels;
+using sanctum::bare::phys_ptr;
+using sanctum::crypto::hash_result_size;
+using sanctum::crypto::hash_state_t;
+using sanctum::crypto::hash_word_t;
+using sanctum::internal::core_info_t;
+using sanctum::internal::copy_and_extend_enclave_hash_with_page;
+using sanctum::internal::enclave_info_t;
+using sanctum::internal::extend_enclave_hash_with_page_table;
+using sanctum::internal::extend_enclave_hash_with_thread;
+using sanctum::internal::extend_enclave_hash_with_zero_pages;
+using sanctum::internal::finalize_enclave_hash;
+using sanctum::internal::g_core;
+using sanctum::internal::init_enclave_hash;
+
+namespace {
+
+// The layout of the buffer that stands in for physical memory.
+//
+// The core and enclave metadata come first, followed by the staging area that
+// receives page contents. The staging area grows to fit the largest superpage
+// in the manifests, so the measurement code can read a whole page at once.
+constexpr uintptr_t core_addr = 0;
+constexpr uintptr_t enclave_addr =
+    ((sizeof(core_info_t) + page_size() - 1) >> page_shift()) << page_shift();
+constexpr uintptr_t staging_addr = enclave_addr +
+    (((sizeof(enclave_info_t) + page_size() - 1) >> page_shift()) <<
+     page_shift());
+
+// A memory-mapped enclave image.
+struct image_t {
+  const char* data;
+  size_t size;
+};
+
+// The state of a manifest being processed.
+struct manifest_t {
+  const char* path;
+  size_t line_number;
+  bool created;
+  image_t image;
+};
+
+// Reports an error in a manifest line. Always returns false.
+bool manifest_error(const manifest_t& manifest, const char* message) {
+  fprintf(stderr, "%s:%zu: %s\n", manifest.path, manifest.line_number,
+      message);
+  return false;
+}
+
+// The largest number of words in a manifest line.
+constexpr size_t max_line_words = 7;
+
+// Splits a manifest line into whitespace-separated words.
+//
+// Returns the number of words, or SIZE_MAX if the line has too many words.
+size_t split_line(char* line, char** words) {
+  size_t count = 0;
+  for (char* word = strtok(line, " \t\r\n"); word != nullptr;
+       word = strtok(nullptr, " \t\r\n")) {
+    if (count == max_line_words)
+      return SIZE_MAX;
+    words[count] = word;
+    ++count;
+  }
+  return count;
+}
+
+// Parses numeric words. Returns false if a word is not a number.
+bool parse_numbers(char** words, size_t count, uintptr_t* values) {
+  for (size_t i = 0; i < count; ++i) {
+    char* end;
+    values[i] = strtoull(words[i], &end, 0);
+    if (end == words[i] || *end != '\0')
+      return false;
+  }
+  return true;
+}
+
+// Unmaps the image used by a manifest, if it has one.
+void unmap_image(image_t& image) {
+  if (image.data != nullptr && image.size != 0)
+    munmap(const_cast<char*>(image.data), image.size);
+  image.data = nullptr;
+  image.size = 0;
+}
+
+// Memory-maps an image file.
+bool map_image(manifest_t& manifest, const char* path) {
+  unmap_image(manifest.image);
+
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return manifest_error(manifest, "cannot open image");
+  struct stat stat_buffer;
+  if (fstat(fd, &stat_buffer) != 0) {
+    close(fd);
+    return manifest_error(manifest, "cannot stat image");
+  }
+  const size_t size = static_cast<size_t>(stat_buffer.st_size);
+  if (size == 0) {
+    close(fd);
+    manifest.image.data = "";
+    return true;
+  }
+
+  void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED)
+    return manifest_error(manifest, "cannot map image");
+  // NOTE: pages are usually laid out in load order, so read-ahead helps
+  madvise(data, size, MADV_SEQUENTIAL);
+
+  manifest.image.data = static_cast<const char*>(data);
+  manifest.image.size = size;
+  return true;
+}
+
+// Grows the buffer that stands in for physical memory, keeping its contents.
+void reserve_phys_buffer(size_t size) {
+  if (size <= sanctum::testing::phys_buffer_size)
+    return;
+  char* old_buffer = sanctum::testing::phys_buffer;
+  const size_t old_size = sanctum::testing::phys_buffer_size;
+  sanctum::testing::init_phys_buffer(size);
+  memcpy(sanctum::testing::phys_buffer, old_buffer, old_size);
+  delete[] old_buffer;
+}
+
+// Applies a page operation to the enclave's measurement.
+bool apply_page(manifest_t& manifest, const uintptr_t* values, size_t count) {
+  if (count != 3 && count != 4)
+    return manifest_error(manifest, "page needs 3 or 4 arguments");
+  const size_t level = (count == 4) ? values[3] : 0;
+  if (level >= page_table_levels())
+    return manifest_error(manifest, "invalid page level");
+  if (manifest.image.data == nullptr)
+    return manifest_error(manifest, "page needs an image");
+  const size_t span = page_table_entry_span(level);
+  const uintptr_t offset = values[2];
+  if (offset > manifest.image.size || manifest.image.size - offset < span)
+    return manifest_error(manifest, "page is outside the image");
+
+  reserve_phys_buffer(staging_addr + span);
+  memcpy(sanctum::testing::phys_buffer + staging_addr,
+      manifest.image.data + offset, span);
+  copy_and_extend_enclave_hash_with_page(
+      phys_ptr<enclave_info_t>{enclave_addr}, values[0], values[1],
+      staging_addr, staging_addr, level);
+  return true;
+}
+
+// Applies a create operation to the enclave's measurement.
+bool apply_create(manifest_t& manifest, char** words, size_t count) {
+  if (count != 5 && count != 6)
+    return manifest_error(manifest, "create needs 5 or 6 arguments");
+  if (manifest.created)
+    return manifest_error(manifest, "create can only be used once");
+
+  size_t mode;
+  if (strcmp(words[4], "serial") == 0)
+    mode = measurement_serial;
+  else if (strcmp(words[4], "tree") == 0)
+    mode = measurement_tree;
+  else
+    return manifest_error(manifest, "invalid measurement mode");
+  if (count == 6) {
+    if (strcmp(words[5], "packed") != 0)
+      return manifest_error(manifest, "invalid measurement encoding");
+    mode |= measurement_packed;
+  }
+
+  uintptr_t values[4];
+  if (!parse_numbers(words, 4, values))
+    return manifest_error(manifest, "invalid number");
+
+  init_enclave_hash(phys_ptr<enclave_info_t>{enclave_addr}, values[0],
+      values[1], values[2], values[3] != 0, mode);
+  manifest.created = true;
+  return true;
+}
+
+// Applies one manifest line to the enclave's measurement.
+bool apply_manifest_line(manifest_t& manifest, char* line) {
+  char* words[max_line_words];
+  const size_t word_count = split_line(line, words);
+  if (word_count == SIZE_MAX)
+    return manifest_error(manifest, "too many arguments");
+  if (word_count == 0 || words[0][0] == '#')
+    return true;
+
+  const char* op = words[0];
+  char** args = words + 1;
+  const size_t count = word_count - 1;
+
+  if (strcmp(op, "image") == 0) {
+    if (count != 1)
+      return manifest_error(manifest, "image needs a path");
+    return map_image(manifest, args[0]);
+  }
+  if (strcmp(op, "create") == 0)
+    return apply_create(manifest, args, count);
+  if (!manifest.created)
+    return manifest_error(manifest, "the first operation must be create");
+
+  uintptr_t values[max_line_words];
+  if (!parse_numbers(args, count, values))
+    return manifest_error(manifest, "invalid number");
+  phys_ptr<enclave_info_t> enclave_info{enclave_addr};
+
+  if (strcmp(op, "page") == 0)
+    return apply_page(manifest, values, count);
+
+  if (strcmp(op, "page_table") == 0) {
+    if (count != 3)
+      return manifest_error(manifest, "page_table needs 3 arguments");
+    if (values[1] >= page_table_levels())
+      return manifest_error(manifest, "invalid page table level");
+    extend_enclave_hash_with_page_table(enclave_info, values[0], values[1],
+        values[2]);
+    return true;
+  }
+
+  if (strcmp(op, "zero_pages") == 0) {
+    if (count != 3)
+      return manifest_error(manifest, "zero_pages needs 3 arguments");
+    if (values[1] == 0)
+      return manifest_error(manifest, "zero_pages needs at least one page");
+    extend_enclave_hash_with_zero_pages(enclave_info, values[0], values[1],
+        values[2]);
+    return true;
+  }
+
+  if (strcmp(op, "thread") == 0) {
+    if (count != 4)
+      return manifest_error(manifest, "thread needs 4 arguments");
+    extend_enclave_hash_with_thread(enclave_info, values[0], values[1],
+        values[2], values[3]);
+    return true;
+  }
+
+  return manifest_error(manifest, "unknown operation");
+}
+
+// Computes and prints the measurement of the enclave in a manifest.
+bool measure_manifest(const char* path) {
+  FILE* file = fopen(path, "r");
+  if (file == nullptr) {
+    fprintf(stderr, "%s: cannot open manifest\n", path);
+    return false;
+  }
+
+  manifest_t manifest = { path, 0, false, { nullptr, 0 } };
+  char line[4096];
+  bool ok = true;
+  while (ok && fgets(line, sizeof(line), file) != nullptr) {
+    manifest.line_number += 1;
+    ok = apply_manifest_line(manifest, line);
+  }
+  fclose(file);
+  unmap_image(manifest.image);
+  if (!ok)
+    return false;
+  if (!manifest.created) {
+    fprintf(stderr, "%s: no create operation\n", path);
+    return false;
+  }
+
+  phys_ptr<enclave_info_t> enclave_info{enclave_addr};
+  finalize_enclave_hash(enclave_info);
+
+  phys_ptr<hash_state_t> hash = &(enclave_info->*(&enclave_info_t::hash));
+  phys_ptr<hash_word_t> result = hash->*(&hash_state_t::h);
+  for (size_t i = 0; i < hash_result_size / sizeof(hash_word_t); ++i) {
+    const unsigned long long word = hash_word_t(result[i]);
+    printf("%0*llx", static_cast<int>(2 * sizeof(hash_word_t)), word);
+  }
+  printf("  %s\n", path);
+  return true;
+}
+
+}  // anonymous namespace
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s manifest...\n", argv[0]);
+    return 2;
+  }
+
+  sanctum::testing::init_phys_buffer(staging_addr + page_size());
+  sanctum::testing::set_core_count(1);
+  g_core = phys_ptr<core_info_t>{core_addr};
+
+  bool ok = true;
+  for (int i = 1; i < argc; ++i) {
+    if (!measure_manifest(argv[i]))
+      ok = false;
+  }
+  return ok ? 0 : 1;
+}
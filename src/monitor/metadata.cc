@@ -26,12 +26,10 @@ using sanctum::internal::accept_metadata_pages;
 using sanctum::internal::clear_dram_region_lock;
 using sanctum::internal::current_enclave;
 using sanctum::internal::dram_region_for;
-using sanctum::internal::dram_region_info_t;
 using sanctum::internal::dram_region_start;
 using sanctum::internal::enclave_info_pages;
 using sanctum::internal::enclave_info_t;
 using sanctum::internal::enclave_metadata_page_type;
-using sanctum::internal::g_dram_region;
 using sanctum::internal::g_metadata_region_pages;
 using sanctum::internal::g_metadata_region_start;
 using sanctum::internal::free_enclave_id;
@@ -69,19 +67,25 @@ size_t thread_metadata_pages() {
 }
 
 api_result_t create_enclave(enclave_id_t enclave_id, uintptr_t ev_base,
-    uintptr_t ev_mask, size_t mailbox_count, bool debug) {
+    uintptr_t ev_mask, size_t mailbox_count, bool debug,
+    measurement_mode_t measurement_mode) {
   if (!is_valid_range(ev_base, ev_mask))
     return  monitor_invalid_value;
   if (ev_mask + 1 < page_size())
     return monitor_invalid_value;
+  const size_t measurement_version = measurement_mode &
+      ~static_cast<size_t>(measurement_packed);
+  if (measurement_version != measurement_serial &&
+      measurement_version != measurement_tree) {
+    return monitor_invalid_value;
+  }
 
   size_t dram_region;
   api_result_t result = lock_metadata_region_for(enclave_id, dram_region);
   if (result != monitor_ok)
     return result;
 
-  phys_ptr<dram_region_info_t> region = &g_dram_region[dram_region];
-  if (region->*(&dram_region_info_t::owner) != metadata_enclave_id) {
+  if (read_dram_region_owner(dram_region) != metadata_enclave_id) {
     clear_dram_region_lock(dram_region);
     return monitor_invalid_value;
   }
@@ -95,7 +99,7 @@ api_result_t create_enclave(enclave_id_t enclave_id, uintptr_t ev_base,
   }
 
   init_enclave_info(phys_ptr<enclave_info_t>{enclave_id}, ev_base, ev_mask,
-      mailbox_count, debug);
+      mailbox_count, debug, measurement_mode);
   clear_dram_region_lock(dram_region);
   return monitor_ok;
 }
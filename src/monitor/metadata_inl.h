@@ -50,12 +50,12 @@ constexpr inline metadata_page_info_t metadata_page_info_type(
 // The caller should hold the given DRAM region's lock. The DRAM region should
 // be free.
 inline void init_metadata_region(size_t dram_region) {
-  phys_ptr<dram_region_info_t> region = &g_dram_region[dram_region];
-  region->*(&dram_region_info_t::owner) = metadata_enclave_id;
+  phys_ptr<dram_region_info_t> region = dram_region_info_for(dram_region);
   region->*(&dram_region_info_t::pinned_pages) = 0;
 
   phys_ptr<metadata_page_info_t> metadata_map{dram_region_start(dram_region)};
   bzero(metadata_map, g_metadata_region_start << page_shift());
+  write_dram_region_owner(dram_region, metadata_enclave_id);
 }
 
 // Attempts to locks the metadata region for a metadata page address.
@@ -75,8 +75,7 @@ inline api_result_t lock_metadata_region_for(uintptr_t phys_addr,
   if (test_and_set_dram_region_lock(dram_region))
     return monitor_concurrent_call;
 
-  phys_ptr<dram_region_info_t> region = &g_dram_region[dram_region];
-  if (region->*(&dram_region_info_t::owner) != metadata_enclave_id) {
+  if (read_dram_region_owner(dram_region) != metadata_enclave_id) {
     clear_dram_region_lock(dram_region);
     return monitor_invalid_state;
   }
@@ -306,11 +305,10 @@ inline bool read_enclave_region_bitmap_bit(enclave_id_t enclave_id,
 // used to indicate OS ownership of DRAM areas, so it is considered a valid ID.
 inline bool is_valid_enclave_id(enclave_id_t enclave_id) {
   size_t dram_region = clamped_dram_region_for(enclave_id);
-  phys_ptr<dram_region_info_t> region = &g_dram_region[dram_region];
 
   // NOTE: the first DRAM region always belongs to the OS, so this returns true
   //       when enclave_id is 0 / null_enclave_id (indicating OS ownership)
-  return region->*(&dram_region_info_t::owner) == enclave_id;
+  return read_dram_region_owner(dram_region) == enclave_id;
 }
 
 };  // namespace sanctum::internal
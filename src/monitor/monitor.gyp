@@ -17,11 +17,17 @@
       'enclave.h',
       'enclave_init.cc',
       'enclave_inl.h',
+      'event_queue.cc',
+      'event_queue.h',
+      'event_queue_inl.h',
       'mailbox.h',
       'mailbox.cc',
       'metadata.cc',
       'metadata.h',
       'metadata_inl.h',
+      'page_cache.cc',
+      'page_cache.h',
+      'page_cache_inl.h',
       'public/api.h',
     ],
   },
@@ -49,6 +55,20 @@
         '../crypto/crypto.gyp:crypto',
       ],
     },
+    {
+      # Computes enclave measurements on the host, for attestation checks.
+      'target_name': 'measure_tool',
+      'type': 'executable',
+      'sources': [
+        '<@(monitor_sources)',
+        'measure_tool.cc',
+      ],
+      'dependencies': [
+        '../bare/bare.gyp:bare_testing',
+        '../crypto/crypto.gyp:crypto_testing',
+        '../deps/libcxx.gyp:libc++',
+      ],
+    },
     {
       # Unit tests for the monitor.
       'target_name': 'monitor_tests',
@@ -59,10 +79,14 @@
         'cpu_core_inl_test.cc',
         'cpu_core_test.cc',
         'dram_regions_inl_test.cc',
+        'enclave_init_test.cc',
         'enclave_inl_test.cc',
+        'event_queue_inl_test.cc',
+        'event_queue_test.cc',
         'mailbox_test.cc',
         'measure_inl_test.cc',
         'metadata_inl_test.cc',
+        'page_cache_inl_test.cc',
       ],
       'dependencies': [
         '../bare/bare.gyp:bare_testing',
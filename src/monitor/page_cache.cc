@@ -0,0 +1,105 @@
+#include "page_cache.h"
+
+#include "dram_regions_inl.h"
+#include "metadata_inl.h"
+#include "page_cache_inl.h"
+
+namespace sanctum {
+namespace internal {  // sanctum::internal
+
+phys_ptr<atomic<uintptr_t>> g_page_digest_cache{0};
+
+};  // namespace sanctum::internal
+};  // namespace sanctum
+
+using sanctum::bare::atomic_load;
+using sanctum::bare::phys_ptr;
+using sanctum::bare::size_t;
+using sanctum::bare::uintptr_t;
+using sanctum::internal::clear_dram_region_lock;
+using sanctum::internal::dram_region_info_for;
+using sanctum::internal::dram_region_info_t;
+using sanctum::internal::init_page_digest_cache;
+using sanctum::internal::inner_metadata_page_type;
+using sanctum::internal::lock_metadata_region_for;
+using sanctum::internal::page_digest_cache_capacity;
+using sanctum::internal::page_digest_cache_addr;
+using sanctum::internal::page_digest_cache_max_capacity;
+using sanctum::internal::page_digest_cache_t;
+using sanctum::internal::publish_page_digest_cache;
+using sanctum::internal::reserve_metadata_pages;
+using sanctum::internal::test_and_set_dram_region_lock;
+
+namespace sanctum {
+namespace api {  // sanctum::api
+namespace os {  // sancum::api::os
+
+size_t page_digest_cache_max_pages() {
+  return page_digest_cache_max_capacity + 1;
+}
+
+size_t page_digest_cache_hits() {
+  const uintptr_t cache_addr = page_digest_cache_addr();
+  if (cache_addr == 0)
+    return 0;
+  phys_ptr<page_digest_cache_t> cache{cache_addr};
+  return atomic_load(&(cache->*(&page_digest_cache_t::hits)));
+}
+
+size_t page_digest_cache_misses() {
+  const uintptr_t cache_addr = page_digest_cache_addr();
+  if (cache_addr == 0)
+    return 0;
+  phys_ptr<page_digest_cache_t> cache{cache_addr};
+  return atomic_load(&(cache->*(&page_digest_cache_t::misses)));
+}
+
+api_result_t create_page_digest_cache(uintptr_t cache_addr,
+    size_t page_count) {
+  const size_t capacity = page_digest_cache_capacity(page_count);
+  if (capacity == 0 || page_count > capacity + 1)
+    return monitor_invalid_value;
+
+  size_t dram_region;
+  api_result_t result = lock_metadata_region_for(cache_addr, dram_region);
+  if (result != monitor_ok)
+    return result;
+
+  // NOTE: DRAM region 0 always belongs to the OS, so it can't be the metadata
+  //       region locked above
+  if (test_and_set_dram_region_lock(0)) {
+    clear_dram_region_lock(dram_region);
+    return monitor_concurrent_call;
+  }
+  if (page_digest_cache_addr() != 0) {
+    clear_dram_region_lock(0);
+    clear_dram_region_lock(dram_region);
+    return monitor_invalid_state;
+  }
+
+  // NOTE: The cache's pages are owned by the cache itself, so they can't be
+  //       mistaken for an enclave's or a thread's metadata.
+  result = reserve_metadata_pages(cache_addr, page_count, cache_addr,
+      inner_metadata_page_type);
+  if (result != monitor_ok) {
+    clear_dram_region_lock(0);
+    clear_dram_region_lock(dram_region);
+    return result;
+  }
+
+  // The cache is never removed, so its pages stay pinned. This prevents the
+  // metadata region from being freed.
+  phys_ptr<dram_region_info_t> region = dram_region_info_for(dram_region);
+  region->*(&dram_region_info_t::pinned_pages) += page_count;
+
+  init_page_digest_cache(phys_ptr<page_digest_cache_t>{cache_addr}, capacity);
+  publish_page_digest_cache(cache_addr);
+
+  clear_dram_region_lock(0);
+  clear_dram_region_lock(dram_region);
+  return monitor_ok;
+}
+
+};  // namespace sanctum::api::os
+};  // namespace sanctum::api
+};  // namespace sanctum
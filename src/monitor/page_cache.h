@@ -0,0 +1,77 @@
+#if !defined(MONITOR_PAGE_CACHE_H_INCLUDED)
+#define MONITOR_PAGE_CACHE_H_INCLUDED
+
+#include "bare/base_types.h"
+#include "bare/phys_atomics.h"
+#include "bare/phys_ptr.h"
+#include "crypto/hash.h"
+#include "enclave.h"
+
+// The page digest cache remembers the digests of the page contents hashed by
+// tree-format enclave measurements. Many enclaves load identical pages, such
+// as the pages of a shared runtime, so the cache lets the monitor hash each
+// distinct page once, instead of once per enclave.
+//
+// The cache is optional, and lives in metadata pages set aside by the OS via
+// create_page_digest_cache(). The first page holds a page_digest_cache_t,
+// followed by an array of page_digest_cache_entry_t. Each of the following
+// pages holds a copy of the page described by the entry with the same index.
+// Lookups compare entire pages against the copies, so a fingerprint collision
+// cannot cause a wrong digest to be used.
+
+namespace sanctum {
+namespace internal {
+
+using sanctum::bare::atomic;
+using sanctum::bare::atomic_flag;
+using sanctum::bare::phys_ptr;
+using sanctum::bare::size_t;
+using sanctum::bare::uintptr_t;
+using sanctum::crypto::hash_word_t;
+
+// An entry in the page digest cache.
+struct page_digest_cache_entry_t {
+  // The fingerprint of the cached page, computed by page_fingerprint().
+  size_t fingerprint;
+
+  // non-zero if the entry describes a cached page.
+  // NOTE: this isn't bool because we don't want to specialize phys_ptr<bool>.
+  size_t is_valid;
+
+  // The digest of the cached page's contents.
+  hash_word_t digest[page_tree_digest_words];
+};
+
+// The header of the page digest cache.
+struct page_digest_cache_t {
+  // Protects the cache's entries and page copies.
+  //
+  // Cores that find the cache locked hash their pages without using it, so
+  // the cache never causes monitor calls to fail.
+  atomic_flag lock;
+
+  // The number of pages that can be cached.
+  size_t capacity;
+
+  // The number of lookups that found the page in the cache.
+  atomic<size_t> hits;
+
+  // The number of lookups that did not find the page in the cache.
+  atomic<size_t> misses;
+};
+
+// Holds the physical address of the page digest cache, or 0 if there is no
+// cache.
+//
+// This is set while holding the lock of DRAM region 0, which must belong to the
+// OS. Once set, it never changes, so it is read without locking. It is
+// published by an atomic store after the cache is set up, so a core that loads
+// a non-zero address also sees the cache's header.
+//
+// Allocated at boot time on its own LLC line, because it is read by every
+// tree-format page measurement.
+extern phys_ptr<atomic<uintptr_t>> g_page_digest_cache;
+
+};  // namespace sanctum::internal
+};  // namespace sanctum
+#endif  // !defined(MONITOR_PAGE_CACHE_H_INCLUDED)
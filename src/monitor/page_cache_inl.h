@@ -0,0 +1,171 @@
+#if !defined(MONITOR_PAGE_CACHE_INL_H_INCLUDED)
+#define MONITOR_PAGE_CACHE_INL_H_INCLUDED
+
+#include "bare/memory.h"
+#include "bare/page_tables.h"
+#include "bare/phys_atomics.h"
+#include "bare/phys_ptr.h"
+#include "page_cache.h"
+
+namespace sanctum {
+namespace internal {
+
+using sanctum::bare::atomic_fetch_add;
+using sanctum::bare::atomic_load;
+using sanctum::bare::atomic_store;
+using sanctum::bare::atomic_flag_clear;
+using sanctum::bare::atomic_flag_test_and_set;
+using sanctum::bare::bcopy;
+using sanctum::bare::bzero;
+using sanctum::bare::page_shift;
+using sanctum::bare::page_size;
+using sanctum::bare::phys_ptr;
+
+// The largest number of pages that the page digest cache can hold.
+//
+// This is limited by the number of entries that fit in the cache's first page.
+constexpr size_t page_digest_cache_max_capacity =
+    (page_size() - sizeof(page_digest_cache_t)) /
+    sizeof(page_digest_cache_entry_t);
+
+// The number of pages held by a cache that uses some metadata pages.
+inline size_t page_digest_cache_capacity(size_t page_count) {
+  if (page_count < 2)
+    return 0;
+  return (page_count - 1 < page_digest_cache_max_capacity) ?
+      page_count - 1 : page_digest_cache_max_capacity;
+}
+
+// The entry at an index in a page digest cache.
+inline phys_ptr<page_digest_cache_entry_t> page_digest_cache_entry(
+    phys_ptr<page_digest_cache_t> cache, size_t index) {
+  return phys_ptr<page_digest_cache_entry_t>{
+      uintptr_t(cache) + sizeof(page_digest_cache_t)} + index;
+}
+
+// The page that holds the copy of the page described by a cache entry.
+inline uintptr_t page_digest_cache_page(phys_ptr<page_digest_cache_t> cache,
+    size_t index) {
+  return uintptr_t(cache) + ((index + 1) << page_shift());
+}
+
+// The physical address of the page digest cache, or 0 if there is no cache.
+//
+// The cache's header can be read after this returns a non-zero address.
+inline uintptr_t page_digest_cache_addr() {
+  return atomic_load(g_page_digest_cache);
+}
+
+// Makes a page digest cache visible to all cores.
+//
+// The cache must be set up by init_page_digest_cache(), and the caller must
+// hold the lock of DRAM region 0.
+inline void publish_page_digest_cache(uintptr_t cache_addr) {
+  atomic_store(g_page_digest_cache, cache_addr);
+}
+
+// Sets up an empty page digest cache.
+//
+// The caller must own the cache's metadata pages.
+inline void init_page_digest_cache(phys_ptr<page_digest_cache_t> cache,
+    size_t capacity) {
+  bzero(phys_ptr<size_t>{uintptr_t(cache)}, page_size());
+  cache->*(&page_digest_cache_t::capacity) = capacity;
+}
+
+// Computes a cheap fingerprint of a page's contents.
+//
+// The fingerprint samples a few words spread across the page, so it is much
+// faster than a hash. It is only used to pick and pre-screen cache entries;
+// cache hits are verified by comparing the entire page.
+inline size_t page_fingerprint(uintptr_t page_addr) {
+  constexpr size_t samples = 16;
+  constexpr size_t stride = page_size() / sizeof(size_t) / samples;
+  // NOTE: the multiplier is the 32-bit golden ratio constant, so it works for
+  //       both 32-bit and 64-bit size_t
+  constexpr size_t multiplier = 0x9E3779B1;
+
+  const phys_ptr<size_t> words{page_addr};
+  size_t fingerprint = 0;
+  for (size_t i = 0; i < samples; ++i)
+    fingerprint = (fingerprint ^ words[i * stride]) * multiplier;
+  return fingerprint;
+}
+
+// True if two pages have the same contents.
+inline bool same_page_contents(uintptr_t page_addr, uintptr_t page2_addr) {
+  const phys_ptr<size_t> words{page_addr};
+  const phys_ptr<size_t> words2{page2_addr};
+  for (size_t i = 0; i < page_size() / sizeof(size_t); ++i) {
+    if (size_t(words[i]) != size_t(words2[i]))
+      return false;
+  }
+  return true;
+}
+
+// Attempts to lock the page digest cache.
+//
+// Returns false if the lock was acquired, and true if it was already held by
+// someone else.
+inline bool test_and_set_page_digest_cache_lock(
+    phys_ptr<page_digest_cache_t> cache) {
+  return atomic_flag_test_and_set(&(cache->*(&page_digest_cache_t::lock)));
+}
+
+// Releases the lock of the page digest cache.
+inline void clear_page_digest_cache_lock(phys_ptr<page_digest_cache_t> cache) {
+  atomic_flag_clear(&(cache->*(&page_digest_cache_t::lock)));
+}
+
+// Looks up the digest of a page's contents in the page digest cache.
+//
+// The caller must hold the cache's lock. `fingerprint` must be the page's
+// fingerprint.
+//
+// Returns true and copies the cached digest into `digest` if the page is in
+// the cache. Updates the cache's hit and miss counters.
+inline bool find_page_digest(phys_ptr<page_digest_cache_t> cache,
+    uintptr_t page_addr, size_t fingerprint, phys_ptr<hash_word_t> digest) {
+  const size_t index = fingerprint % cache->*(&page_digest_cache_t::capacity);
+  phys_ptr<page_digest_cache_entry_t> entry =
+      page_digest_cache_entry(cache, index);
+  if (entry->*(&page_digest_cache_entry_t::is_valid) == 0 ||
+      entry->*(&page_digest_cache_entry_t::fingerprint) != fingerprint ||
+      !same_page_contents(page_addr, page_digest_cache_page(cache, index))) {
+    atomic_fetch_add(&(cache->*(&page_digest_cache_t::misses)),
+        static_cast<size_t>(1));
+    return false;
+  }
+
+  phys_ptr<hash_word_t> cached_digest =
+      entry->*(&page_digest_cache_entry_t::digest);
+  for (size_t i = 0; i < page_tree_digest_words; ++i)
+    digest[i] = cached_digest[i];
+  atomic_fetch_add(&(cache->*(&page_digest_cache_t::hits)),
+      static_cast<size_t>(1));
+  return true;
+}
+
+// Adds a page's contents digest to the page digest cache.
+//
+// The caller must hold the cache's lock. `fingerprint` must be the page's
+// fingerprint. The page replaces any page cached in the same entry.
+inline void store_page_digest(phys_ptr<page_digest_cache_t> cache,
+    uintptr_t page_addr, size_t fingerprint, phys_ptr<hash_word_t> digest) {
+  const size_t index = fingerprint % cache->*(&page_digest_cache_t::capacity);
+  phys_ptr<page_digest_cache_entry_t> entry =
+      page_digest_cache_entry(cache, index);
+  bcopy(phys_ptr<size_t>{page_digest_cache_page(cache, index)},
+      phys_ptr<size_t>{page_addr}, page_size());
+
+  phys_ptr<hash_word_t> cached_digest =
+      entry->*(&page_digest_cache_entry_t::digest);
+  for (size_t i = 0; i < page_tree_digest_words; ++i)
+    cached_digest[i] = digest[i];
+  entry->*(&page_digest_cache_entry_t::fingerprint) = fingerprint;
+  entry->*(&page_digest_cache_entry_t::is_valid) = 1;
+}
+
+};  // namespace sanctum::internal
+};  // namespace sanctum
+#endif  // !defined(MONITOR_PAGE_CACHE_INL_H_INCLUDED)
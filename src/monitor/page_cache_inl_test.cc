@@ -0,0 +1,107 @@
+#include "page_cache_inl.h"
+
+#include "gtest/gtest.h"
+
+using sanctum::bare::atomic_load;
+using sanctum::bare::phys_ptr;
+using sanctum::crypto::hash_word_t;
+using sanctum::internal::find_page_digest;
+using sanctum::internal::init_page_digest_cache;
+using sanctum::internal::page_digest_cache_capacity;
+using sanctum::internal::page_digest_cache_max_capacity;
+using sanctum::internal::page_digest_cache_t;
+using sanctum::internal::page_fingerprint;
+using sanctum::internal::page_tree_digest_words;
+using sanctum::internal::store_page_digest;
+using sanctum::testing::phys_buffer;
+using sanctum::testing::phys_buffer_size;
+
+namespace {
+
+constexpr uintptr_t page_addr = 0x10000;
+constexpr uintptr_t page2_addr = 0x11000;
+constexpr uintptr_t digest_addr = 0x18000;
+constexpr uintptr_t cache_addr = 0x20000;
+
+// Fills two test pages with the same contents and sets up an empty cache.
+phys_ptr<page_digest_cache_t> set_up_cache(size_t capacity) {
+  EXPECT_LE(cache_addr + (capacity + 1) * 0x1000, phys_buffer_size);
+
+  for (size_t i = 0; i < 0x1000; ++i)
+    phys_buffer[page_addr + i] = static_cast<char>(i * 13);
+  memcpy(phys_buffer + page2_addr, phys_buffer + page_addr, 0x1000);
+  for (size_t i = 0; i < page_tree_digest_words; ++i)
+    phys_ptr<hash_word_t>{digest_addr}[i] = static_cast<hash_word_t>(i + 1);
+
+  phys_ptr<page_digest_cache_t> cache{cache_addr};
+  init_page_digest_cache(cache, capacity);
+  return cache;
+}
+
+size_t hits(phys_ptr<page_digest_cache_t> cache) {
+  return atomic_load(&(cache->*(&page_digest_cache_t::hits)));
+}
+
+size_t misses(phys_ptr<page_digest_cache_t> cache) {
+  return atomic_load(&(cache->*(&page_digest_cache_t::misses)));
+}
+
+}  // anonymous namespace
+
+TEST(PageCacheInlTest, PageDigestCacheCapacity) {
+  ASSERT_LT(1, page_digest_cache_max_capacity);
+
+  EXPECT_EQ(0, page_digest_cache_capacity(0));
+  EXPECT_EQ(0, page_digest_cache_capacity(1));
+  EXPECT_EQ(1, page_digest_cache_capacity(2));
+  EXPECT_EQ(page_digest_cache_max_capacity,
+      page_digest_cache_capacity(page_digest_cache_max_capacity + 1));
+  EXPECT_EQ(page_digest_cache_max_capacity,
+      page_digest_cache_capacity(page_digest_cache_max_capacity + 100));
+}
+
+TEST(PageCacheInlTest, PageFingerprint) {
+  set_up_cache(2);
+
+  EXPECT_EQ(page_fingerprint(page_addr), page_fingerprint(page2_addr));
+  phys_buffer[page2_addr] ^= 1;
+  EXPECT_NE(page_fingerprint(page_addr), page_fingerprint(page2_addr));
+}
+
+TEST(PageCacheInlTest, FindStoredPageDigest) {
+  phys_ptr<page_digest_cache_t> cache = set_up_cache(2);
+  phys_ptr<hash_word_t> digest{digest_addr};
+  phys_ptr<hash_word_t> found_digest{digest_addr + 0x100};
+
+  const size_t fingerprint = page_fingerprint(page_addr);
+  EXPECT_FALSE(find_page_digest(cache, page_addr, fingerprint, found_digest));
+  EXPECT_EQ(0, hits(cache));
+  EXPECT_EQ(1, misses(cache));
+
+  store_page_digest(cache, page_addr, fingerprint, digest);
+  memset(phys_buffer + page_addr, 0, 0x1000);
+
+  // A page with the same contents finds the stored digest, even though the
+  // original page changed.
+  EXPECT_TRUE(find_page_digest(cache, page2_addr, fingerprint, found_digest));
+  for (size_t i = 0; i < page_tree_digest_words; ++i)
+    EXPECT_EQ(hash_word_t(digest[i]), hash_word_t(found_digest[i])) << i;
+  EXPECT_EQ(1, hits(cache));
+  EXPECT_EQ(1, misses(cache));
+}
+
+TEST(PageCacheInlTest, FingerprintCollisionsAreMisses) {
+  phys_ptr<page_digest_cache_t> cache = set_up_cache(2);
+  phys_ptr<hash_word_t> digest{digest_addr};
+  phys_ptr<hash_word_t> found_digest{digest_addr + 0x100};
+
+  const size_t fingerprint = page_fingerprint(page_addr);
+  store_page_digest(cache, page_addr, fingerprint, digest);
+
+  // The fingerprint does not sample this byte, so the pages collide.
+  phys_buffer[page2_addr + 8] ^= 1;
+  ASSERT_EQ(fingerprint, page_fingerprint(page2_addr));
+  EXPECT_FALSE(find_page_digest(cache, page2_addr, fingerprint, found_digest));
+  EXPECT_EQ(0, hits(cache));
+  EXPECT_EQ(1, misses(cache));
+}
@@ -224,10 +224,89 @@ typedef enum {
   dram_region_invalid = 0,
   dram_region_free = 1,
   dram_region_blocked = 2,
-  dram_region_locked = 3,
+  dram_region_locked = 3,  // NOTE: no longer returned by dram_region_state
   dram_region_owned = 4,
+  dram_region_scrubbing = 5,
 } dram_region_state_t;
 
+// Enclave measurement formats.
+//
+// The format is chosen when an enclave is created, and becomes a part of the
+// enclave's measurement. The same enclave contents have different
+// measurements in different formats.
+typedef enum {
+  // Version 1. Every loading operation extends a single serial hash.
+  measurement_serial = 1,
+
+  // Version 2. Every loaded page gets its own leaf digest, and the digests are
+  // combined in a binary hash tree whose root is measured by init_enclave.
+  //
+  // Leaf digests do not depend on each other, and the tree's subtrees can be
+  // recomputed independently when verifying a measurement.
+  //
+  // NOTE: Loading calls still compute each leaf while holding the enclave's
+  //       lock, so loads into the same enclave are serialized just like in
+  //       the serial format.
+  measurement_tree = 2,
+
+  // Flag that can be combined with either version above. Loading operations
+  // that don't measure page contents are encoded as variable-length records,
+  // which are packed into shared hash blocks instead of using a block each.
+  measurement_packed = 4,
+} measurement_mode_t;
+
+// The types of events posted to the OS's monitor event queue.
+typedef enum {
+  // A blocked DRAM region was TLB-flushed by all cores, so it can be freed.
+  // The event's value is the DRAM region's index.
+  monitor_event_dram_region_freeable = 1,
+
+  // A scrubbing or free DRAM region finished being zeroed. The event's value
+  // is the DRAM region's index.
+  monitor_event_dram_region_scrubbed = 2,
+
+  // An enclave was deleted, and its DRAM regions are in the scrubbing state.
+  // The event's value is the enclave's ID.
+  monitor_event_enclave_deleted = 3,
+} monitor_event_type_t;
+
+// An event in the monitor event queue.
+typedef struct {
+  // Event number i is valid when its sequence is i + 1.
+  //
+  // The monitor writes the sequence after the other fields, so the OS must
+  // check it before reading them.
+  size_t sequence;
+  size_t type;  // a monitor_event_type_t value
+  size_t value;  // a DRAM region index or an enclave ID, depending on type
+  size_t reserved;
+} monitor_event_t;
+
+// The header at the start of the monitor event queue.
+//
+// The header takes up the space of one event. It is followed by the event
+// array. Event number i is stored at index (i % capacity) in the array, where
+// capacity is returned by create_event_queue().
+typedef struct {
+  // The number of events consumed by the OS.
+  //
+  // This is only written by the OS. The monitor does not post events that
+  // would overwrite unconsumed events.
+  size_t head;
+  size_t reserved[3];
+} monitor_event_queue_t;
+
+// Describes a page to be loaded by load_pages().
+//
+// The fields have the same meaning as the arguments of load_page().
+typedef struct {
+  uintptr_t phys_addr;
+  uintptr_t virtual_addr;
+  uintptr_t os_addr;
+  uintptr_t acl;
+  size_t level;
+} page_load_descriptor_t;
+
 // Sets the memory range that allows DMA transfers.
 //
 // The range must be entirely contained in DRAM regions allocated to the OS.
@@ -236,14 +315,16 @@ api_result_t set_dma_range(uintptr_t base, uintptr_t mask);
 // Returns the state of the DRAM region with the given index.
 //
 // Returns dram_region_invalid if the given DRAM region index is invalid.
-// Returns dram_region_locked if the given DRAM region is currently locked by
-// another API call.
+//
+// This does not acquire the DRAM region's lock, so it never returns
+// dram_region_locked, and it does not slow down concurrent API calls that
+// change the region's state. The result reflects a single point in time.
 dram_region_state_t dram_region_state(size_t dram_region);
 
 // Returns the owner of the DRAM region with the given index.
 //
-// Returns null_enclave_id if the given DRAM region index is invalid, locked by
-// another operation, or if the region is not in the owned state.
+// Returns null_enclave_id if the given DRAM region index is invalid, or if the
+// region is not in the owned state.
 enclave_id_t dram_region_owner(size_t dram_region);
 
 // Assigns a free DRAM region to an enclave or to the OS.
@@ -251,11 +332,60 @@ enclave_id_t dram_region_owner(size_t dram_region);
 // `new_owner` is the enclave ID of the enclave that will own the DRAM region.
 // 0 means that the DRAM region will be assigned to the OS.
 //
+// Free regions may still hold data from their previous owners. Call
+// find_free_dram_region() to pick a region that has already been zeroed, and
+// dram_region_is_clean() to check a region before assigning it.
 api_result_t assign_dram_region(size_t dram_region, enclave_id_t new_owner);
 
 // Frees a DRAM region that was previously locked.
+//
+// Blocked regions can only be freed after every core has flushed its TLB. The
+// monitor tracks this with a single watermark, so a call that fails because
+// some core hasn't flushed yet is cheap to retry.
 api_result_t free_dram_region(size_t dram_region);
 
+// Frees all the blocked DRAM regions that every core has TLB-flushed.
+//
+// Regions whose locks are held by concurrent calls are skipped. Returns the
+// number of regions freed.
+size_t free_blocked_dram_regions();
+
+// Zeroes some of the pages in a DRAM region released by delete_enclave().
+//
+// Regions released by deleted enclaves are in the scrubbing state until all
+// their pages have been zeroed. Each call zeroes at most `page_budget` pages,
+// and never more than a fixed monitor limit, so the call's latency does not
+// depend on the DRAM region's size. The monitor records the progress, so the
+// OS can interleave calls for different regions with other work.
+//
+// Returns monitor_ok if some pages were zeroed. The region becomes free and
+// clean when its last page is zeroed, which is reflected by
+// dram_region_state() and dram_region_is_clean().
+api_result_t scrub_dram_region(size_t dram_region, size_t page_budget);
+
+// Zeroes some pages in DRAM regions that need scrubbing, in the background.
+//
+// Scrubbing regions are zeroed first, followed by free regions that still
+// hold data from their previous owners. Regions whose locks are held are
+// skipped. Cores that have no other work should call this, so the pool of
+// clean free regions is refilled outside enclave creation.
+//
+// Returns the number of pages zeroed, which is at most `page_budget`. Returns
+// 0 when no DRAM region needs scrubbing.
+size_t scrub_step(size_t page_budget);
+
+// Returns the index of a free DRAM region, preferring zeroed regions.
+//
+// Returns the number of DRAM regions, which is not a valid region index, if no
+// DRAM region is free. Another core may take the returned region first, in
+// which case assign_dram_region() returns monitor_invalid_state.
+size_t find_free_dram_region();
+
+// True if the DRAM region with the given index is free and was zeroed.
+//
+// Returns false for invalid DRAM region indices.
+bool dram_region_is_clean(size_t dram_region);
+
 // Performs the TLB flushes needed to free a locked region.
 //
 // System software must invoke this call instead of flushing the TLB directly,
@@ -263,6 +393,52 @@ api_result_t free_dram_region(size_t dram_region);
 // has occurred.
 api_result_t flush_cached_dram_regions();
 
+// Asks the monitor to flush the TLBs that may map a blocked DRAM region.
+//
+// This is an alternative to calling flush_cached_dram_regions() on every core.
+// The current core is flushed right away. The other cores that haven't
+// flushed since the region was blocked get a monitor IPI. Each of them flushes
+// its TLB when it handles the IPI, or the next time it enters the monitor,
+// whichever comes first.
+//
+// free_dram_region() succeeds once all the cores have flushed. Use
+// dram_region_tlb_flush_pending() to find the cores that are lagging.
+api_result_t request_tlb_shootdown(size_t dram_region);
+
+// True if a core has not flushed its TLB since a DRAM region was blocked.
+//
+// Returns false for invalid DRAM region and core indices, and for regions that
+// are not blocked. While the region stays blocked, a core's result can only
+// change from true to false.
+bool dram_region_tlb_flush_pending(size_t dram_region, size_t core_id);
+
+// Sets up a queue where the monitor posts DRAM region and enclave events.
+//
+// This lets the OS learn when blocked regions become freeable and when
+// regions finish scrubbing, without polling dram_region_state() and retrying
+// free_dram_region(). The queue has a single consumer, the OS, which reads
+// events in order, and publishes its progress by updating the head field in
+// the queue's monitor_event_queue_t header.
+//
+// `queue_addr` must be the physical address of the first page in a sequence of
+// `page_count` pages that belong to the same DRAM region, which must be owned
+// by the OS. The queue is never removed, so the region cannot be blocked
+// afterwards.
+//
+// Events that arrive while the queue is full are dropped and counted by
+// dropped_monitor_events(). The OS should fall back to polling if that count
+// changes. Events are hints, and may occasionally be posted twice.
+//
+// Returns monitor_ok and sets up a queue with capacity
+// monitor_event_queue_capacity(page_count) events.
+api_result_t create_event_queue(uintptr_t queue_addr, size_t page_count);
+
+// The number of events that fit in a queue that uses some pages.
+size_t monitor_event_queue_capacity(size_t page_count);
+
+// The number of events that were dropped because the event queue was full.
+size_t dropped_monitor_events();
+
 // Reserves a free DRAM region to hold enclave metadata.
 //
 // DRAM regions that hold enclave metadata can be freed directly by calling
@@ -289,6 +465,29 @@ size_t thread_metadata_pages();
 // Returns the number of pages used by an enclave metadata structure.
 size_t enclave_metadata_pages(size_t mailbox_count);
 
+// Returns the largest number of pages that a page digest cache can use.
+size_t page_digest_cache_max_pages();
+
+// Sets aside metadata pages for the monitor's page digest cache.
+//
+// The cache remembers the digests of pages loaded into enclaves that use
+// tree-format measurements, so identical pages loaded into many enclaves are
+// only hashed once. The cache is optional, and can only be created once.
+//
+// `cache_addr` must be the physical address of the first page in a sequence of
+// `page_count` free pages in the same DRAM metadata region stripe. The first
+// page holds the cache's index, and every other page holds a cached page, so
+// `page_count` must be between 2 and page_digest_cache_max_pages(). The cache
+// is never removed, so its metadata region cannot be freed.
+api_result_t create_page_digest_cache(uintptr_t cache_addr,
+    size_t page_count);
+
+// Returns the number of page digest cache lookups that found the page.
+size_t page_digest_cache_hits();
+
+// Returns the number of page digest cache lookups that did not find the page.
+size_t page_digest_cache_misses();
+
 // Creates an enclave's metadata structure.
 //
 // `enclave_id` must be the physical address of the first page in a sequence of
@@ -307,9 +506,12 @@ size_t enclave_metadata_pages(size_t mailbox_count);
 // enclave debugging implements copy_debug_enclave_page, which can only be used
 // on debug enclaves.
 //
+// `measurement_mode` selects the format of the enclave's measurement.
+//
 // All arguments become a part of the enclave's measurement.
 api_result_t create_enclave(enclave_id_t enclave_id, uintptr_t ev_base,
-    uintptr_t ev_mask, size_t mailbox_count, bool debug);
+    uintptr_t ev_mask, size_t mailbox_count, bool debug,
+    measurement_mode_t measurement_mode);
 
 // Allocates a page in the enclave's main DRAM region for page tables.
 //
@@ -325,6 +527,9 @@ api_result_t create_enclave(enclave_id_t enclave_id, uintptr_t ev_base,
 // `level` indicates the page table level (e.g., in x86, 0 for PT, 1 for PD, 2
 // for PDPT, 3 for PML).
 //
+// `acl` must not have any of the bits that mark leaf page table entries,
+// because those entries map superpages. See load_page().
+//
 // `virtual_addr`, `level` and `acl` become a part of the enclave's
 // measurement.
 api_result_t load_page_table(enclave_id_t enclave_id, uintptr_t phys_addr,
@@ -338,10 +543,77 @@ api_result_t load_page_table(enclave_id_t enclave_id, uintptr_t phys_addr,
 // load_enclave_ function, must be page-aligned, and must point into a DRAM
 // region owned by the enclave.
 //
-// `virtual_addr`, `acl`, and the contents of the page at `os_addr` become a
-// part of the enclave's measurement.
+// `level` is the page table level of the entry that maps the page. 0 maps a
+// regular page. Higher levels map superpages (e.g., megapages and gigapages),
+// which cover the entire range of virtual addresses translated by an entry at
+// that level. For superpages, `phys_addr`, `virtual_addr` and `os_addr` must
+// be aligned to the superpage size, the entire superpage must be in DRAM
+// regions owned by the enclave, and `acl` must have at least one of the bits
+// that mark leaf page table entries.
+//
+// `virtual_addr`, `acl`, `level`, and the contents of the page at `os_addr`
+// become a part of the enclave's measurement.
 api_result_t load_page(enclave_id_t enclave_id, uintptr_t phys_addr,
-    uintptr_t virtual_addr, uintptr_t os_addr, uintptr_t acl);
+    uintptr_t virtual_addr, uintptr_t os_addr, uintptr_t acl, size_t level);
+
+// Allocates and initializes a sequence of pages in an enclave.
+//
+// `descriptors_addr` is the physical address of an array of `count`
+// page_load_descriptor_t structures. The array must be aligned to
+// sizeof(uintptr_t), must be contained in a single page, and must be in a DRAM
+// region owned by the OS.
+//
+// This has the same effect as calling load_page() once for each descriptor, in
+// order, and produces the same enclave measurement. The enclave is only locked
+// and validated once, so loading large images takes fewer monitor calls.
+//
+// If a descriptor is rejected, the pages described by the descriptors before
+// it remain loaded, as if they had been loaded by individual load_page()
+// calls, and the error code is returned.
+api_result_t load_pages(enclave_id_t enclave_id, uintptr_t descriptors_addr,
+    size_t count);
+
+// Allocates a range of zero-filled pages in the enclave's DRAM regions.
+//
+// `enclave_id` must be an enclave that has not yet been initialized.
+//
+// `phys_addr` must be higher than the last physical address passed to a
+// load_enclave_ function, and must be page-aligned. The `page_count` pages
+// starting at `phys_addr` are mapped at consecutive virtual addresses starting
+// at `virtual_addr`, and must all be in DRAM regions owned by the enclave.
+// The page table entries for all the pages must already be reachable.
+//
+// `virtual_addr`, `page_count` and `acl` become a part of the enclave's
+// measurement. The pages' contents are not hashed, because they are known to
+// be zero, so this is much faster than loading zeroed pages with load_page().
+// The measurement is different from the one produced by load_page() calls.
+api_result_t load_zero_pages(enclave_id_t enclave_id, uintptr_t phys_addr,
+    uintptr_t virtual_addr, size_t page_count, uintptr_t acl);
+
+// Copies a partially loaded enclave into a newly created enclave.
+//
+// `template_id` must be an enclave that has not yet been initialized, and has
+// no threads. Templates are never initialized, so they never execute code,
+// and their pages always match their measurement.
+//
+// `enclave_id` must be an enclave created by create_enclave() with the same
+// arguments as the template, that has not had any page tables, pages or
+// threads loaded. It must own as many DRAM regions as the template. The
+// template's DRAM regions are paired with the enclave's DRAM regions in
+// increasing order of their indices. The template's memory is copied into the
+// paired regions, and the page table entries in the copy are updated to point
+// into the enclave's DRAM regions. Templates with page tables or superpages
+// spanning more than one DRAM stripe cannot be cloned, and the call returns
+// monitor_invalid_state.
+//
+// Only the pages and page tables loaded into the template are copied, so the
+// call's latency grows with the amount of memory loaded into the template.
+//
+// The enclave's measurement is copied from the template, so the pages are not
+// hashed again. Afterwards, the enclave is in the same state as if it had gone
+// through the template's loading calls. Its threads are created by calling
+// load_thread(), and it must be initialized by calling init_enclave().
+api_result_t clone_enclave(enclave_id_t template_id, enclave_id_t enclave_id);
 
 // Creates a hardware thread in an enclave.
 //
@@ -399,6 +671,10 @@ api_result_t delete_thread(thread_id_t thread_id);
 //
 // This can only be called when there is no thread metadata associated with the
 // enclave.
+//
+// The enclave's DRAM regions are not zeroed right away. They enter the
+// scrubbing state, and become free after the OS zeroes them by calling
+// scrub_dram_region().
 api_result_t delete_enclave(enclave_id_t enclave_id);
 
 // Reads/writes a page from/to a debug enclave's memory.